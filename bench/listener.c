@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Times MLLP round trips through a listener on loopback, once with 
+ * each backend. Every client thread keeps a window of messages in 
+ * flight on its own connection, and sends the next window once all 
+ * their ACKs are back.
+ *
+ *      listener [-c clients] [-n messages per client] [-w window]
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <hl7c/listener.h>
+#include <hl7c/mllp.h>
+#include <hl7c/ack.h>
+
+static const char sample[] =
+    "MSH|^~\\&|ADT1|MCM|LABADT|MCM|198808181126|SECURITY|ADT^A01|MSG00001|P|2.5\r"
+    "EVN|A01|198808181123\r"
+    "PID|||PATID1234^5^M11||JONES^WILLIAM^A^III||19610615|M||C|1200 N ELM STREET^^GREENSBORO^NC^27401-1020\r"
+    "PV1|1|I|2000^2012^01||||004777^LEBAUER^SIDNEY^J.|||SUR||||ADM|A0\r";
+
+typedef struct
+{
+    int port;
+    long n;
+    int window;
+} client;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+on_message(connection *conn, const char *msg, size_t len, void *user)
+{
+    ack *reply = user;
+
+    if(ack_build(reply, msg, len, "AA"))
+        connection_sendv(conn, reply->iov, reply->niov);
+}
+
+static void *
+serve(void *arg)
+{
+    listener_run(arg);
+    return NULL;
+}
+
+static void *
+run_client(void *arg)
+{
+    client *c = arg;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(c->port) };
+    char *batch, *p;
+    char buf[64 * 1024];
+    size_t len, i;
+    long sent;
+    ssize_t got;
+    int fd, acked, one = 1;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+       connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        fprintf(stderr, "Couldn't connect: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if((batch = malloc(c->window * (sizeof(sample) + 3))) == NULL)
+        exit(ENOMEM);
+
+    for(i = 0, len = 0; i != (size_t)c->window; i++)
+        len += mllp_encode(batch + len, sample, sizeof(sample) - 1);
+
+    for(sent = 0; sent < c->n; sent += c->window)
+    {
+        if(write(fd, batch, len) != (ssize_t)len)
+            break;
+
+        /* Each ACK ends with the one FS in it. */
+        for(acked = 0; acked != c->window; )
+        {
+            if((got = read(fd, buf, sizeof(buf))) <= 0)
+                break;
+            for(p = buf; (p = memchr(p, MLLP_END, buf + got - p)) != NULL; p++)
+                acked++;
+        }
+
+        if(acked != c->window)
+            break;
+    }
+
+    close(fd);
+    free(batch);
+    return NULL;
+}
+
+static void
+run(listener_backend backend, const char *name, int clients, long n, int window)
+{
+    pthread_t server, tid[clients];
+    client c = { 0, n, window };
+    ack *reply = ack_ctor(NULL, NULL, true);
+    listener *l;
+    double start, t;
+    int i;
+
+    if((l = listener_ctor_backend(NULL, "127.0.0.1", 0, backend, on_message, reply)) == NULL)
+    {
+        printf("    %-10s not available: %s\n", name, strerror(errno));
+        ack_dtor(reply);
+        return;
+    }
+
+    c.port = l->port;
+    pthread_create(&server, NULL, serve, l);
+
+    start = now();
+    for(i = 0; i != clients; i++)
+        pthread_create(&tid[i], NULL, run_client, &c);
+    for(i = 0; i != clients; i++)
+        pthread_join(tid[i], NULL);
+    t = now() - start;
+
+    listener_stop(l);
+    pthread_join(server, NULL);
+
+    printf("    %-10s %9.0f msg/s %9.2f us/msg %9llu messages\n", name,
+           l->stats.messages / t, t / l->stats.messages * 1e6,
+           (unsigned long long)l->stats.messages);
+
+    listener_dtor(l);
+    ack_dtor(reply);
+}
+
+int
+main(int argc, char **argv)
+{
+    int clients = 8;
+    int window = 16;
+    long n = 100000;
+    int opt;
+
+    while((opt = getopt(argc, argv, "c:n:w:")) != -1)
+    {
+        if(opt == 'c')
+            clients = atoi(optarg);
+        else if(opt == 'n')
+            n = atol(optarg);
+        else if(opt == 'w')
+            window = atoi(optarg);
+        else
+        {
+            fprintf(stderr, "usage: %s [-c clients] [-n messages per client] [-w window]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(clients < 1 || window < 1)
+        return EXIT_FAILURE;
+
+    printf("%d clients, %ld messages each, %d in flight\n", clients, n, window);
+
+    run(LISTENER_EPOLL, "epoll", clients, n, window);
+    run(LISTENER_URING, "io_uring", clients, n, window);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/*
+ * Times hl7_msh_peek against the full parsers, on the files given or
+ * on the sample messages in data/, run from the top of the tree.
+ *
+ *      msh_peek [-n iterations] [file...]
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/message.h>
+#include <hl7c/view.h>
+#include <hl7c/msh.h>
+
+static const char *samples[] =
+{
+    "data/adt_a04_13885_20090811203018",
+    "data/adt_a08_13885_20090811203018",
+};
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+report(const char *what, double start, long n, size_t bytes)
+{
+    double t = now() - start;
+
+    printf("    %-20s %9.1f ns/msg %9.1f MB/s\n", what, t / n * 1e9, bytes * (double)n / t / 1e6);
+}
+
+static void
+run(const char *filename, long n)
+{
+    message_view *mv = NULL;
+    message *m = NULL;
+    msh_header hdr;
+    FILE *fp = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    size_t sink = 0;
+    double start;
+    long i;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return;
+    }
+
+    buf = slurp(fp, &len);
+    fclose(fp);
+
+    printf("%s (%zu bytes)\n", filename, len);
+
+    start = now();
+    for(i = 0; i != n; i++)
+    {
+        hl7_msh_peek(buf, len, &hdr);
+        sink += hdr.fields[10].len;
+    }
+    report("hl7_msh_peek", start, n, len);
+
+    mv = message_view_ctor(mv);
+    start = now();
+    for(i = 0; i != n; i++)
+    {
+        message_view_parse(mv, buf, len);
+        sink += mv->nfields;
+    }
+    report("message_view_parse", start, n, len);
+    message_view_dtor(mv);
+
+    start = now();
+    for(i = 0; i != n; i++)
+    {
+        fp = fmemopen(buf, len, "r");
+        m = message_parse(message_ctor(NULL), fp, "\r", NULL);
+        sink += m->len;
+        m->vt->dtor(m);
+        fclose(fp);
+    }
+    report("message_parse", start, n, len);
+
+    if(sink == 0)
+        printf("nothing parsed\n");
+
+    free(buf);
+}
+
+int
+main(int argc, char **argv)
+{
+    long n = 100000;
+    int opt, i;
+
+    while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if(opt == 'n')
+            n = atol(optarg);
+        else
+        {
+            fprintf(stderr, "usage: %s [-n iterations] [file...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(optind == argc)
+        for(i = 0; i != sizeof(samples) / sizeof(samples[0]); i++)
+            run(samples[i], n);
+
+    for(i = optind; i < argc; i++)
+        run(argv[i], n);
+
+    return EXIT_SUCCESS;
+}
@@ -33,13 +33,17 @@
  * stdin, and write to both stdout (default), and an optional 
  * filename given on the command line.
  *
- * Intended to be plugged into xinetd.
+ * Intended to be plugged into xinetd. Given a port with -p, it
+ * listens there itself instead, serving any number of persistent
+ * connections until killed.
  **/
 
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <getopt.h>
 #include <libgen.h>
 
@@ -47,21 +51,52 @@
 #include <hl7c/common.h>
 #include <hl7c/proto.h>
 #include <hl7c/net.h>
+#include <hl7c/ack.h>
+#include <hl7c/listener.h>
 
 extern char * program_invocation_short_name; /* basename(argv[0]), but global */
 #define program program_invocation_short_name
 
+#define MAX_MESSAGE (1 << 20)
+
 
 void
 usage(FILE *stream, int code)
 {
     fprintf(stream, "usage: %s: hostname port filename\n", program);
     fprintf(stream, "\noptional arguments\n"
-                    "        -o [file]   output filename\n");
+                    "        -o [file]   output filename\n"
+                    "        -a [file]   answer with the contents of file\n"
+                    "        -A          answer with an ACK built for the message\n"
+                    "        -p [port]   listen on port, rather than use stdin\n"
+                    "        -w [n]      with -p, n worker threads (default: one per CPU)\n");
 
     exit(code);
 }
 
+/* What the listener's handler needs. */
+typedef struct
+{
+    FILE *out;          /* log, or NULL */
+    ack *reply;         /* NULL unless building ACKs */
+    const char *canned; /* the -a file, or NULL */
+    size_t cannedlen;
+} serve_state;
+
+static void
+serve(connection *conn, const char *msg, size_t len, void *user)
+{
+    serve_state *state = user;
+
+    if(state->out != NULL)
+        fprintf(state->out, "[%zu bytes] %.*s\n", len, (int)len, msg);
+
+    if(state->reply != NULL && ack_build(state->reply, msg, len, "AA"))
+        connection_sendv(conn, state->reply->iov, state->reply->niov);
+    else if(state->canned != NULL)
+        connection_send(conn, state->canned, state->cannedlen);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -69,18 +104,32 @@ main(int argc, char **argv)
     char *buf = NULL;
     char *logname = NULL;
     char *goodack = NULL;
+    char *canned = NULL;
+    size_t cannedlen = 0;
     bool dolog = false;
     bool doack = false;
-
-    int len = 0;
-    int next_opt;
+    bool buildack = false;
     off_t offset = 0;
-    int read_fd,
-        fsize;
+    int read_fd, fsize;
+    FILE *fp;
+
+    ack *reply = NULL;
+    listener_group *server = NULL;
+    serve_state *state;
+    int port = 0;
+    int workers = 0;
+    int i;
+
+    tcp_status status;
+    size_t len = 0;
+    int next_opt;
 
-    const char *short_opt = "o:a:";
+    const char *short_opt = "o:a:Ap:w:";
     const struct option long_opt[] = {
         {"ackfile", 1, NULL, 'a'},
+        {"ack",    0, NULL, 'A'},
+        {"port",   1, NULL, 'p'},
+        {"workers", 1, NULL, 'w'},
         {"output", 1, NULL, 'o'},
         {NULL,     0, NULL, 0},
     };
@@ -101,6 +150,18 @@ main(int argc, char **argv)
                 doack = true;
                 break;
 
+            case 'A':       /* -A or --ack... optional */
+                buildack = true;
+                break;
+
+            case 'p':       /* -p or --port... optional */
+                port = atoi(optarg);
+                break;
+
+            case 'w':       /* -w or --workers... optional */
+                workers = atoi(optarg);
+                break;
+
             case '?':       /* invalid option */
                 usage(stderr, EXIT_FAILURE);
                 break;
@@ -124,13 +185,67 @@ main(int argc, char **argv)
                     "%s: couldn't open log\n", program);
     }
 
-    buf = tcp_recv(fileno(stdin), 5000, 4096, &len);
+    if(port > 0)
+    {
+        if((server = listener_group_ctor(server, NULL, port, workers, serve, NULL)) == NULL)
+            die(stderr, EXIT_FAILURE,
+                    "%s: couldn't listen on port %d: %s\n", program, port, strerror(errno));
+
+        if((state = calloc(server->nworkers, sizeof(serve_state))) == NULL)
+            die(stderr, ENOMEM, "%s: Out of memory!\n", program);
+
+        /* The ACK file is sent over and over; read it once. */
+        if(doack && !buildack)
+        {
+            if((fp = fopen(goodack, "r")) == NULL)
+                die(stderr, EXIT_FAILURE, "%s: couldn't open %s\n", program, goodack);
+            canned = slurp(fp, &cannedlen);
+            fclose(fp);
+        }
+
+        /* Each worker gets its own ACK; their control IDs are kept
+         * apart by starting each counter a billion higher.
+         */
+        for(i = 0; i != server->nworkers; i++)
+        {
+            state[i].out = out;
+            state[i].canned = canned;
+            state[i].cannedlen = cannedlen;
+
+            if(buildack)
+            {
+                state[i].reply = ack_ctor(NULL, "HL7 Server - Message Accepted", true);
+                state[i].reply->serial = (uint64_t)i * 1000000000;
+            }
+            server->workers[i]->user = &state[i];
+        }
+
+        listener_group_run(server);
+        return EXIT_SUCCESS;
+    }
+
+    /* Returns at the end of the frame; 5 seconds is only the limit. */
+    status = tcp_recv_frame(fileno(stdin), 5000, MAX_MESSAGE, NULL, NULL, &buf, &len);
 
     if(dolog)
-        fprintf(out, "[%d bytes] %s\n", len, buf);
+        fprintf(out, "[%zu bytes] %s\n", len, buf != NULL ? buf : "");
 
 
-    if(doack)
+    if(buildack && status == TCP_FRAME)
+    {
+        reply = ack_ctor(reply, "HL7 Server - Message Accepted", true);
+
+        /* Answer with the sender's own control ID, so it can match 
+         * the ACK to what it sent.
+         */
+        if(ack_build(reply, buf, len, "AA"))
+            ack_send(reply, fileno(stdout));
+        else if(dolog)
+            fprintf(out, "no MSH segment, not acknowledged\n");
+
+        ack_dtor(reply);
+    }
+    else if(doack)
     {
         fsize = getsize(goodack);
 
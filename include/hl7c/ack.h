@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_ACK_H_
+#define _HL7_ACK_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+#include <time.h>       /* time_t */
+#include <sys/types.h>  /* ssize_t */
+#include <sys/uio.h>    /* struct iovec */
+
+/**
+ * \file ack.h
+ *
+ * \brief Acknowledgements built from the message they answer.
+ *
+ * An ACK echoes the inbound header with sender and receiver swapped:
+ *
+ *      MSH|^~\&|<MSH-5>|<MSH-6>|<MSH-3>|<MSH-4>|<now>||ACK^<trigger>|<id>|<MSH-11>|<MSH-12>
+ *      MSA|<code>|<MSH-10>|<text>
+ *
+ * Only the inbound MSH is looked at, through hl7_msh_peek. The 
+ * pieces are copied into a buffer the ack keeps from one message to 
+ * the next, the timestamp is formatted once a second at most, and the
+ * result goes out, MLLP framing and all, in a single writev. The 
+ * inbound field separator and encoding characters are kept.
+ */
+
+typedef struct _ack
+{
+    const char *text;       /* MSA-3, or NULL */
+    size_t textlen;
+    bool mllp;              /* frame with VT ... FS CR */
+
+    char *buf;              /* the ACK, unframed */
+    size_t len;
+    size_t size;
+
+    char stamp[32];         /* MSH-7, as of stamped */
+    size_t stamplen;
+    time_t stamped;
+
+    uint64_t serial;        /* MSH-10 of the next ACK */
+
+    struct iovec iov[3];
+    int niov;
+} ack;
+
+/**
+ * \fn ack_ctor
+ * \brief
+ *      Constructor for an ack.
+ *
+ * \param text - MSA-3, the text message, or NULL. Must outlive the ack.
+ * \param mllp - whether to frame what ack_send writes.
+ */
+
+ack * ack_ctor(ack *self, const char *text, bool mllp);
+
+/**
+ * \fn ack_build
+ * \brief
+ *      Builds the ACK for the message in msg.
+ *
+ * \param code - MSA-1: "AA", "AE" or "AR".
+ * \returns false if msg doesn't start with an MSH segment, once any
+ *      framing is skipped.
+ */
+
+bool ack_build(ack *self, const char *msg, size_t len, const char *code);
+
+/**
+ * \fn ack_send
+ * \brief
+ *      Writes the last ACK built to fd.
+ *
+ * \returns the number of bytes written, or -1 with errno set.
+ */
+
+ssize_t ack_send(ack *self, int fd);
+
+/**
+ * \fn ack_dtor
+ * \brief
+ *      Destructor for an ack.
+ */
+
+void ack_dtor(ack *self);
+
+#endif
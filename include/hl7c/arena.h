@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_ARENA_H_
+#define _HL7_ARENA_H_
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memcpy */
+#include <stddef.h> /* size_t, max_align_t */
+#include <errno.h>  /* ENOMEM */
+
+/**
+ * \file arena.h
+ *
+ * \brief Bump allocator for everything belonging to one message.
+ *
+ * Allocations are carved out of large blocks and never freed one by 
+ * one; arena_reset releases all of them at once. When a message 
+ * overflows the first block, the next reset replaces the chain with a
+ * single block big enough for it, so an arena recycled across 
+ * messages in a receiver settles at no allocator calls at all. That 
+ * block is never more than ARENA_KEEP times the size the arena was 
+ * made with, and once a message fits that size again the arena 
+ * shrinks back to it, so one huge message doesn't hold on to its 
+ * memory for the life of the arena.
+ *
+ * Like the rest of the library, running out of memory is fatal.
+ */
+
+#define ARENA_BLOCK 16384       /* default block size */
+#define ARENA_KEEP  64          /* most a reset keeps, in blocksize units */
+
+typedef struct _arena_block
+{
+    struct _arena_block *next;
+    size_t size;                /* bytes in data */
+    size_t used;
+    max_align_t data[];
+} arena_block;
+
+typedef struct _arena
+{
+    arena_block *first;
+    arena_block *head;          /* block currently being carved */
+    size_t blocksize;           /* as made; the size it shrinks back to */
+    void *last;                 /* most recent allocation, may grow in place */
+
+    size_t mallocs;             /* blocks obtained from malloc, ever */
+} arena;
+
+/**
+ * \fn arena_ctor
+ * \brief
+ *      Constructor for the arena.
+ *
+ * \param self - the arena we're initializing.
+ * \param blocksize - size of the first block, 0 for ARENA_BLOCK.
+ * \returns the initialized arena.
+ */
+
+arena * arena_ctor(arena *self, size_t blocksize);
+
+/**
+ * \fn arena_alloc
+ * \brief
+ *      Allocates n bytes, aligned for any type.
+ */
+
+void * arena_alloc(arena *a, size_t n);
+
+/**
+ * \fn arena_calloc
+ * \brief
+ *      Allocates n zeroed bytes.
+ */
+
+void * arena_calloc(arena *a, size_t n);
+
+/**
+ * \fn arena_realloc
+ * \brief
+ *      Grows an allocation. The most recent allocation is extended in 
+ *      place when its block has room, anything else is copied.
+ *
+ * \param old - previous allocation, or NULL.
+ * \param oldsize - its size.
+ * \param newsize - the size wanted.
+ */
+
+void * arena_realloc(arena *a, void *old, size_t oldsize, size_t newsize);
+
+/**
+ * \fn arena_strndup
+ * \brief
+ *      Copies n bytes of s, adding a nul.
+ */
+
+char * arena_strndup(arena *a, const char *s, size_t n);
+
+/**
+ * \fn arena_reset
+ * \brief
+ *      Releases every allocation at once, keeping the memory for reuse,
+ *      up to ARENA_KEEP blocks' worth.
+ */
+
+void arena_reset(arena *a);
+
+/**
+ * \fn arena_dtor
+ * \brief
+ *      Returns all of the arena's memory to the system.
+ */
+
+void arena_dtor(arena *a);
+
+#endif
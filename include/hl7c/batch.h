@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_BATCH_H_
+#define _HL7_BATCH_H_
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* int64_t, UINT32_MAX */
+#include <stdbool.h>
+
+#include <hl7c/view.h>      /* span */
+#include <hl7c/query.h>
+
+/**
+ * \file batch.h
+ *
+ * \brief Columnar extraction of fields across many messages.
+ *
+ * A batch is built once from a list of column paths, in the syntax of
+ * query.h, e.g. "MSH-7", "PID-3-1" or "OBX-5". Running it over N raw
+ * messages fills one vector per column, with one row per message: the
+ * span of the value within its message, and optionally the value 
+ * converted to an integer, a double or a time. The vectors are reused 
+ * from run to run, and nothing is copied out of the messages.
+ *
+ * Rows are independent, so a run can be split across threads. This is
+ * only available when the library is built with HAVE_PTHREAD.
+ */
+
+#define BATCH_NULL UINT32_MAX   /* span.off of a value that isn't there */
+
+typedef enum _batch_type
+{
+    BATCH_TEXT = 0,     /* spans only */
+    BATCH_INT64,        /* decimal integer, into i64 */
+    BATCH_DOUBLE,       /* decimal number, into f64 */
+    BATCH_EPOCH,        /* HL7 date/time, into i64 as seconds since 
+                         * 1970-01-01 UTC; without an offset, the time
+                         * is taken to be UTC */
+} batch_type;
+
+typedef struct _batch_vector
+{
+    batch_type type;
+    span *spans;        /* offsets into each row's message */
+    int64_t *i64;       /* BATCH_INT64 and BATCH_EPOCH only */
+    double *f64;        /* BATCH_DOUBLE only */
+    bool *valid;        /* present, and converted if typed */
+} batch_vector;
+
+typedef struct _batch
+{
+    query *q;
+    int ncols;
+    batch_vector *cols;
+    int rows;           /* rows filled by the last run */
+    int cap;            /* rows the vectors have room for */
+} batch;
+
+/**
+ * \fn batch_ctor
+ * \brief
+ *      Compiles a batch.
+ *
+ * \param paths - one path per column.
+ * \param types - one type per column, or NULL for all BATCH_TEXT.
+ * \param ncols - number of columns, possibly 0.
+ * \param bad - if not NULL, receives the index of the first path that
+ *      couldn't be compiled, or -1.
+ * \returns the batch, or NULL if a path is malformed.
+ */
+
+batch * batch_ctor(const char *const *paths, const batch_type *types, int ncols, int *bad);
+
+/**
+ * \fn batch_run
+ * \brief
+ *      Extracts every column from n messages, into rows 0 to n - 1.
+ *
+ * \param msgs - the raw messages.
+ * \param lens - their lengths.
+ * \param nthreads - threads to spread the rows over; 1 or less runs
+ *      everything in the caller's thread.
+ * \returns n.
+ */
+
+int batch_run(batch *self, const char *const *msgs, const size_t *lens, int n, int nthreads);
+
+/**
+ * \fn batch_text
+ * \brief
+ *      Gets the text of a value, given the messages the batch was run 
+ *      over.
+ *
+ * \returns the value, not nul terminated, or NULL if it isn't there.
+ */
+
+static inline const char *
+batch_text(const batch *self, int col, int row, const char *const *msgs, size_t *len)
+{
+    span s = self->cols[col].spans[row];
+
+    if(s.off == BATCH_NULL)
+        return NULL;
+
+    *len = s.len;
+    return msgs[row] + s.off;
+}
+
+/**
+ * \fn batch_dtor
+ * \brief
+ *      Destructor for a batch.
+ */
+
+void batch_dtor(batch *self);
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_COMPACT_H_
+#define _HL7_COMPACT_H_
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+#include <hl7c/segid.h>
+#include <hl7c/message.h>
+
+/**
+ * \file compact.h
+ *
+ * \brief A message stored as a few flat arrays.
+ *
+ * A compact message keeps every field in one byte buffer, each one nul
+ * terminated, and finds them through a table of 32-bit offsets. 
+ * Segment i owns fields starts[i] up to starts[i + 1], and its ID is 
+ * ids[i]. There is one allocation per array, however many segments and
+ * fields there are, and no pointers to chase: reading the same field 
+ * of every OBX is a walk along ids and offs.
+ *
+ * Segments and fields are numbered as in message: segment 0 is the 
+ * first, and field 0 of a segment is its name.
+ */
+
+typedef struct _compact
+{
+    int len;            /* number of segments */
+    int nfields;        /* number of fields, in all segments */
+
+    char *buf;          /* the fields, nul terminated, back to back */
+    size_t used;
+    size_t size;
+
+    uint32_t *offs;     /* start of each field in buf */
+    int fieldcap;
+
+    uint32_t *starts;   /* first field of each segment, then nfields */
+    segid *ids;         /* ID of each segment */
+    int segcap;
+} compact;
+
+/**
+ * \fn compact_ctor
+ * \brief
+ *      Constructor for an empty compact message.
+ *
+ * \param self - the message we're initializing.
+ * \returns the initialized message.
+ */
+
+compact * compact_ctor(compact *self);
+
+/**
+ * \fn compact_parse
+ * \brief
+ *      Parses a raw message into self, replacing what it held. The 
+ *      input is copied once, and its separators overwritten with nuls,
+ *      so each field is split out in place.
+ *
+ * \param buf - the message, optionally framed as MLLP.
+ * \param len - length of buf.
+ * \returns self.
+ */
+
+compact * compact_parse(compact *self, const char *buf, size_t len);
+
+/**
+ * \fn compact_from_message
+ * \brief
+ *      Packs the segments and fields of msg into self, replacing what
+ *      it held.
+ *
+ * \returns self.
+ */
+
+compact * compact_from_message(compact *self, message *msg);
+
+/**
+ * \fn compact_segment_len
+ * \brief
+ *      Gets the number of fields in segment i, its name included.
+ */
+
+static inline int
+compact_segment_len(const compact *self, int i)
+{
+    return self->starts[i + 1] - self->starts[i];
+}
+
+/**
+ * \fn compact_field
+ * \brief
+ *      Gets field j of segment i.
+ *
+ * \returns the nul-terminated field, or NULL if there is no such field.
+ */
+
+static inline const char *
+compact_field(const compact *self, int i, int j)
+{
+    if(i < 0 || i >= self->len || j < 0 || j >= compact_segment_len(self, i))
+        return NULL;
+
+    return self->buf + self->offs[self->starts[i] + j];
+}
+
+/**
+ * \fn compact_find
+ * \brief
+ *      Gets the position of the nth occurrence of a segment, counting
+ *      from 0.
+ *
+ * \returns the segment's position, or -1.
+ */
+
+int compact_find(const compact *self, segid id, int n);
+
+/**
+ * \fn compact_column
+ * \brief
+ *      Collects field j of every segment with the given ID, in order,
+ *      e.g. OBX-5 of every observation. Segments too short to have the
+ *      field give NULL.
+ *
+ * \param out - receives up to cap fields.
+ * \returns the number of segments with the ID, which may exceed cap.
+ */
+
+int compact_column(const compact *self, segid id, int j, const char **out, int cap);
+
+/**
+ * \fn compact_dtor
+ * \brief
+ *      Destructor for a compact message.
+ */
+
+void compact_dtor(compact *self);
+
+#endif
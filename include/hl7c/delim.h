@@ -0,0 +1,148 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_DELIM_H_
+#define _HL7_DELIM_H_
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t, uint64_t */
+#include <stdbool.h>
+
+/**
+ * \file delim.h
+ *
+ * \brief Vectorized search for delimiter characters.
+ *
+ * Every parser in the library finds segment terminators and encoding
+ * characters through these routines. The search is done 64 bytes at
+ * a time, producing one bit per byte, with the widest implementation
+ * the CPU supports chosen once at load time: AVX-512BW, AVX2, SSE2 
+ * (the baseline on x86-64), or a portable scalar fallback.
+ */
+
+#define DELIM_MAX 8             /* most characters a delimset can hold */
+#define DELIM_BATCH 512         /* suggested size of a delim_index buffer */
+
+/* Number of 64-bit words needed to hold the bitmap of len bytes. */
+#define DELIM_WORDS(len) (((len) + 63) / 64)
+
+typedef struct _delimset
+{
+    int n;
+    unsigned char c[DELIM_MAX];
+    bool member[256];           /* lookup table for the scalar paths */
+} delimset;
+
+/**
+ * \fn delimset_init
+ * \brief
+ *      Builds a set from the characters in chars.
+ *
+ * \param set - the set to fill.
+ * \param chars - the characters to search for. At most DELIM_MAX are
+ *      used; duplicates are dropped.
+ * \param n - number of characters in chars. Passed explicitly, so
+ *      that the set may contain a nul.
+ * \returns set.
+ */
+
+delimset * delimset_init(delimset *set, const char *chars, int n);
+
+/**
+ * \fn delim_find
+ * \brief
+ *      Finds the first byte of buf that is in set.
+ *
+ * \returns its offset, or len if there is none.
+ */
+
+size_t delim_find(const char *buf, size_t len, const delimset *set);
+
+/**
+ * \fn delim_bitmap
+ * \brief
+ *      Sets bit (i % 64) of bits[i / 64] for every byte i of buf that 
+ *      is in set, and clears every other bit.
+ *
+ * \param bits - at least DELIM_WORDS(len) words.
+ * \returns the number of bits set.
+ */
+
+size_t delim_bitmap(const char *buf, size_t len, const delimset *set, uint64_t *bits);
+
+/**
+ * \fn delim_count
+ * \brief
+ *      Counts the bytes of buf that are in set, e.g. to size storage
+ *      before splitting.
+ */
+
+size_t delim_count(const char *buf, size_t len, const delimset *set);
+
+/**
+ * \fn delim_index
+ * \brief
+ *      Writes the offset of each byte of buf that is in set to pos, in
+ *      order, stopping early if pos fills up.
+ *
+ *      Call again on buf + *done to resume. cap should be at least 64
+ *      (DELIM_BATCH is a good size), otherwise a dense block may not 
+ *      fit and no progress is made.
+ *
+ * \param pos - receives offsets relative to buf.
+ * \param cap - number of entries in pos.
+ * \param done - set to the number of bytes of buf fully searched.
+ * \returns the number of offsets written.
+ */
+
+size_t delim_index(const char *buf, size_t len, const delimset *set,
+                   uint32_t *pos, size_t cap, size_t *done);
+
+/**
+ * \fn delim_impl
+ * \brief
+ *      Name of the implementation in use: "avx512", "avx2", "sse2" or
+ *      "scalar".
+ */
+
+const char * delim_impl(void);
+
+/**
+ * \fn delim_select
+ * \brief
+ *      Forces a particular implementation, mostly for testing and
+ *      benchmarking. Fails if the CPU does not support it.
+ *
+ * \param name - as returned by delim_impl, or NULL for the best
+ *      available.
+ * \returns true if the implementation is now in use.
+ */
+
+bool delim_select(const char *name);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_DTM_H_
+#define _HL7_DTM_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* int64_t, int32_t, INT32_MIN */
+
+/**
+ * \file dtm.h
+ *
+ * \brief Decoding HL7 date/time values (DTM, and the TS it replaced).
+ *
+ * The format is YYYY[MM[DD[HH[MM[SS[.S[S[S[S]]]]]]]]][+/-ZZZZ]; any
+ * prefix of the date and time is allowed, and missing parts take 
+ * their lowest value. An offset is at most 14 hours either way. The
+ * fourteen digits of a full timestamp are checked and converted 
+ * eight at a time, as SWAR words, rather than one by one.
+ *
+ * A value without an offset is taken to be in the zone the caller 
+ * gives: DTM_UTC, a fixed number of seconds east of UTC, or 
+ * DTM_LOCAL. Local offsets come from localtime_r and are cached per 
+ * thread, by quarter hour, so a column of nearby times asks once.
+ */
+
+#define DTM_UTC     0
+#define DTM_LOCAL   INT32_MIN
+
+typedef enum _dtm_precision
+{
+    DTM_YEAR = 0,
+    DTM_MONTH,
+    DTM_DAY,
+    DTM_HOUR,
+    DTM_MINUTE,
+    DTM_SECOND,
+    DTM_FRACTION
+} dtm_precision;
+
+typedef struct _dtm
+{
+    int64_t seconds;        /* since 1970-01-01 UTC */
+    int32_t nanos;          /* fraction of a second */
+    int32_t offset;         /* seconds east of UTC that applied */
+    dtm_precision precision;
+    bool zoned;             /* the offset was written in the value */
+} dtm;
+
+/**
+ * \fn dtm_decode
+ * \brief
+ *      Decodes an HL7 date/time.
+ *
+ * \param zone - seconds east of UTC for values without an offset, or
+ *      DTM_LOCAL.
+ * \returns false if p isn't a valid date/time. out is then untouched.
+ */
+
+bool dtm_decode(const char *p, size_t n, int32_t zone, dtm *out);
+
+/**
+ * \fn dtm_to_epoch
+ * \brief
+ *      Decodes an HL7 date/time to whole seconds since the epoch; 
+ *      fractions of a second are dropped.
+ *
+ * \param zone - as for dtm_decode.
+ */
+
+bool dtm_to_epoch(const char *p, size_t n, int32_t zone, int64_t *out);
+
+/**
+ * \fn dtm_to_epoch_batch
+ * \brief
+ *      dtm_to_epoch over a column of n values. A NULL value is invalid.
+ *
+ * \param valid - set for each value that decoded.
+ * \returns the number of values that decoded.
+ */
+
+int dtm_to_epoch_batch(const char *const *values, const size_t *lens, int n, int32_t zone,
+                       int64_t *out, bool *valid);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_EDIT_H_
+#define _HL7_EDIT_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+
+#include <hl7c/view.h>
+#include <hl7c/serialize.h>
+
+/**
+ * \file edit.h
+ *
+ * \brief Copy-on-write edits to a parsed message.
+ *
+ * A message_edit sits on top of a message_view and records changes to 
+ * it as patches, without touching the view or its buffer. When the 
+ * result is serialized, segments that no patch touches go out as they 
+ * are, straight from the original buffer, and only the patched ones 
+ * are rebuilt. Changing MSH-5 on a forwarded message so costs the 
+ * bytes of the MSH segment, whatever the size of the rest.
+ *
+ * Segments and fields are numbered as in view.h: field 0 is the 
+ * segment name and MSH-1 is not counted, so MSH-5 is field 4. 
+ * Repetitions count from 0 and components from 1. Patches to one 
+ * segment apply in the order they were made.
+ */
+
+typedef enum
+{
+    EDIT_FIELD,
+    EDIT_COMPONENT,
+    EDIT_SEGMENT
+} edit_kind;
+
+typedef struct _edit_patch
+{
+    edit_kind kind;
+    int segment;
+    int field;
+    int rep;
+    int comp;
+    int order;          /* keeps patches to one segment in sequence */
+    span value;         /* into message_edit->values, escaped */
+} edit_patch;
+
+typedef struct _message_edit
+{
+    const message_view *mv;
+
+    int len;            /* number of patches */
+    int cap;
+    edit_patch *patches;
+
+    char *values;       /* patch values */
+    size_t used;
+    size_t size;
+
+    char *lines;        /* rebuilt segments */
+    size_t lused;
+    size_t lsize;
+    span *rebuilt;      /* into lines, one per patched segment */
+
+    char *work;         /* the segment being rebuilt */
+    size_t wsize;
+} message_edit;
+
+/**
+ * \fn message_edit_ctor
+ * \brief
+ *      Constructor for an edit of mv, with no patches. The view, and
+ *      its buffer, must outlive the edit.
+ */
+
+message_edit * message_edit_ctor(message_edit *self, const message_view *mv);
+
+/**
+ * \fn message_edit_field
+ * \brief
+ *      Replaces a field. The value may hold repetition, component and
+ *      subcomponent separators; field separators, CR and LF in it are
+ *      escaped. Missing fields are added.
+ *
+ * \returns false if the segment does not exist, or for MSH-1 and 
+ *      MSH-2, which can't be edited.
+ */
+
+bool message_edit_field(message_edit *self, int seg, int field, const char *value, size_t len);
+
+/**
+ * \fn message_edit_component
+ * \brief
+ *      Replaces one component of one repetition of a field. The value
+ *      is plain text: any separator in it is escaped. Missing fields, 
+ *      repetitions and components are added.
+ *
+ * \returns false if the segment does not exist, comp is less than 1,
+ *      or for MSH-1 and MSH-2.
+ */
+
+bool message_edit_component(message_edit *self, int seg, int field, int rep, int comp,
+                            const char *value, size_t len);
+
+/**
+ * \fn message_edit_segment
+ * \brief
+ *      Replaces a whole segment with line, which is written as it is
+ *      and must not hold a segment terminator. A NULL or empty line
+ *      removes the segment.
+ *
+ * \returns false if the segment does not exist.
+ */
+
+bool message_edit_segment(message_edit *self, int seg, const char *line, size_t len);
+
+/**
+ * \fn message_edit_serialize
+ * \brief
+ *      Describes the edited message in out, replacing what out held.
+ *      The iovecs point into the edit and the original buffer, so both
+ *      must stay as they are until out has been written.
+ */
+
+serializer * message_edit_serialize(message_edit *self, serializer *out);
+
+/**
+ * \fn message_edit_reset
+ * \brief
+ *      Drops every patch and moves the edit to mv, keeping its storage.
+ */
+
+void message_edit_reset(message_edit *self, const message_view *mv);
+
+/**
+ * \fn message_edit_dtor
+ * \brief
+ *      Destructor for an edit. The view is not touched.
+ */
+
+void message_edit_dtor(message_edit *self);
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_ENCODING_H_
+#define _HL7_ENCODING_H_
+
+#include <stddef.h> /* size_t */
+#include <stdbool.h>
+#include <hl7c/delim.h>
+
+/**
+ * \file encoding.h
+ *
+ * \brief Encoding characters of a message, as declared in MSH-1 and 
+ * MSH-2.
+ *
+ * Each message carries its own field separator and encoding characters
+ * in its header. encoding_detect reads them, and describes them with 
+ * the delimiter sets used by the scanners. The standard |^~\& set is 
+ * a compile-time constant, encoding_standard, so detecting it costs a
+ * couple of short comparisons and parsers can specialize on it (see 
+ * ENCODING_DISPATCH).
+ */
+
+typedef struct _encoding
+{
+    char field;
+    char component;
+    char repetition;
+    char escape;
+    char subcomponent;
+    bool standard;              /* true only for encoding_standard */
+
+    delimset structure;         /* segment terminators and field separator */
+    delimset all;               /* structure, plus the four encoding characters */
+} encoding;
+
+/**
+ * \var encoding_standard
+ * \brief |^~\& - the encoding of nearly all traffic.
+ */
+
+extern const encoding encoding_standard;
+
+/**
+ * \fn encoding_detect
+ * \brief
+ *      Reads MSH-1 and MSH-2 (or those of an FHS or BHS batch header)
+ *      from the start of buf.
+ *
+ * \param buf - raw message. Leading MLLP framing bytes are skipped.
+ * \param len - number of bytes in buf.
+ * \param scratch - filled in when the message uses anything other 
+ *      than the standard characters.
+ * \returns &encoding_standard if the header declares the standard set,
+ *      scratch if it declares anything else, or NULL if buf does not
+ *      start with a header.
+ */
+
+const encoding * encoding_detect(const char *buf, size_t len, encoding *scratch);
+
+/**
+ * \fn encoding_init
+ * \brief
+ *      Builds an encoding from explicit characters. A nul leaves the 
+ *      corresponding standard character in place.
+ *
+ * \returns enc.
+ */
+
+encoding * encoding_init(encoding *enc, char field, char component, char repetition,
+                         char escape, char subcomponent);
+
+/**
+ * \def ENCODING_DISPATCH
+ * \brief
+ *      Calls fn with enc, passing the constant &encoding_standard 
+ *      instead when enc is standard. When fn is an always_inline 
+ *      function this yields a copy specialized on the standard 
+ *      characters, and a generic copy for everything else.
+ */
+
+#define ENCODING_DISPATCH(enc, fn, ...) \
+    ((enc)->standard ? fn(&encoding_standard, __VA_ARGS__) : fn((enc), __VA_ARGS__))
+
+#endif
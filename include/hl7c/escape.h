@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_ESCAPE_H_
+#define _HL7_ESCAPE_H_
+
+#include <stddef.h> /* size_t */
+
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+
+/**
+ * \file escape.h
+ *
+ * \brief HL7 escape sequences.
+ *
+ * A reserved character inside a value is written as an escape 
+ * sequence: \F\ for the field separator, \S\ component, \T\ 
+ * subcomponent, \R\ repetition, \E\ the escape character, and \X0D\ 
+ * or \X0A\ for a carriage return or line feed.
+ *
+ * Which characters count as reserved depends on what the value is. A 
+ * field as parsed still holds its component and repetition separators,
+ * so only enc->structure (field separator, CR and LF) may be escaped 
+ * in it. Plain text going into a component or subcomponent needs 
+ * enc->all. The encoder searches for reserved characters with the 
+ * vector kernels of delim.h, and copies the runs between them whole.
+ *
+ * Decoding only ever shrinks a value, so it can be done in place. It 
+ * looks for the escape character with memchr and copies the runs 
+ * between sequences whole, so a value with nothing to decode costs a
+ * single scan. Sequences other than the separators and \Xhh..\, such
+ * as the formatting commands of FT values, are left as they are.
+ */
+
+/**
+ * \fn escape_size
+ * \brief
+ *      Gets the length of s once escaped.
+ *
+ * \param set - the characters to escape: &enc->structure or &enc->all.
+ * \returns the exact number of bytes escape_encode will write.
+ */
+
+size_t escape_size(const encoding *enc, const delimset *set, const char *s, size_t n);
+
+/**
+ * \fn escape_encode
+ * \brief
+ *      Writes s to dst, escaping the characters in set.
+ *
+ * \param dst - room for escape_size(enc, set, s, n) bytes. Nothing is
+ *      nul terminated.
+ * \returns the number of bytes written.
+ */
+
+size_t escape_encode(const encoding *enc, const delimset *set, char *dst, const char *s, size_t n);
+
+/**
+ * \fn escape_decode
+ * \brief
+ *      Writes s to dst, replacing escape sequences with what they 
+ *      stand for.
+ *
+ *      Only whole values should be decoded: a component, or a 
+ *      subcomponent, but not a field that still holds separators.
+ *
+ * \param dst - room for n bytes. It may be s itself. Nothing is nul
+ *      terminated.
+ * \returns the number of bytes written, never more than n.
+ */
+
+size_t escape_decode(const encoding *enc, char *dst, const char *s, size_t n);
+
+#endif
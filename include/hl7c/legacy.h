@@ -0,0 +1,62 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_LEGACY_H_
+#define _HL7_LEGACY_H_
+
+#include <hl7c/segment.h>
+#include <hl7c/message.h>
+
+/**
+ * \file legacy.h
+ *
+ * \brief Old-style method calls on segments, messages and iterators.
+ *
+ * Methods used to be pointers in every object, called as
+ * seg->push(seg, item). They now live in one table per type, called as
+ * seg->vt->push(seg, item). Including this header, after everything 
+ * else, lets old call sites compile unchanged. Each macro below inserts
+ * the vt, so obj->method(args) becomes obj->vt->method(args). The 
+ * structures are the same either way.
+ *
+ * The macros take over these names wherever they are followed by a 
+ * parenthesis. A file that includes this header must not also call 
+ * obj->vt->method(...), or call functions by these names; that 
+ * includes push() on an Array (scan.h).
+ */
+
+#define push(...)   vt->push(__VA_ARGS__)
+#define parse(...)  vt->parse(__VA_ARGS__)
+#define begin(...)  vt->begin(__VA_ARGS__)
+#define end(...)    vt->end(__VA_ARGS__)
+#define first(...)  vt->first(__VA_ARGS__)
+#define last(...)   vt->last(__VA_ARGS__)
+#define next(...)   vt->next(__VA_ARGS__)
+#define dtor(...)   vt->dtor(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_LISTENER_H_
+#define _HL7_LISTENER_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+#include <sys/uio.h>    /* struct iovec */
+
+#include <hl7c/arena.h>
+#include <hl7c/mllp.h>
+
+/**
+ * \file listener.h
+ *
+ * \brief An event-driven MLLP server.
+ *
+ * A listener accepts connections on one port and serves all of them
+ * from a single thread with epoll. Connections are persistent: each 
+ * has its own mllp_ring, and every complete frame that arrives on it 
+ * is passed to the handler, which may answer with connection_send or
+ * connection_sendv. Replies to the messages of one read are queued 
+ * and written together, in one send, once the handler has seen them 
+ * all. Sockets are non-blocking throughout; replies that can't be 
+ * written at once stay queued on the connection and are finished when
+ * the socket drains.
+ *
+ * A listener does nothing on its own: listener_poll waits once and 
+ * handles whatever is ready, and listener_run calls it until 
+ * listener_stop. Its arena, pool, is scratch space for the handler 
+ * (reached as conn->owner->pool) and is reset at the end of every 
+ * listener_poll, so anything allocated there lasts for the batch of 
+ * messages that poll handled and no longer.
+ *
+ * To use more than one core, a listener_group runs several listeners
+ * on the same port with SO_REUSEPORT, one per thread. The kernel
+ * spreads new connections across them, and a connection then stays
+ * with the listener that accepted it for its whole life, so messages
+ * from one sender are still handled in order. The listeners share 
+ * nothing: each has its own socket, epoll set, rings, arena and stats.
+ * Threads need the library built with HAVE_PTHREAD; without it a
+ * group has one listener.
+ *
+ * Built with HAVE_IO_URING, a listener drives its sockets through
+ * io_uring instead of epoll when the kernel is new enough (6.1): one
+ * multishot accept, one multishot receive per connection into a pool
+ * of buffers shared by all of them, and the same one send per batch
+ * of replies. A round of waiting, reading and replying is then a 
+ * system call or two for all connections together, rather than a few
+ * per connection. The handler sees no difference. Older kernels get 
+ * epoll.
+ */
+
+#define LISTENER_RING   (64 * 1024)     /* default receive ring per connection */
+#define LISTENER_EVENTS 64              /* events handled per wait */
+#define LISTENER_BUFS   128             /* io_uring receive buffers per listener */
+#define LISTENER_BUFSIZE (16 * 1024)    /* and the size of each */
+
+typedef enum _listener_backend
+{
+    LISTENER_AUTO = 0,          /* io_uring if there is one, else epoll */
+    LISTENER_EPOLL,
+    LISTENER_URING,
+} listener_backend;
+
+struct _listener;
+
+typedef struct _connection
+{
+    int fd;
+    struct _listener *owner;
+    mllp_ring *ring;
+    bool closing;               /* close once the handler returns */
+    bool eof;                   /* the peer is done; close once out drains */
+
+    char *out;                  /* reply bytes not yet written */
+    size_t outlen;
+    size_t outoff;
+    size_t outcap;
+
+    /* io_uring only: out is swapped in here while it is being sent. */
+    bool recving;               /* a receive is armed */
+    bool sending;
+    char *sendbuf;
+    size_t sendlen;
+    size_t sendoff;
+    size_t sendcap;
+
+    void *user;                 /* for the handler; untouched here */
+
+    struct _connection *prev;
+    struct _connection *next;
+} connection;
+
+/* Called for each message; msg is only valid during the call. */
+typedef void (*listener_fn)(connection *conn, const char *msg, size_t len, void *user);
+
+typedef struct _listener_stats
+{
+    uint64_t accepted;
+    uint64_t closed;
+    uint64_t messages;
+    uint64_t bytes;             /* received */
+    uint64_t overflows;         /* connections dropped for a frame too big */
+} listener_stats;
+
+typedef struct _listener
+{
+    int fd;                     /* listening socket */
+    int epfd;
+    int wakefd;                 /* eventfd, for listener_stop */
+    int port;
+
+    listener_backend backend;   /* LISTENER_EPOLL or LISTENER_URING */
+    struct _uring *ring;        /* LISTENER_URING only */
+    connection *current;        /* whose messages are being handled */
+
+    listener_fn handler;
+    void *user;
+    size_t ringsize;            /* for new connections */
+    arena *pool;                /* for the handler; reset every poll */
+
+    bool running;
+    int nconns;
+    connection *conns;
+
+    listener_stats stats;
+} listener;
+
+/**
+ * \fn listener_ctor
+ * \brief
+ *      Constructor for a listener, bound and listening.
+ *
+ * \param host - address to listen on, or NULL for all of them.
+ * \param port - port to listen on, or 0 for any; see self->port.
+ * \param handler - called for every message received.
+ * \returns the listener, or NULL with errno set if the socket couldn't
+ *      be set up.
+ */
+
+listener * listener_ctor(listener *self, const char *host, int port,
+                         listener_fn handler, void *user);
+
+/**
+ * \fn listener_ctor_backend
+ * \brief
+ *      listener_ctor, choosing how sockets are driven. An io_uring 
+ *      listener must always be polled from the same thread.
+ *
+ * \returns NULL with errno ENOSYS for LISTENER_URING, if io_uring is 
+ *      not built in or the kernel lacks what the listener needs.
+ */
+
+listener * listener_ctor_backend(listener *self, const char *host, int port,
+                                 listener_backend backend, listener_fn handler, void *user);
+
+/**
+ * \fn listener_poll
+ * \brief
+ *      Waits up to ms (-1 for ever) for something to happen, and deals
+ *      with all of it: new connections, messages, replies and closes.
+ *
+ * \returns the number of messages handled, or -1 if epoll failed.
+ */
+
+int listener_poll(listener *self, int ms);
+
+/**
+ * \fn listener_run
+ * \brief
+ *      Calls listener_poll until listener_stop is called.
+ */
+
+void listener_run(listener *self);
+
+/**
+ * \fn listener_stop
+ * \brief
+ *      Makes listener_run return. Can be called from a handler, or
+ *      from another thread.
+ */
+
+void listener_stop(listener *self);
+
+/**
+ * \fn listener_dtor
+ * \brief
+ *      Closes every connection and the listening socket.
+ */
+
+void listener_dtor(listener *self);
+
+typedef struct _listener_group
+{
+    int port;
+    int nworkers;
+    listener **workers;         /* one per thread */
+} listener_group;
+
+/**
+ * \fn listener_group_ctor
+ * \brief
+ *      Constructor for a group of n listeners on one port.
+ *
+ * Every listener starts with the same handler and user; to give each
+ * worker its own state, set workers[i]->user before listener_group_run.
+ *
+ * \param n - the number of workers, or 0 for one per online CPU.
+ * \returns the group, or NULL with errno set if any socket couldn't
+ *      be set up.
+ */
+
+listener_group * listener_group_ctor(listener_group *self, const char *host, int port,
+                                     int n, listener_fn handler, void *user);
+
+/**
+ * \fn listener_group_run
+ * \brief
+ *      Runs every worker on its own thread, the first on the calling
+ *      one, until listener_group_stop.
+ */
+
+void listener_group_run(listener_group *self);
+
+/**
+ * \fn listener_group_stop
+ * \brief
+ *      Stops every worker. Can be called from a handler, or from 
+ *      another thread.
+ */
+
+void listener_group_stop(listener_group *self);
+
+/**
+ * \fn listener_group_stats
+ * \brief
+ *      Sums the stats of every worker into total. Exact once 
+ *      listener_group_run has returned; approximate while it runs.
+ */
+
+void listener_group_stats(const listener_group *self, listener_stats *total);
+
+/**
+ * \fn listener_group_dtor
+ * \brief
+ *      Destroys every listener in the group.
+ */
+
+void listener_group_dtor(listener_group *self);
+
+/**
+ * \fn connection_sendv
+ * \brief
+ *      Sends n iovecs on conn, queuing whatever can't be written yet.
+ *
+ * \returns false if the connection failed; it will be closed.
+ */
+
+bool connection_sendv(connection *conn, const struct iovec *iov, int n);
+
+/**
+ * \fn connection_send
+ * \brief
+ *      Sends len bytes on conn, as connection_sendv.
+ */
+
+bool connection_send(connection *conn, const void *buf, size_t len);
+
+/**
+ * \fn connection_close
+ * \brief
+ *      Closes conn once the handler returns, or, for a connection 
+ *      other than the one being handled, on the next listener_poll.
+ *      Queued replies are dropped.
+ */
+
+void connection_close(connection *conn);
+
+#endif
@@ -38,12 +38,35 @@
 
 #include <hl7c/segment.h>
 
-typedef struct _message
+/* Where each segment ID occurs in a message, in order. */
+typedef struct _segindex_entry
 {
-    int len;
-    segment **segments;
+    segid id;       /* SEG_NONE for an empty slot */
+    int count;
+    int cap;
+    int *at;        /* positions in message->segments */
+} segindex_entry;
+
+/* Open-addressed table of segindex entries, keyed by segment ID. */
+typedef struct _segindex
+{
+    int cap;        /* slots; a power of two */
+    int used;
+    segindex_entry *slots;
+} segindex;
+
+/*
+ * As with segments, methods live in one constant table per type. Call
+ * them as msg->vt->parse(msg, fp, sep, delim), or as the functions 
+ * declared below, e.g. message_parse(msg, fp, sep, delim). See 
+ * hl7c/legacy.h for code written as msg->parse(msg, fp, sep, delim).
+ */
+
+struct _message;
+struct _message_iter;
 
-    /* member functions */
+typedef struct _message_class
+{
     struct _message *(*push)(struct _message *, segment *);
 
     segment *(*begin)(struct _message *);
@@ -53,7 +76,7 @@ typedef struct _message
     int (*last)(struct _message *);
 
 /**
- * \fn message->parse(message *msg, FILE *fp, char *sep, char *delim)
+ * \fn message->vt->parse(message *msg, FILE *fp, char *sep, char *delim)
  * \brief
  *      Parses over a file stream, and builds out segment objects
  *      within the message object.
@@ -66,20 +89,36 @@ typedef struct _message
 
     struct _message *(*parse)(struct _message *, FILE *, const char *, const char *);
     void (*dtor)(struct _message *);
+} message_class;
+
+typedef struct _message_iter_class
+{
+    segment *(*begin)(struct _message *);   /* the message's first segment */
+    segment *(*end)(struct _message_iter *);
+    void *(*next)(struct _message_iter *);
+    void (*dtor)(struct _message_iter *);
+} message_iter_class;
+
+extern const message_class message_methods;
+extern const message_iter_class message_iter_methods;
+
+typedef struct _message
+{
+    const message_class *vt;
+    int len;
+    int cap;
+    segment **segments;
+    arena *pool;    /* NULL, or the arena everything is allocated from */
+    segindex index; /* kept up to date by push */
 } message;
 
 typedef struct _message_iter
 {
+    const message_iter_class *vt;
     int first;
     int last;
     int state;
     message * klass;
-
-    /* member functions */
-    segment *(*begin)(struct _message *);
-    segment *(*end)(struct _message_iter *);
-    void *(*next)(struct _message_iter *);
-    void (*dtor)(struct _message_iter *);
 } message_iter;
 
 
@@ -96,6 +135,22 @@ typedef struct _message_iter
 
 message * message_ctor(message *self);
 
+/**
+ * \fn message_ctor_arena
+ * \brief 
+ *      Constructs a message that allocates itself, its segments and 
+ *      their fields from pool. message_dtor then resets the arena 
+ *      instead of freeing anything, so one arena should back one 
+ *      message at a time. Reusing the arena for the next message keeps
+ *      its memory.
+ *
+ * \param self - the message we're initializing.
+ * \param pool - the arena to allocate from, or NULL for the heap.
+ * \returns the initialized message.
+ */
+
+message * message_ctor_arena(message *self, arena *pool);
+
 /**
  * \fn message_push
  * \brief 
@@ -108,6 +163,39 @@ message * message_ctor(message *self);
 
 message * message_push(message *self, segment *seg);
 
+/* message_reserve, message_grow, message_shrink_to_fit and 
+ * message_append; see vector.h. Appended segments belong to the 
+ * message, and are indexed for message_find as push does.
+ */
+
+HL7_VECTOR_DECLARE(message, message, segment *)
+
+/**
+ * \fn message_find
+ * \brief 
+ *      Gets an occurrence of a segment, by ID. Each push records where
+ *      the segment went, so this is a table lookup, not a search.
+ *
+ * \param self - the message we're referencing
+ * \param id - the segment ID, e.g. SEG_PID.
+ * \param n - which occurrence, counting from 0.
+ * \returns the segment, or NULL if the message has fewer than n + 1 of them.
+ */
+
+segment * message_find(message *self, segid id, int n);
+
+/**
+ * \fn message_count
+ * \brief 
+ *      Counts the occurrences of a segment, by ID.
+ *
+ * \param self - the message we're referencing
+ * \param id - the segment ID, e.g. SEG_OBX.
+ * \returns the number of segments with that ID.
+ */
+
+int message_count(message *self, segid id);
+
 /**
  * \fn message_begin
  * \brief 
@@ -162,8 +250,45 @@ int message_last(message *self);
 
 void message_dtor(message *self);
 
+/* message cursors */
+
+/*
+ * Stack cursors over a message's segments, as for segment_cursor:
+ *
+ *      HL7_FOREACH_SEGMENT(msg, seg)
+ *          HL7_FOREACH_FIELD(seg, field)
+ *              ...
+ */
+
+typedef struct _message_cursor
+{
+    message *klass;
+    int pos;        /* index of the next segment */
+} message_cursor;
+
+static inline message_cursor
+message_cursor_at(message *self)
+{
+    message_cursor c = { self, 0 };
+    return c;
+}
+
+/* Returns the next segment, or NULL past the last one. */
+
+static inline segment *
+message_cursor_next(message_cursor *c)
+{
+    return c->pos < c->klass->len ? c->klass->segments[c->pos++] : NULL;
+}
+
+#define HL7_FOREACH_SEGMENT(msg, seg) \
+    for(message_cursor _hl7_mc = message_cursor_at(msg); \
+        ((seg) = message_cursor_next(&_hl7_mc)) != NULL; )
+
 /* message iterator member functions */
 
+/* Iterators are heap allocated; prefer a message_cursor. */
+
 message_iter * message_iter_ctor(message *self);
 
 /**
@@ -209,6 +334,11 @@ void message_iter_dtor(message_iter *i);
 
 /**
  * \fn message_parse
+ * \brief
+ *      Reads fp, splitting it into segments on sep[0] and into fields
+ *      on the field separator declared in MSH-1. delim[0] is only used
+ *      when the data has no MSH header. Either may be NULL, for '\r' 
+ *      and '|' respectively.
  */
 
 message * message_parse(message *msg, FILE *fp, const char *sep, const char *delim);
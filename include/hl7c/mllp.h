@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_MLLP_H_
+#define _HL7_MLLP_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <stdint.h>     /* uint64_t */
+#include <sys/types.h>  /* ssize_t */
+#include <sys/uio.h>    /* struct iovec */
+
+/**
+ * \file mllp.h
+ *
+ * \brief MLLP framing: VT <message> FS CR.
+ *
+ * An mllp_ring is a per-connection receive buffer that also finds the
+ * frames in it. Data is read straight into the ring, and complete 
+ * frames are handed out as pointers into it, so a message is never 
+ * copied on its way from the socket to the parser. Frames split across
+ * reads, and several frames in one read, are both fine; bytes outside
+ * any frame are dropped.
+ *
+ * Where the system allows it the ring's memory is mapped twice, back 
+ * to back, so that a frame which wraps around the end of the ring is 
+ * still contiguous. Otherwise the ring is a flat buffer whose unread 
+ * bytes are moved to the front when it fills up.
+ */
+
+#define MLLP_START  0x0b    /* VT */
+#define MLLP_END    0x1c    /* FS, followed by CR */
+
+typedef struct _mllp_ring
+{
+    char *base;
+    size_t size;
+    bool mirrored;      /* base is mapped twice; positions wrap */
+    bool overflow;      /* a frame doesn't fit in the ring */
+
+    uint64_t head;      /* first byte still needed */
+    uint64_t tail;      /* end of the data */
+    uint64_t scan;      /* bytes up to here have been searched */
+    uint64_t start;     /* first byte of the current frame */
+    bool inframe;
+} mllp_ring;
+
+/**
+ * \fn mllp_ring_ctor
+ * \brief
+ *      Constructor for a ring that can hold frames of up to size - 1
+ *      bytes. size is rounded up to a power of two of at least a page.
+ */
+
+mllp_ring * mllp_ring_ctor(mllp_ring *self, size_t size);
+
+/**
+ * \fn mllp_ring_space
+ * \brief
+ *      Gets where the next bytes should be written, and how many fit.
+ *      Frames handed out before are no longer valid once anything has
+ *      been written.
+ */
+
+char * mllp_ring_space(mllp_ring *self, size_t *avail);
+
+/**
+ * \fn mllp_ring_commit
+ * \brief
+ *      Adds the n bytes just written at mllp_ring_space.
+ */
+
+void mllp_ring_commit(mllp_ring *self, size_t n);
+
+/**
+ * \fn mllp_ring_read
+ * \brief
+ *      Reads once from fd into the ring.
+ *
+ * \returns what read returned. 0 when the ring is full, as well as at
+ *      end of file; see overflow.
+ */
+
+ssize_t mllp_ring_read(mllp_ring *self, int fd);
+
+/**
+ * \fn mllp_ring_next
+ * \brief
+ *      Gets the next complete frame, without its framing bytes.
+ *
+ * \param frame - set to the frame, inside the ring. Valid until more
+ *      is written to the ring.
+ * \returns false if no complete frame has arrived yet.
+ */
+
+bool mllp_ring_next(mllp_ring *self, const char **frame, size_t *len);
+
+/**
+ * \fn mllp_ring_reset
+ * \brief
+ *      Drops everything in the ring, and clears an overflow.
+ */
+
+void mllp_ring_reset(mllp_ring *self);
+
+/**
+ * \fn mllp_ring_dtor
+ * \brief
+ *      Destructor for the ring.
+ */
+
+void mllp_ring_dtor(mllp_ring *self);
+
+/**
+ * \fn mllp_frame_end
+ * \brief
+ *      Finds the end of the first frame in buf, FS CR included, for 
+ *      tcp_recv_frame. Only bytes from scanned on are new.
+ *
+ * \returns the length of the frame, or 0 if it isn't complete.
+ */
+
+size_t mllp_frame_end(const char *buf, size_t len, size_t scanned, void *user);
+
+/**
+ * \fn mllp_frame
+ * \brief
+ *      Fills three iovecs with msg and its framing, for writev.
+ *
+ * \returns the number of iovecs used.
+ */
+
+int mllp_frame(struct iovec *iov, const char *msg, size_t len);
+
+/**
+ * \fn mllp_encode
+ * \brief
+ *      Writes msg, framed, to dst, which has room for len + 3 bytes.
+ *
+ * \returns the number of bytes written.
+ */
+
+size_t mllp_encode(char *dst, const char *msg, size_t len);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_MSH_H_
+#define _HL7_MSH_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+
+#include <hl7c/view.h>
+
+/**
+ * \file msh.h
+ *
+ * \brief Reading the message header without parsing the message.
+ *
+ * Routing and acknowledging only need a handful of MSH fields. 
+ * hl7_msh_peek finds them in the raw buffer, looks no further than the
+ * end of the MSH segment, and allocates nothing, so it can run on 
+ * every message before deciding whether it is worth parsing at all.
+ */
+
+#define MSH_PEEK_FIELDS 13  /* the name, MSH-1, and up to MSH-12 */
+
+typedef struct _msh_header
+{
+    char field;             /* MSH-1 */
+    char component;         /* from MSH-2, or the standard ones */
+    char repetition;
+    char escape;
+    char subcomponent;
+
+    span segment;           /* the whole MSH segment, without its terminator */
+    int nfields;            /* fields found, counting the name and MSH-1 */
+    span fields[MSH_PEEK_FIELDS];   /* fields[i] is MSH-i */
+} msh_header;
+
+/**
+ * \fn hl7_msh_peek
+ * \brief
+ *      Finds MSH-1 to MSH-12 of the message in buf.
+ *
+ *      MLLP framing and blank lines before the header are skipped.
+ *      fields[0] is the segment name and fields[1] the field 
+ *      separator; fields past the end of the segment are left empty.
+ *
+ * \returns false if buf doesn't start with an MSH segment.
+ */
+
+bool hl7_msh_peek(const char *buf, size_t len, msh_header *hdr);
+
+/**
+ * \fn msh_field
+ * \brief
+ *      Gets MSH-i, as a pointer into buf.
+ *
+ * \param len - set to the length of the field.
+ */
+
+static inline const char *
+msh_field(const msh_header *hdr, const char *buf, int i, size_t *len)
+{
+    *len = hdr->fields[i].len;
+    return buf + hdr->fields[i].off;
+}
+
+#endif
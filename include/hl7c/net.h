@@ -35,12 +35,31 @@
 #include <arpa/inet.h>
 #include <netdb.h> 
 #include <time.h>
+#include <poll.h>
+
+/* How tcp_recv_frame ended. */
+typedef enum
+{
+    TCP_FRAME = 0,      /* a complete frame arrived */
+    TCP_TIMEOUT,        /* the time ran out first */
+    TCP_CLOSED,         /* the peer closed the connection first */
+    TCP_TOOBIG,         /* max bytes arrived first */
+    TCP_ERROR           /* recv or poll failed; see errno */
+} tcp_status;
+
+/* Given the len bytes received so far, of which the first scanned 
+ * were seen by the previous call, returns the length of the frame at 
+ * the start of buf, or 0 if it isn't complete yet. 
+ */
+typedef size_t (*tcp_frame_fn)(const char *buf, size_t len, size_t scanned, void *user);
 
 
 //int tcp_connect(const char *host, int port);
 bool tcp_connect(const char *host, int port, int *sockfd);
 bool tcp_send(int sockfd, char *buf, int ms, int *sent);
 char * tcp_recv(int sockfd, int ms, int max, int *total);
+tcp_status tcp_recv_frame(int sockfd, int ms, size_t max, tcp_frame_fn complete, void *user,
+                          char **buf, size_t *len);
 bool sock_create(int *sockfd);
 
 bool set_recv_wait(int sockfd, int ms);
@@ -32,6 +32,7 @@
 #include <ctype.h>
 
 int getsize(const char *path);
+char * slurp(FILE *fp, size_t *len);
 void die(FILE *err, int code, const char *fmt, ...);
 FILE * redirect(const char *path, const char *mode, FILE *stream);
 void usage(FILE * stream, int code);
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_QUERY_H_
+#define _HL7_QUERY_H_
+
+#include <stddef.h> /* size_t */
+
+#include <hl7c/segid.h>
+
+/**
+ * \file query.h
+ *
+ * \brief Compiled path queries over raw messages.
+ *
+ * A set of paths is compiled once into a query, which can then be run
+ * over any number of messages. Each run is a single pass: segments the
+ * query doesn't mention are only searched for their terminator, and in
+ * the ones it does, fields are only walked as far as the last one 
+ * wanted. Nothing is allocated and nothing is copied; the values found
+ * point into the caller's buffer.
+ *
+ * Paths look like
+ *
+ *      SEG[occurrence]-field(repetition)-component-subcomponent
+ *
+ * e.g. "PID-5", "PID-5-2", "PID-3(2)-1" or "OBX[3]-5". Numbers are 
+ * those of the standard, so all count from 1, and MSH-1 is the field 
+ * separator itself. Everything after the field number is optional: a
+ * missing occurrence or repetition means the first, and a path that 
+ * stops early yields the whole of that level, so "PID-5" is the entire
+ * field, every repetition included.
+ */
+
+typedef struct _query_path
+{
+    segid seg;
+    int occurrence;         /* from 1 */
+    int field;              /* from 1 */
+    int rep;                /* from 0, -1 for the whole field */
+    int comp;               /* from 1, 0 for the whole repetition */
+    int sub;                /* from 1, 0 for the whole component */
+    int index;              /* position among the paths compiled */
+} query_path;
+
+/* The run of paths, sorted by occurrence and field, for one segment. */
+typedef struct _query_segment
+{
+    segid seg;
+    int first;
+    int n;
+} query_segment;
+
+typedef struct _query
+{
+    int n;
+    query_path *paths;
+    int nsegments;
+    query_segment *segments;
+} query;
+
+typedef struct _query_value
+{
+    const char *value;      /* NULL if the message doesn't have it */
+    size_t len;
+} query_value;
+
+/**
+ * \fn query_compile
+ * \brief
+ *      Compiles a set of paths into a query.
+ *
+ * \param paths - the paths, as described above.
+ * \param n - number of paths.
+ * \param bad - if not NULL, receives the index of the first path that
+ *      couldn't be compiled, or -1.
+ * \returns the query, or NULL if any path is malformed.
+ */
+
+query * query_compile(const char *const *paths, int n, int *bad);
+
+/**
+ * \fn query_run
+ * \brief
+ *      Runs a query over one raw message.
+ *
+ * \param buf - the message, optionally framed as MLLP.
+ * \param len - length of buf.
+ * \param out - n values, one per path, in the order they were compiled.
+ * \returns the number of paths found.
+ */
+
+int query_run(const query *self, const char *buf, size_t len, query_value *out);
+
+/**
+ * \fn query_dtor
+ * \brief
+ *      Destructor for a query.
+ */
+
+void query_dtor(query *self);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_SAX_H_
+#define _HL7_SAX_H_
+
+#include <stddef.h> /* size_t */
+#include <stdbool.h>
+
+/**
+ * \file sax.h
+ *
+ * \brief Event-driven parsing, straight over the raw buffer.
+ *
+ * sax_parse walks a buffer holding one or more messages and reports 
+ * what it finds to a set of callbacks, without building anything: no 
+ * message, no segments, no copies. Memory use is constant whatever the
+ * size of the input, which suits filters, routers and archive scans 
+ * that only look at a handful of fields.
+ *
+ * Fields are numbered as in message_view: 0 is the segment name, and
+ * for MSH field i is MSH-(i+1). Repetitions count from 0, components 
+ * from 1. Every pointer handed to a callback points into the caller's
+ * buffer, and is not NUL terminated.
+ *
+ * Each callback steers the parse with its return value. Any of them 
+ * may be NULL, which is the same as always continuing; on_component is
+ * only worth setting when components are wanted, as fields are not 
+ * split otherwise.
+ */
+
+typedef enum _sax_action
+{
+    SAX_CONTINUE = 0,
+    SAX_SKIP,           /* skip the rest of this segment */
+    SAX_STOP,           /* stop parsing */
+} sax_action;
+
+typedef struct _sax_handler
+{
+    sax_action (*on_segment_start)(void *user, const char *name, size_t len);
+    sax_action (*on_field)(void *user, int field, const char *value, size_t len);
+    sax_action (*on_component)(void *user, int field, int rep, int comp,
+                               const char *value, size_t len);
+
+    /* seg is the whole segment, without its terminator. SAX_SKIP is 
+     * the same as SAX_CONTINUE here. 
+     */
+    sax_action (*on_segment_end)(void *user, const char *seg, size_t len);
+
+    /* Called at an MLLP end of block, before the next MSH, and at the
+     * end of the buffer, for every message with at least one segment. 
+     */
+    sax_action (*on_message_end)(void *user, int nsegments);
+} sax_handler;
+
+/**
+ * \fn sax_parse
+ * \brief
+ *      Parses every message in buf, calling handler as it goes.
+ *
+ * \param buf - one or more messages, optionally framed as MLLP.
+ * \param len - length of buf.
+ * \param handler - the callbacks.
+ * \param user - passed to the callbacks.
+ * \returns false if a callback stopped the parse, true otherwise.
+ */
+
+bool sax_parse(const char *buf, size_t len, const sax_handler *handler, void *user);
+
+#endif
@@ -29,6 +29,7 @@
 #ifndef _HL7_SCAN_H_
 #define _HL7_SCAN_H_ 1
 #include "hl7c/common.h"
+#include "hl7c/vector.h"
 
 /**
  * \file scan.h
@@ -49,11 +50,14 @@
 
 typedef struct _Array
 {
-    int len;
-    int size;
+    int len;        /* index of the last item */
+    int size;       /* number of items */
     char **data;
+    int cap;
 } Array;
 
+HL7_VECTOR_DECLARE(array, Array, char *)
+
 Array * array_init(void);
 Array * push(Array * array, const char * item);
 Array * array_scan(FILE * fp, char * sep, char * delim);
@@ -68,11 +72,14 @@ void free_array(Array * array);
 
 typedef struct _Multi
 {
-    int len;
-    int size;
+    int len;        /* index of the last member */
+    int size;       /* number of members */
     Array **members;
+    int cap;
 } Multi;
 
+HL7_VECTOR_DECLARE(multi, Multi, Array *)
+
 Multi * multi_init(void);
 Multi * mpush(Multi * multi, Array * array);
 Multi * multi_scan(FILE * fp, char * sep, char * delim);
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_SEGID_H_
+#define _HL7_SEGID_H_
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+/**
+ * \file segid.h
+ *
+ * \brief Segment names as integers.
+ *
+ * A segment name is three characters, so it packs into the low 24 bits
+ * of a uint32_t, first character highest. Comparing two names is then
+ * a single integer compare, and names can key a table directly. Names
+ * that aren't three characters long have no ID, which is 0.
+ */
+
+typedef uint32_t segid;
+
+#define SEGID(a, b, c) (((segid)(unsigned char)(a) << 16) | \
+                        ((segid)(unsigned char)(b) << 8) | \
+                         (segid)(unsigned char)(c))
+
+#define SEG_NONE    0
+
+/* Control */
+#define SEG_MSH     SEGID('M', 'S', 'H')
+#define SEG_MSA     SEGID('M', 'S', 'A')
+#define SEG_ERR     SEGID('E', 'R', 'R')
+#define SEG_EVN     SEGID('E', 'V', 'N')
+#define SEG_NTE     SEGID('N', 'T', 'E')
+#define SEG_FHS     SEGID('F', 'H', 'S')
+#define SEG_FTS     SEGID('F', 'T', 'S')
+#define SEG_BHS     SEGID('B', 'H', 'S')
+#define SEG_BTS     SEGID('B', 'T', 'S')
+
+/* Patient administration */
+#define SEG_PID     SEGID('P', 'I', 'D')
+#define SEG_PD1     SEGID('P', 'D', '1')
+#define SEG_NK1     SEGID('N', 'K', '1')
+#define SEG_PV1     SEGID('P', 'V', '1')
+#define SEG_PV2     SEGID('P', 'V', '2')
+#define SEG_MRG     SEGID('M', 'R', 'G')
+#define SEG_AL1     SEGID('A', 'L', '1')
+#define SEG_DG1     SEGID('D', 'G', '1')
+#define SEG_GT1     SEGID('G', 'T', '1')
+#define SEG_IN1     SEGID('I', 'N', '1')
+#define SEG_IN2     SEGID('I', 'N', '2')
+
+/* Orders and results */
+#define SEG_ORC     SEGID('O', 'R', 'C')
+#define SEG_OBR     SEGID('O', 'B', 'R')
+#define SEG_OBX     SEGID('O', 'B', 'X')
+#define SEG_SPM     SEGID('S', 'P', 'M')
+
+/**
+ * \fn segid_of
+ * \brief
+ *      Gets the ID of a segment name.
+ *
+ * \param name - the name; need not be nul-terminated.
+ * \param len - length of name.
+ * \returns its ID, or SEG_NONE if it isn't three characters.
+ */
+
+static inline segid
+segid_of(const char *name, size_t len)
+{
+    return len == 3 ? SEGID(name[0], name[1], name[2]) : SEG_NONE;
+}
+
+#endif
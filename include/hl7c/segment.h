@@ -35,16 +35,31 @@
 #include <errno.h>  /* errno and various error definitions - ENOMEM, etc. */
 #include <stddef.h> /* offsetof(struct, pos)  - mainly for debugging. */
 
-typedef struct _segment
-{
-    int len;
-    void **data;
+#include <hl7c/arena.h>
+#include <hl7c/segid.h>
+#include <hl7c/vector.h>
+
+/*
+ * Methods are shared: every segment points at the one constant table, 
+ * segment_methods, instead of carrying its own copy of each pointer.
+ * Call them as seg->vt->push(seg, item).
+ *
+ * Every method is also an ordinary function, declared below, e.g. 
+ * segment_push(seg, item). Code still written as seg->push(seg, item)
+ * keeps compiling by including hl7c/legacy.h, which turns such calls 
+ * into calls through the table. The tables take the same arguments as
+ * the old per-object pointers did, iterators' begin included.
+ */
+
+struct _segment;
+struct _segment_iter;
 
-    /* member functions */
+typedef struct _segment_class
+{
     struct _segment *(*push)(struct _segment *, const void *);
 
 /**
- * \fn segment->parse(segment *self, char *line, const char *delim)
+ * \fn segment->vt->parse(segment *self, char *line, const char *delim)
  * \brief
  *      Handles breaking a segment into its own individual fields.
  */
@@ -58,20 +73,36 @@ typedef struct _segment
     int (*last)(struct _segment *);
 
     void (*dtor)(struct _segment *);
+} segment_class;
+
+typedef struct _segment_iter_class
+{
+    void *(*begin)(struct _segment *);  /* the segment's first field */
+    void *(*end)(struct _segment_iter *);
+    void *(*next)(struct _segment_iter *);
+    void (*dtor)(struct _segment_iter *);
+} segment_iter_class;
+
+extern const segment_class segment_methods;
+extern const segment_iter_class segment_iter_methods;
+
+typedef struct _segment
+{
+    const segment_class *vt;
+    int len;
+    int cap;
+    segid id;       /* packed name, set by the first push */
+    void **data;
+    arena *pool;    /* NULL, or the arena everything is allocated from */
 } segment;
 
 typedef struct _segment_iter
 {
+    const segment_iter_class *vt;
     int first;
     int last;
     int state;
     segment * klass;
-
-    /* member functions */
-    void *(*begin)(struct _segment *);
-    void *(*end)(struct _segment_iter *);
-    void (*dtor)(struct _segment_iter *);
-    void *(*next)(struct _segment_iter *);
 } segment_iter;
 
 
@@ -88,6 +119,20 @@ typedef struct _segment_iter
 
 segment * segment_ctor(segment *self);
 
+/**
+ * \fn segment_ctor_arena
+ * \brief 
+ *      Constructs a segment whose fields, and the segment itself, are
+ *      allocated from pool. segment_dtor then does nothing; the memory
+ *      goes back when the arena is reset.
+ *
+ * \param self - the segment we're initializing.
+ * \param pool - the arena to allocate from, or NULL for the heap.
+ * \returns the initialized segment.
+ */
+
+segment * segment_ctor_arena(segment *self, arena *pool);
+
 /**
  * \fn segment_push
  * \brief 
@@ -100,6 +145,25 @@ segment * segment_ctor(segment *self);
 
 segment * segment_push(segment *self, const void *item);
 
+/**
+ * \fn segment_pushn
+ * \brief 
+ *      Pushes a nul-terminated copy of len bytes of item into segment.
+ *
+ * \param a - the segment to contain the item
+ * \param item - the bytes to push. Need not be nul-terminated.
+ * \param len - the number of bytes to copy.
+ * \returns the segment, after the push operation.
+ */
+
+segment * segment_pushn(segment *self, const char *item, size_t len);
+
+/* segment_reserve, segment_grow, segment_shrink_to_fit and 
+ * segment_append; see vector.h. Appended fields belong to the segment.
+ */
+
+HL7_VECTOR_DECLARE(segment, segment, void *)
+
 /**
  * \fn segment_begin
  * \brief 
@@ -154,8 +218,51 @@ int segment_last(segment *self);
 
 void segment_dtor(segment *self);
 
+/* segment cursors */
+
+/*
+ * A cursor is a position in a segment, kept on the stack. Walking one
+ * is plain index arithmetic and allocates nothing:
+ *
+ *      segment_cursor c = segment_cursor_at(seg);
+ *      while((field = segment_cursor_next(&c)) != NULL)
+ *          ...
+ *
+ * or, for the whole segment,
+ *
+ *      HL7_FOREACH_FIELD(seg, field)
+ *          ...
+ */
+
+typedef struct _segment_cursor
+{
+    segment *klass;
+    int pos;        /* index of the next field */
+} segment_cursor;
+
+static inline segment_cursor
+segment_cursor_at(segment *self)
+{
+    segment_cursor c = { self, 0 };
+    return c;
+}
+
+/* Returns the next field, or NULL past the last one. */
+
+static inline void *
+segment_cursor_next(segment_cursor *c)
+{
+    return c->pos < c->klass->len ? c->klass->data[c->pos++] : NULL;
+}
+
+#define HL7_FOREACH_FIELD(seg, field) \
+    for(segment_cursor _hl7_fc = segment_cursor_at(seg); \
+        ((field) = segment_cursor_next(&_hl7_fc)) != NULL; )
+
 /* segment iterator member functions */
 
+/* Iterators are heap allocated; prefer a segment_cursor. */
+
 segment_iter * segment_iter_ctor(segment *self);
 
 /**
@@ -199,4 +306,12 @@ void segment_iter_dtor(segment_iter *i);
  */
 segment * segment_parse(segment *self, char *line, const char *delim);
 
+/**
+ * \fn segment_parsen()
+ * \brief
+ *      Like segment_parse, but takes an explicit length and a single
+ *      delimiter character, and never needs to modify line.
+ */
+segment * segment_parsen(segment *self, const char *line, size_t len, char delim);
+
 #endif
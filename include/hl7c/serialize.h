@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_SERIALIZE_H_
+#define _HL7_SERIALIZE_H_
+
+#include <stddef.h>     /* size_t */
+#include <sys/types.h>  /* ssize_t */
+#include <sys/uio.h>    /* struct iovec */
+
+#include <hl7c/message.h>
+#include <hl7c/view.h>
+#include <hl7c/encoding.h>
+
+/**
+ * \file serialize.h
+ *
+ * \brief Turning messages back into wire bytes.
+ *
+ * A message can be written into a buffer of exactly the right size, 
+ * found beforehand with message_serialize_size, or described as an 
+ * iovec array for writev. In the second form nothing is copied: each
+ * entry points at a field as it already is in memory, and pieces that
+ * happen to be adjacent, like the unchanged lines of a message_view, 
+ * are merged into one entry. Only fields that need escaping are 
+ * written out, into the serializer's own scratch buffer.
+ *
+ * Segments are terminated with '\r'. Field separators inside a field,
+ * and stray CR or LF, are escaped (see escape.h); the encoding 
+ * characters in MSH-2 are written as they are.
+ */
+
+typedef struct _serializer
+{
+    struct iovec *iov;
+    int niov;
+    int iovcap;
+
+    char *scratch;      /* escaped fields */
+    size_t used;
+    size_t cap;
+
+    size_t total;       /* bytes described by iov */
+} serializer;
+
+/**
+ * \fn message_serialize_size
+ * \brief
+ *      Gets the exact size of msg on the wire.
+ *
+ * \param enc - the encoding to write with, or NULL for the standard one.
+ */
+
+size_t message_serialize_size(message *msg, const encoding *enc);
+
+/**
+ * \fn message_serialize
+ * \brief
+ *      Writes msg into out, if it fits.
+ *
+ * \param enc - the encoding to write with, or NULL for the standard one.
+ * \param cap - size of out.
+ * \returns the size of msg on the wire. Nothing is written if this is
+ *      more than cap. out is not nul terminated.
+ */
+
+size_t message_serialize(message *msg, const encoding *enc, char *out, size_t cap);
+
+/**
+ * \fn serializer_ctor
+ * \brief
+ *      Constructor for a serializer. Its storage is kept from one 
+ *      message to the next.
+ */
+
+serializer * serializer_ctor(serializer *self);
+
+/**
+ * \fn serializer_message
+ * \brief
+ *      Describes msg as iovecs, replacing what self held. The iovecs
+ *      point into msg and enc, which must outlive them.
+ *
+ * \param enc - the encoding to write with, or NULL for the standard one.
+ */
+
+serializer * serializer_message(serializer *self, message *msg, const encoding *enc);
+
+/**
+ * \fn serializer_view
+ * \brief
+ *      Describes the segments of mv as iovecs, replacing what self 
+ *      held. Framing and blank lines are dropped; everything else comes
+ *      straight from the view's buffer.
+ */
+
+serializer * serializer_view(serializer *self, const message_view *mv);
+
+/**
+ * \fn serializer_add
+ * \brief
+ *      Appends len bytes at base, merging them with the previous entry
+ *      when they follow on from it in memory.
+ */
+
+void serializer_add(serializer *self, const void *base, size_t len);
+
+/**
+ * \fn serializer_writev
+ * \brief
+ *      Writes everything described to fd, retrying partial writes.
+ *      The iovecs are used up in the process.
+ *
+ * \returns the number of bytes written, or -1 with errno set.
+ */
+
+ssize_t serializer_writev(serializer *self, int fd);
+
+/**
+ * \fn writev_all
+ * \brief
+ *      Writes n iovecs to fd, retrying partial writes and EINTR. The
+ *      iovecs are used up in the process.
+ *
+ * \returns the number of bytes written, or -1 with errno set.
+ */
+
+ssize_t writev_all(int fd, struct iovec *iov, int n);
+
+/**
+ * \fn serializer_reset
+ * \brief
+ *      Forgets what self describes, keeping its storage.
+ */
+
+void serializer_reset(serializer *self);
+
+/**
+ * \fn serializer_dtor
+ * \brief
+ *      Destructor for a serializer.
+ */
+
+void serializer_dtor(serializer *self);
+
+#endif
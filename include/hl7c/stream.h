@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_STREAM_H_
+#define _HL7_STREAM_H_
+
+#include <stddef.h> /* size_t */
+#include <stdbool.h>
+
+#include <hl7c/view.h>      /* span */
+#include <hl7c/encoding.h>
+
+/**
+ * \file stream.h
+ *
+ * \brief Incremental parser, fed with chunks of any size.
+ *
+ * Bytes are handed to stream_parser_feed as they arrive, e.g. straight
+ * from recv(). Every segment is passed to the handler as soon as its 
+ * terminator is seen, and every message as soon as it closes: at an
+ * MLLP end of block, at the next MSH, or at stream_parser_finish. 
+ * Partial segments are carried over between calls and no byte is ever
+ * searched twice.
+ *
+ * Unless the parser was asked to keep whole messages, the bytes of a 
+ * segment are dropped once it has been handed out, so the memory held
+ * per connection is bounded by the longest segment, not the longest 
+ * message.
+ */
+
+typedef struct _stream_handler
+{
+    /* seg is len bytes, without its terminator; fields[i] are offsets 
+     * into seg, numbered as in message_view. Only valid during the call. 
+     */
+    void (*on_segment)(void *user, const char *seg, size_t len,
+                       const span *fields, int nfields);
+
+    /* msg is NULL, and len 0, unless whole messages are kept. */
+    void (*on_message)(void *user, const char *msg, size_t len, int nsegments);
+} stream_handler;
+
+typedef struct _stream_parser
+{
+    const stream_handler *handler;
+    void *user;
+    bool keep;              /* keep each message's bytes until it closes */
+    bool overflow;          /* max was exceeded; see stream_parser_reset */
+
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t max;             /* most bytes ever held, 0 for no limit */
+
+    size_t scan;            /* bytes of buf already searched */
+    size_t seg;             /* start of the current segment */
+    size_t msg;             /* start of the current message */
+    int nsegments;          /* segments seen in the current message */
+
+    const encoding *enc;    /* of the current message */
+    encoding scratch;
+
+    span *fields;
+    int fieldcap;
+} stream_parser;
+
+/**
+ * \fn stream_parser_ctor
+ * \brief
+ *      Constructor for the incremental parser.
+ *
+ * \param self - the parser we're initializing.
+ * \param handler - callbacks for segments and messages. Either may be NULL.
+ * \param user - passed to the callbacks.
+ * \param keep - if true, on_message receives the whole message.
+ * \param max - most bytes to buffer before giving up, 0 for no limit.
+ * \returns the initialized parser.
+ */
+
+stream_parser * stream_parser_ctor(stream_parser *self, const stream_handler *handler,
+                                   void *user, bool keep, size_t max);
+
+/**
+ * \fn stream_parser_feed
+ * \brief
+ *      Parses the next n bytes of input, calling the handler for every
+ *      segment and message completed by them.
+ *
+ * \returns false if the input exceeded the parser's maximum; nothing
+ *      more is parsed until stream_parser_reset is called.
+ */
+
+bool stream_parser_feed(stream_parser *self, const char *buf, size_t n);
+
+/**
+ * \fn stream_parser_finish
+ * \brief
+ *      End of input: hands out any unterminated segment, and closes the
+ *      current message.
+ */
+
+void stream_parser_finish(stream_parser *self);
+
+/**
+ * \fn stream_parser_reset
+ * \brief
+ *      Drops any buffered input and clears an overflow.
+ */
+
+void stream_parser_reset(stream_parser *self);
+
+/**
+ * \fn stream_parser_dtor
+ * \brief
+ *      Destructor for the incremental parser.
+ */
+
+void stream_parser_dtor(stream_parser *self);
+
+#endif
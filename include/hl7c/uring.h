@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_URING_H_
+#define _HL7_URING_H_
+
+#include <stdbool.h>    /* bool */
+#include <stddef.h>     /* size_t */
+#include <linux/io_uring.h>
+
+/**
+ * \file uring.h
+ *
+ * \brief Just enough io_uring for the listener.
+ *
+ * A uring is a submission and a completion queue shared with the 
+ * kernel, set up with the io_uring system calls directly so that 
+ * nothing beyond the kernel headers is needed. It may also own one 
+ * ring of provided buffers, which the kernel fills on its own for 
+ * requests made with IOSQE_BUFFER_SELECT; each completion names the
+ * buffer it used, and the buffer goes back with uring_recycle once 
+ * its contents have been dealt with.
+ *
+ * Only built with HAVE_IO_URING. Requests are filled in by the caller
+ * from uring_sqe; nothing reaches the kernel until uring_submit or 
+ * uring_wait.
+ */
+
+typedef struct _uring
+{
+    int fd;
+    bool enabled;               /* not set up with IORING_SETUP_R_DISABLED, or enabled since */
+
+    void *rings;                /* both queues, in one mapping */
+    size_t ringsize;
+    struct io_uring_sqe *sqes;
+    size_t sqesize;
+
+    unsigned *sqhead;
+    unsigned *sqtail;
+    unsigned *sqarray;
+    unsigned sqmask;
+    unsigned sqentries;
+    unsigned queued;            /* filled in, not yet submitted */
+
+    unsigned *cqhead;
+    unsigned *cqtail;
+    unsigned cqmask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *br;   /* provided buffers */
+    size_t brsize;
+    char *bufs;
+    size_t bufsize;             /* of each */
+    unsigned nbufs;
+    unsigned short bgid;
+} uring;
+
+/**
+ * \fn uring_ctor
+ * \brief
+ *      Constructor for a uring with entries submission slots and cq
+ *      completion slots.
+ *
+ * \param flags - IORING_SETUP_* flags.
+ * \returns the uring, or NULL with errno set if the kernel doesn't 
+ *      have io_uring or doesn't take the flags.
+ */
+
+uring * uring_ctor(uring *self, unsigned entries, unsigned cq, unsigned flags);
+
+/**
+ * \fn uring_buffers
+ * \brief
+ *      Gives the kernel n buffers of size bytes as buffer group bgid.
+ *      n must be a power of two.
+ *
+ * \returns false, with errno set, if the kernel won't take them.
+ */
+
+bool uring_buffers(uring *self, unsigned short bgid, unsigned n, size_t size);
+
+/**
+ * \fn uring_enable
+ * \brief
+ *      Enables a uring set up with IORING_SETUP_R_DISABLED. With 
+ *      IORING_SETUP_SINGLE_ISSUER, the calling thread is then the only
+ *      one that may submit.
+ */
+
+bool uring_enable(uring *self);
+
+/**
+ * \fn uring_sqe
+ * \brief
+ *      Returns a cleared submission entry, submitting what is queued
+ *      first if there are none left.
+ *
+ * \returns NULL if the queue is full and couldn't be submitted.
+ */
+
+struct io_uring_sqe * uring_sqe(uring *self);
+
+/**
+ * \fn uring_submit
+ * \brief
+ *      Hands every queued entry to the kernel without waiting.
+ *
+ * \returns false, with errno set, if io_uring_enter failed.
+ */
+
+bool uring_submit(uring *self);
+
+/**
+ * \fn uring_wait
+ * \brief
+ *      Submits what is queued and waits up to ms (-1 for ever) for at
+ *      least one completion.
+ *
+ * \returns false, with errno set, if io_uring_enter failed; ETIME if
+ *      nothing completed in time.
+ */
+
+bool uring_wait(uring *self, int ms);
+
+/**
+ * \fn uring_cqe
+ * \brief
+ *      Returns the next completion, or NULL if there are none. It stays
+ *      at the head of the queue until uring_seen.
+ */
+
+struct io_uring_cqe * uring_cqe(uring *self);
+
+/**
+ * \fn uring_seen
+ * \brief
+ *      Releases the completion uring_cqe returned.
+ */
+
+void uring_seen(uring *self);
+
+/**
+ * \fn uring_buffer
+ * \brief
+ *      Returns the provided buffer a completion with IORING_CQE_F_BUFFER
+ *      used.
+ */
+
+char * uring_buffer(uring *self, unsigned flags);
+
+/**
+ * \fn uring_recycle
+ * \brief
+ *      Gives that buffer back to the kernel.
+ */
+
+void uring_recycle(uring *self, unsigned flags);
+
+/**
+ * \fn uring_dtor
+ * \brief
+ *      Destructor. Anything still in flight is cancelled by the kernel.
+ */
+
+void uring_dtor(uring *self);
+
+#endif
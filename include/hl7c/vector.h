@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_VECTOR_H_
+#define _HL7_VECTOR_H_
+
+#include <stddef.h> /* size_t */
+#include <string.h> /* memcpy, memset */
+
+#include <hl7c/arena.h>
+
+/**
+ * \file vector.h
+ *
+ * \brief Growable arrays, generated per element type.
+ *
+ * The library's containers (Array, Multi, segment and message) each 
+ * hold a pointer to their elements, a count and a capacity, under 
+ * their own field names. HL7_VECTOR_DEFINE generates the functions 
+ * that manage that storage for one container:
+ *
+ *      name_reserve(self, n)       room for at least n elements, exactly
+ *      name_grow(self, n)          room for n more, doubling as needed
+ *      name_shrink_to_fit(self)    give back unused capacity
+ *      name_append(self, items, n) bulk append, taking ownership
+ *
+ * Growth is geometric, so pushing one element at a time is amortized 
+ * constant, and a caller who knows the final size can reserve it up 
+ * front and never reallocate.
+ *
+ * The parameters are:
+ *
+ *      name   - prefix of the generated functions.
+ *      owner  - the container type.
+ *      type   - the element type.
+ *      data, len, cap - the container's field names.
+ *      spare  - slots kept free after the last element and zeroed;
+ *               1 for containers whose _end returns a NULL.
+ *      pool   - an expression for the arena to use, or NULL for the 
+ *               heap; it may refer to the container as self.
+ *      fixup  - a statement run after name_append, for containers 
+ *               that keep other state in step; it may refer to self
+ *               and to n, the number of elements appended.
+ */
+
+/**
+ * \fn vector_resize
+ * \brief
+ *      Resizes an element array, from pool if it isn't NULL. Out of 
+ *      memory is fatal. Heap arrays resized to 0 are freed, and NULL
+ *      returned.
+ */
+
+void * vector_resize(arena *pool, void *old, size_t oldsize, size_t newsize);
+
+#define HL7_VECTOR_DECLARE(name, owner, type) \
+    void name##_reserve(owner *self, int n); \
+    void name##_grow(owner *self, int n); \
+    void name##_shrink_to_fit(owner *self); \
+    owner * name##_append(owner *self, type const *items, int n);
+
+#define HL7_VECTOR_DEFINE(name, owner, type, data, len, cap, spare, pool, fixup) \
+    static void \
+    name##_resize(owner *self, int want) \
+    { \
+        self->data = vector_resize((pool), self->data, sizeof(type) * self->cap, \
+                                   sizeof(type) * want); \
+        /* New slots start zeroed, spare ones included. */ \
+        if(want > self->cap) \
+            memset(self->data + self->cap, 0, sizeof(type) * (want - self->cap)); \
+        self->cap = want; \
+    } \
+    \
+    void \
+    name##_reserve(owner *self, int n) \
+    { \
+        if(n + (spare) > self->cap) \
+            name##_resize(self, n + (spare)); \
+    } \
+    \
+    void \
+    name##_grow(owner *self, int n) \
+    { \
+        int want = self->cap ? self->cap : 8; \
+        \
+        if(self->len + n + (spare) <= self->cap) \
+            return; \
+        while(want < self->len + n + (spare)) \
+            want *= 2; \
+        name##_resize(self, want); \
+    } \
+    \
+    void \
+    name##_shrink_to_fit(owner *self) \
+    { \
+        /* Arena memory can't be given back piecemeal. */ \
+        if((pool) == NULL && self->cap > self->len + (spare)) \
+            name##_resize(self, self->len + (spare)); \
+    } \
+    \
+    owner * \
+    name##_append(owner *self, type const *items, int n) \
+    { \
+        if(self != NULL && n > 0) \
+        { \
+            name##_grow(self, n); \
+            memcpy(self->data + self->len, items, sizeof(type) * n); \
+            self->len += n; \
+            if(spare) \
+                memset(self->data + self->len, 0, sizeof(type) * (spare)); \
+            fixup; \
+        } \
+        return self; \
+    }
+
+#endif
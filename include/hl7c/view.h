@@ -0,0 +1,257 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#ifndef _HL7_VIEW_H_
+#define _HL7_VIEW_H_
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, realloc, free */
+#include <string.h> /* memcmp */
+#include <stdint.h> /* uint32_t */
+#include <stdbool.h>
+#include <errno.h>  /* ENOMEM */
+
+#include <hl7c/encoding.h>
+#include <hl7c/arena.h>
+
+/**
+ * \file view.h
+ *
+ * \brief Zero-copy views over a raw HL7 buffer.
+ *
+ * A message_view never copies the data it describes. Every segment
+ * and field is recorded as an offset and length into the caller's
+ * buffer, so the buffer must outlive the view. Field storage for the
+ * whole message lives in a single array which is reused when the view
+ * is handed another message, so a long-running receiver stops
+ * allocating once the arrays have grown to fit its largest message.
+ *
+ * The field separator and encoding characters are taken from the 
+ * message's own MSH header. Below the field level, repetitions ('~'), 
+ * components ('^') and subcomponents ('&') are only split out when they are first asked 
+ * for, one level at a time, and the result is cached on the field. 
+ * Fields that are never looked into cost nothing beyond their span.
+ */
+
+typedef struct _span
+{
+    uint32_t off;
+    uint32_t len;
+} span;
+
+typedef struct _segment_view
+{
+    span line;      /* the whole segment, without its terminator */
+    uint32_t first; /* index of the segment's first field in message_view->fields */
+    uint32_t len;   /* number of fields, including the segment name */
+} segment_view;
+
+typedef struct _component_view
+{
+    span whole;
+    int nsubs;                  /* -1 until split */
+    span *subs;
+} component_view;
+
+typedef struct _repetition_view
+{
+    span whole;
+    int ncomps;                 /* -1 until split */
+    component_view *comps;
+} repetition_view;
+
+typedef struct _field_view
+{
+    bool literal;               /* MSH-2: never split */
+    int nreps;
+    repetition_view *reps;
+} field_view;
+
+typedef struct _message_view
+{
+    const char *buf;
+    size_t size;
+
+    const encoding *enc;    /* &encoding_standard, or &scratch */
+    encoding scratch;
+
+    int len;                /* number of segments */
+    int cap;
+    segment_view *segments;
+
+    int nfields;            /* number of fields, across all segments */
+    int fieldcap;
+    span *fields;
+
+    int ntree;              /* entries of tree in use, 0 until first needed */
+    int treecap;
+    field_view **tree;      /* per field, NULL until split */
+
+    arena *text;            /* decoded values, NULL until first needed */
+} message_view;
+
+
+/**
+ * \fn message_view_ctor
+ * \brief
+ *      Constructor for the message_view structure.
+ *
+ * \param self - the view we're initializing.
+ * \returns the initialized, empty view.
+ */
+
+message_view * message_view_ctor(message_view *self);
+
+/**
+ * \fn message_view_parse
+ * \brief
+ *      Breaks buf into segments and fields, without copying.
+ *
+ *      Segments end at a carriage return (a line feed is tolerated as
+ *      well), fields are split on the separator declared in MSH-1, or 
+ *      '|' without a header. Empty lines and MLLP framing bytes are 
+ *      skipped. Any previous contents of the view are
+ *      discarded, but its storage is kept for reuse.
+ *
+ * \param self - the view to fill.
+ * \param buf - raw message. Must outlive the view.
+ * \param len - number of bytes in buf.
+ * \returns self.
+ */
+
+message_view * message_view_parse(message_view *self, const char *buf, size_t len);
+
+/**
+ * \fn message_view_segment
+ * \brief
+ *      Gets the segment at position i.
+ *
+ * \returns the segment, or NULL if i is out of range.
+ */
+
+segment_view * message_view_segment(message_view *self, int i);
+
+/**
+ * \fn message_view_field
+ * \brief
+ *      Gets field i of a segment, as a pointer into the original buffer.
+ *
+ *      Field 0 is the segment name. As with segment_parse, MSH-1 (the
+ *      field separator itself) is not counted, so for MSH field i is
+ *      MSH-(i+1), while for every other segment field i is SEG-i.
+ *
+ * \param len - set to the length of the field. May be NULL.
+ * \returns pointer to the first byte of the field (not nul-terminated),
+ *      or NULL if the field does not exist.
+ */
+
+const char * message_view_field(const message_view *self, const segment_view *seg, int i, size_t *len);
+
+/**
+ * \fn segment_view_is
+ * \brief
+ *      Compares the segment's name with name (e.g. "PID").
+ */
+
+bool segment_view_is(const message_view *self, const segment_view *seg, const char *name);
+
+/**
+ * \fn message_view_get
+ * \brief
+ *      Gets part of a field, splitting it on first use.
+ *
+ *      Repetitions are counted from 0, while components and 
+ *      subcomponents are numbered from 1, as in PID-5-2. A comp or sub
+ *      of 0 means the whole repetition or component, so 
+ *      message_view_get(mv, pid, 5, 0, 2, 0, &len) is the given name,
+ *      and message_view_get(mv, pid, 5, 0, 0, 0, &len) the whole first
+ *      repetition. MSH-2 is never split.
+ *
+ * \param len - set to the length of the part. May be NULL.
+ * \returns pointer into the original buffer, or NULL if the part 
+ *      does not exist.
+ */
+
+const char * message_view_get(message_view *self, const segment_view *seg,
+                              int field, int rep, int comp, int sub, size_t *len);
+
+/**
+ * \fn message_view_text
+ * \brief
+ *      Gets part of a field as message_view_get does, with its escape
+ *      sequences decoded.
+ *
+ *      Values are only decoded when they are read, and only if they 
+ *      hold an escape character; otherwise this is message_view_get.
+ *      Decoded values are kept by the view until it parses another 
+ *      message. Components and subcomponents decode to plain text; a
+ *      whole field or repetition may end up with separators in it 
+ *      that are indistinguishable from real ones.
+ *
+ * \param len - set to the length of the text. May be NULL.
+ * \returns the text, not nul-terminated, or NULL if the part does not
+ *      exist.
+ */
+
+const char * message_view_text(message_view *self, const segment_view *seg,
+                               int field, int rep, int comp, int sub, size_t *len);
+
+/**
+ * \fn message_view_repetitions
+ * \returns the number of repetitions in a field, or 0 if the field 
+ *      does not exist. An empty field has one, empty, repetition.
+ */
+
+int message_view_repetitions(message_view *self, const segment_view *seg, int field);
+
+/**
+ * \fn message_view_components
+ * \returns the number of components in one repetition of a field,
+ *      or 0 if it does not exist.
+ */
+
+int message_view_components(message_view *self, const segment_view *seg, int field, int rep);
+
+/**
+ * \fn message_view_subcomponents
+ * \returns the number of subcomponents in a component, or 0 if it 
+ *      does not exist.
+ */
+
+int message_view_subcomponents(message_view *self, const segment_view *seg,
+                               int field, int rep, int comp);
+
+/**
+ * \fn message_view_dtor
+ * \brief
+ *      Destructor for the view. The underlying buffer is not touched.
+ */
+
+void message_view_dtor(message_view *self);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf, snprintf */
+#include <stdlib.h> /* calloc, free */
+#include <string.h> /* memchr, memcpy, strlen */
+#include <errno.h>  /* ENOMEM */
+#include <inttypes.h> /* PRIu64 */
+
+#include <hl7c/ack.h>
+#include <hl7c/msh.h>
+#include <hl7c/mllp.h>
+#include <hl7c/vector.h>
+#include <hl7c/serialize.h>
+
+/**
+ * \file ack.c
+ * \brief
+ *      ACK generator.
+ */
+
+ack *
+ack_ctor(ack *self, const char *text, bool mllp)
+{
+    self = calloc(1, sizeof(ack));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    self->text = text;
+    self->textlen = text != NULL ? strlen(text) : 0;
+    self->mllp = mllp;
+
+    self->size = 512;
+    self->buf = vector_resize(NULL, NULL, 0, self->size);
+    return self;
+}
+
+/* Appends n bytes at s, growing the buffer if some field is huge. */
+
+static void
+put(ack *self, const void *s, size_t n)
+{
+    size_t want;
+
+    if(self->len + n > self->size)
+    {
+        for(want = self->size * 2; want < self->len + n; want *= 2)
+            ;
+        self->buf = vector_resize(NULL, self->buf, self->size, want);
+        self->size = want;
+    }
+
+    memcpy(self->buf + self->len, s, n);
+    self->len += n;
+}
+
+static void
+put_field(ack *self, const char *msg, span f, char sep)
+{
+    put(self, &sep, 1);
+    put(self, msg + f.off, f.len);
+}
+
+static void
+stamp(ack *self)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+
+    if(now == self->stamped && self->stamplen > 0)
+        return;
+
+    localtime_r(&now, &tm);
+    self->stamplen = strftime(self->stamp, sizeof(self->stamp), "%Y%m%d%H%M%S%z", &tm);
+    self->stamped = now;
+}
+
+bool
+ack_build(ack *self, const char *msg, size_t len, const char *code)
+{
+    msh_header hdr;
+    const span *f = hdr.fields;
+    const char *type;
+    const char *trigger;
+    const char *end;
+    char id[24];
+    size_t n;
+    char sep;
+
+    self->len = 0;
+    self->niov = 0;
+
+    if(!hl7_msh_peek(msg, len, &hdr))
+        return false;
+
+    stamp(self);
+    sep = hdr.field;
+
+    put(self, "MSH", 3);
+    put_field(self, msg, f[2], sep);
+    put_field(self, msg, f[5], sep);
+    put_field(self, msg, f[6], sep);
+    put_field(self, msg, f[3], sep);
+    put_field(self, msg, f[4], sep);
+    put(self, &sep, 1);
+    put(self, self->stamp, self->stamplen);
+    put(self, &sep, 1);
+
+    /* MSH-9: ACK, and the trigger event being answered. */
+    put(self, &sep, 1);
+    put(self, "ACK", 3);
+
+    type = msg + f[9].off;
+
+    if((trigger = memchr(type, hdr.component, f[9].len)) != NULL)
+    {
+        n = f[9].len - (trigger - type);
+        end = memchr(trigger + 1, hdr.component, n - 1);
+        put(self, trigger, end != NULL ? (size_t)(end - trigger) : n);
+    }
+
+    n = snprintf(id, sizeof(id), "%" PRIu64, self->serial++);
+    put(self, &sep, 1);
+    put(self, id, n);
+    put_field(self, msg, f[11], sep);
+    put_field(self, msg, f[12], sep);
+    put(self, "\r", 1);
+
+    put(self, "MSA", 3);
+    put(self, &sep, 1);
+    put(self, code, strlen(code));
+    put_field(self, msg, f[10], sep);
+
+    if(self->text != NULL)
+    {
+        put(self, &sep, 1);
+        put(self, self->text, self->textlen);
+    }
+    put(self, "\r", 1);
+
+    if(self->mllp)
+        self->niov = mllp_frame(self->iov, self->buf, self->len);
+    else
+    {
+        self->iov[0].iov_base = self->buf;
+        self->iov[0].iov_len = self->len;
+        self->niov = 1;
+    }
+    return true;
+}
+
+ssize_t
+ack_send(ack *self, int fd)
+{
+    struct iovec iov[3];
+
+    /* writev_all uses up the iovecs it's given; keep ours. */
+    memcpy(iov, self->iov, sizeof(struct iovec) * self->niov);
+    return writev_all(fd, iov, self->niov);
+}
+
+void
+ack_dtor(ack *self)
+{
+    if(self != NULL)
+    {
+        free(self->buf);
+        free(self);
+    }
+    return;
+}
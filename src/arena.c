@@ -0,0 +1,200 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <hl7c/arena.h>
+
+/**
+ * \file arena.c
+ * \brief
+ *      Bump allocation out of a chain of blocks.
+ */
+
+#define ALIGN (sizeof(max_align_t))
+#define ROUND(n) (((n) + ALIGN - 1) & ~(ALIGN - 1))
+
+static arena_block *
+arena_block_new(arena *a, size_t size)
+{
+    arena_block *b = malloc(sizeof(arena_block) + size);
+
+    if(b == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    a->mallocs++;
+    return b;
+}
+
+arena *
+arena_ctor(arena *self, size_t blocksize)
+{
+    self = calloc(1, sizeof(arena));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    self->blocksize = ROUND(blocksize ? blocksize : ARENA_BLOCK);
+    self->first = self->head = arena_block_new(self, self->blocksize);
+    return self;
+}
+
+void *
+arena_alloc(arena *a, size_t n)
+{
+    arena_block *b = a->head;
+    void *p;
+
+    n = ROUND(n ? n : 1);
+
+    /* Move on to the next block, reusing one left from before a
+     * reset if it is big enough.
+     */
+    while(b->size - b->used < n)
+    {
+        if(b->next == NULL)
+            b->next = arena_block_new(a, n > a->blocksize ? n : a->blocksize);
+        b = b->next;
+        b->used = 0;
+    }
+
+    a->head = b;
+    p = (char *)b->data + b->used;
+    b->used += n;
+    a->last = p;
+    return p;
+}
+
+void *
+arena_calloc(arena *a, size_t n)
+{
+    return memset(arena_alloc(a, n), 0, n);
+}
+
+void *
+arena_realloc(arena *a, void *old, size_t oldsize, size_t newsize)
+{
+    arena_block *b = a->head;
+    size_t start;
+    void *p;
+
+    if(old == NULL)
+        return arena_alloc(a, newsize);
+
+    if(newsize <= oldsize)
+        return old;
+
+    /* The last allocation can simply be extended. */
+    if(old == a->last)
+    {
+        start = (char *)old - (char *)b->data;
+
+        if(b->size - start >= ROUND(newsize))
+        {
+            b->used = start + ROUND(newsize);
+            return old;
+        }
+    }
+
+    p = arena_alloc(a, newsize);
+    memcpy(p, old, oldsize);
+    return p;
+}
+
+char *
+arena_strndup(arena *a, const char *s, size_t n)
+{
+    char *copy = arena_alloc(a, n + 1);
+
+    memcpy(copy, s, n);
+    copy[n] = 0;
+    return copy;
+}
+
+void
+arena_reset(arena *a)
+{
+    arena_block *b, *next;
+    size_t total = 0;
+    size_t keep;
+
+    /* Everything fit in the first block: just rewind, unless a bigger
+     * block left by an earlier message is no longer needed.
+     */
+    if(a->first->next == NULL &&
+       (a->first->size == a->blocksize || a->first->used > a->blocksize))
+    {
+        a->first->used = 0;
+        a->head = a->first;
+        a->last = NULL;
+        return;
+    }
+
+    /* Otherwise swap the chain for one block that would have held it 
+     * all, within reason.
+     */
+    for(b = a->first; b != NULL; b = next)
+    {
+        next = b->next;
+        total += b->used;
+        free(b);
+    }
+
+    keep = ROUND(total);
+    if(keep < a->blocksize)
+        keep = a->blocksize;
+    if(keep > a->blocksize * ARENA_KEEP)
+        keep = a->blocksize * ARENA_KEEP;
+
+    a->first = a->head = arena_block_new(a, keep);
+    a->last = NULL;
+}
+
+void
+arena_dtor(arena *a)
+{
+    arena_block *b, *next;
+
+    if(a != NULL)
+    {
+        for(b = a->first; b != NULL; b = next)
+        {
+            next = b->next;
+            free(b);
+        }
+        free(a);
+    }
+    return;
+}
@@ -37,7 +37,13 @@
  *      handy for HL7 as well.
  */
 
+/* Storage for both kinds; len trails size by one. */
 
+HL7_VECTOR_DEFINE(array, Array, char *, data, size, cap, 0, NULL,
+                  self->len = self->size - 1)
+
+HL7_VECTOR_DEFINE(multi, Multi, Array *, members, size, cap, 0, NULL,
+                  self->len = self->size - 1)
 
 /**
  * \fn array_init
@@ -56,6 +62,7 @@ array_init(void)
     array->data = NULL; /* actual storage - indexed by zero. */
     array->size = 0;
     array->len = 0;
+    array->cap = 0;
     return array;
 }
 
@@ -82,14 +89,7 @@ push(Array *array, const char *item)
 
     if(array != NULL && item != NULL)
     {
-        array->data = realloc(array->data, sizeof(char*) * ++array->size);
-
-        if(array->data == NULL)
-        {
-            fprintf(stderr, "%s: %d: Out of memory!\n",
-                    __func__, __LINE__);
-            exit(ENOMEM);
-        }
+        array_grow(array, 1);
 
         /*
          * Below is almost exactly how strdup is implemented by
@@ -107,8 +107,8 @@ push(Array *array, const char *item)
             exit(ENOMEM);
         }
 
+        array->data[array->size++] = (char*)memcpy(copy, item, len);
         array->len = array->size - 1;
-        array->data[array->len] = (char*)memcpy(copy, item, len);
     }
 
     return array;
@@ -163,6 +163,7 @@ multi_init(void)
     multi->members = NULL; /* actual storage - indexed by zero. */
     multi->size = 0;
     multi->len = 0;
+    multi->cap = 0;
     return multi;
 }
 
@@ -186,17 +187,10 @@ mpush(Multi *multi, Array *array)
 
     if(multi != NULL)
     {
-        multi->members = realloc(multi->members, 
-                                 sizeof(Array *) * ++multi->size);
-        if(multi->members == NULL)
-        {
-            fprintf(stderr, "%s: %d: Out of memory!\n",
-                    __func__, __LINE__);
-            exit(EXIT_FAILURE);
-        }
+        multi_grow(multi, 1);
 
+        multi->members[multi->size++] = array;
         multi->len = multi->size - 1;
-        multi->members[multi->len] = array;
     }
 
     return multi;
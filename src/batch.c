@@ -0,0 +1,288 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, free, strtod */
+#include <string.h> /* memcpy */
+#include <errno.h>  /* ENOMEM */
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <hl7c/batch.h>
+#include <hl7c/dtm.h>
+#include <hl7c/vector.h>
+
+/**
+ * \file batch.c
+ * \brief
+ *      Runs a query over many messages, storing the results by column.
+ */
+
+static void
+batch_oom(const char *func, int line)
+{
+    fprintf(stderr, "%s: %d: Out of memory!\n", func, line);
+    exit(ENOMEM);
+}
+
+batch *
+batch_ctor(const char *const *paths, const batch_type *types, int ncols, int *bad)
+{
+    batch *self = NULL;
+    query *q = NULL;
+    int i;
+
+    if((q = query_compile(paths, ncols, bad)) == NULL)
+        return NULL;
+
+    /* At least one, as calloc(0, ...) may be NULL. */
+    if((self = calloc(1, sizeof(batch))) == NULL ||
+       (self->cols = calloc(ncols ? ncols : 1, sizeof(batch_vector))) == NULL)
+        batch_oom(__func__, __LINE__);
+
+    self->q = q;
+    self->ncols = ncols;
+
+    for(i = 0; i != ncols; i++)
+        self->cols[i].type = types ? types[i] : BATCH_TEXT;
+
+    return self;
+}
+
+/* Gives every column room for rows rows. */
+
+static void
+batch_reserve(batch *self, int rows)
+{
+    batch_vector *col;
+    int cap = self->cap ? self->cap : 64;
+    int i;
+
+    if(rows <= self->cap)
+        return;
+
+    while(cap < rows)
+        cap *= 2;
+
+    for(i = 0; i != self->ncols; i++)
+    {
+        col = &self->cols[i];
+
+        col->spans = vector_resize(NULL, col->spans, sizeof(span) * self->cap, sizeof(span) * cap);
+        col->valid = vector_resize(NULL, col->valid, sizeof(bool) * self->cap, sizeof(bool) * cap);
+
+        if(col->type == BATCH_INT64 || col->type == BATCH_EPOCH)
+            col->i64 = vector_resize(NULL, col->i64, sizeof(int64_t) * self->cap,
+                                     sizeof(int64_t) * cap);
+        else if(col->type == BATCH_DOUBLE)
+            col->f64 = vector_resize(NULL, col->f64, sizeof(double) * self->cap,
+                                     sizeof(double) * cap);
+    }
+    self->cap = cap;
+}
+
+static bool
+to_int64(const char *p, size_t n, int64_t *out)
+{
+    uint64_t v = 0;
+    bool neg = false;
+    size_t i = 0;
+
+    if(n > 0 && (p[0] == '-' || p[0] == '+'))
+        neg = (p[i++] == '-');
+
+    if(i == n || n - i > 18)
+        return false;
+
+    for(; i != n; i++)
+    {
+        if(p[i] < '0' || p[i] > '9')
+            return false;
+        v = v * 10 + p[i] - '0';
+    }
+
+    *out = neg ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
+static bool
+to_double(const char *p, size_t n, double *out)
+{
+    char tmp[64];
+    char *end;
+
+    if(n == 0 || n >= sizeof(tmp))
+        return false;
+
+    memcpy(tmp, p, n);
+    tmp[n] = 0;
+    *out = strtod(tmp, &end);
+    return end == tmp + n;
+}
+
+/* Fills rows from up to, but not including, to. */
+
+static void
+batch_rows(batch *self, const char *const *msgs, const size_t *lens, int from, int to)
+{
+    query_value out[self->ncols + 1];   /* never of length 0 */
+    batch_vector *col;
+    const char *v;
+    size_t n;
+    int row, i;
+
+    for(row = from; row < to; row++)
+    {
+        query_run(self->q, msgs[row], lens[row], out);
+
+        for(i = 0; i != self->ncols; i++)
+        {
+            col = &self->cols[i];
+            v = out[i].value;
+            n = out[i].len;
+
+            if(v == NULL)
+            {
+                col->spans[row].off = BATCH_NULL;
+                col->spans[row].len = 0;
+                col->valid[row] = false;
+                continue;
+            }
+
+            col->spans[row].off = v - msgs[row];
+            col->spans[row].len = n;
+
+            switch(col->type)
+            {
+                case BATCH_INT64:
+                    col->valid[row] = to_int64(v, n, &col->i64[row]);
+                    break;
+                case BATCH_DOUBLE:
+                    col->valid[row] = to_double(v, n, &col->f64[row]);
+                    break;
+                case BATCH_EPOCH:
+                    col->valid[row] = dtm_to_epoch(v, n, DTM_UTC, &col->i64[row]);
+                    break;
+                default:
+                    col->valid[row] = true;
+                    break;
+            }
+        }
+    }
+}
+
+#ifdef HAVE_PTHREAD
+
+typedef struct _batch_job
+{
+    batch *self;
+    const char *const *msgs;
+    const size_t *lens;
+    int from;
+    int to;
+} batch_job;
+
+static void *
+batch_worker(void *arg)
+{
+    batch_job *job = arg;
+
+    batch_rows(job->self, job->msgs, job->lens, job->from, job->to);
+    return NULL;
+}
+
+#endif
+
+int
+batch_run(batch *self, const char *const *msgs, const size_t *lens, int n, int nthreads)
+{
+    batch_reserve(self, n);
+    self->rows = n;
+
+#ifdef HAVE_PTHREAD
+    if(nthreads > n)
+        nthreads = n;
+
+    if(nthreads > 1)
+    {
+        pthread_t tid[nthreads];
+        batch_job job[nthreads];
+        bool started[nthreads];
+        int i;
+
+        /* Contiguous slices, so each thread writes its own stretch of
+         * every column.
+         */
+        for(i = 0; i != nthreads; i++)
+        {
+            job[i].self = self;
+            job[i].msgs = msgs;
+            job[i].lens = lens;
+            job[i].from = (int)((int64_t)n * i / nthreads);
+            job[i].to = (int)((int64_t)n * (i + 1) / nthreads);
+
+            /* A thread that can't be started has its rows done here. */
+            started[i] = pthread_create(&tid[i], NULL, batch_worker, &job[i]) == 0;
+            if(!started[i])
+                batch_worker(&job[i]);
+        }
+
+        for(i = 0; i != nthreads; i++)
+            if(started[i])
+                pthread_join(tid[i], NULL);
+
+        return n;
+    }
+#endif
+
+    batch_rows(self, msgs, lens, 0, n);
+    return n;
+}
+
+void
+batch_dtor(batch *self)
+{
+    int i;
+
+    if(self != NULL)
+    {
+        for(i = 0; i != self->ncols; i++)
+        {
+            free(self->cols[i].spans);
+            free(self->cols[i].i64);
+            free(self->cols[i].f64);
+            free(self->cols[i].valid);
+        }
+        free(self->cols);
+        query_dtor(self->q);
+        free(self);
+    }
+    return;
+}
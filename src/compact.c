@@ -0,0 +1,283 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, free */
+#include <stdbool.h>
+#include <string.h> /* memcpy, strlen */
+#include <errno.h>  /* ENOMEM */
+
+#include <hl7c/compact.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+#include <hl7c/vector.h>
+
+/**
+ * \file compact.c
+ * \brief
+ *      Building compact messages, and searching them.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+compact *
+compact_ctor(compact *self)
+{
+    self = calloc(1, sizeof(compact));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+    return self;
+}
+
+/* Empties self, keeping its storage. */
+
+static void
+compact_clear(compact *self)
+{
+    self->len = 0;
+    self->nfields = 0;
+    self->used = 0;
+}
+
+/* Makes room for n more bytes in buf. */
+
+static void
+compact_reserve_bytes(compact *self, size_t n)
+{
+    size_t size = self->size ? self->size : 256;
+
+    if(self->used + n <= self->size)
+        return;
+
+    while(size < self->used + n)
+        size *= 2;
+
+    self->buf = vector_resize(NULL, self->buf, self->size, size);
+    self->size = size;
+}
+
+/* Records a field starting at off in buf. */
+
+static void
+compact_push_field(compact *self, size_t off)
+{
+    int cap;
+
+    if(self->nfields == self->fieldcap)
+    {
+        cap = self->fieldcap ? self->fieldcap * 2 : 64;
+        self->offs = vector_resize(NULL, self->offs, sizeof(uint32_t) * self->fieldcap,
+                                   sizeof(uint32_t) * cap);
+        self->fieldcap = cap;
+    }
+    self->offs[self->nfields++] = off;
+}
+
+/* Closes a segment whose first field is first. */
+
+static void
+compact_push_segment(compact *self, int first)
+{
+    int cap;
+
+    /* starts holds one more entry than there are segments. */
+    if(self->len + 1 >= self->segcap)
+    {
+        cap = self->segcap ? self->segcap * 2 : 16;
+        self->starts = vector_resize(NULL, self->starts, sizeof(uint32_t) * self->segcap,
+                                     sizeof(uint32_t) * cap);
+        self->ids = vector_resize(NULL, self->ids, sizeof(segid) * self->segcap,
+                                  sizeof(segid) * cap);
+        self->segcap = cap;
+    }
+
+    self->ids[self->len] = segid_of(self->buf + self->offs[first],
+                                    strlen(self->buf + self->offs[first]));
+    self->starts[self->len++] = first;
+    self->starts[self->len] = self->nfields;
+}
+
+static size_t
+skip_framing(const char *buf, size_t pos, size_t end)
+{
+    while(pos < end && (buf[pos] == VT || buf[pos] == FS))
+        pos++;
+    return pos;
+}
+
+compact *
+compact_parse(compact *self, const char *in, size_t len)
+{
+    uint32_t idx[DELIM_BATCH];
+    const encoding *enc;
+    encoding scratch;
+    char *buf;
+    size_t base  = 0;
+    size_t done  = 0;
+    size_t start = 0;       /* start of the current field */
+    size_t n, k, p;
+    int first = 0;          /* first field of the current segment */
+    bool fresh = true;      /* no field closed yet in this segment */
+    bool eol;
+
+    compact_clear(self);
+    compact_reserve_bytes(self, len + 1);
+    buf = memcpy(self->buf, in, len);
+    buf[len] = 0;
+    self->used = len + 1;
+
+    if((enc = encoding_detect(buf, len, &scratch)) == NULL)
+        enc = &encoding_standard;
+
+    /* As in message_view, but every separator found becomes the nul
+     * that ends its field.
+     */
+    while(base < len)
+    {
+        n = delim_index(buf + base, len - base, &enc->structure, idx, DELIM_BATCH, &done);
+
+        for(k = 0; k != n; k++)
+        {
+            p = base + idx[k];
+
+            if(fresh)
+            {
+                start = skip_framing(buf, start, p);
+
+                if(buf[p] != enc->field && start == p)
+                {
+                    start = p + 1;  /* blank line */
+                    continue;
+                }
+                fresh = false;
+            }
+
+            eol = buf[p] != enc->field;
+            buf[p] = 0;
+            compact_push_field(self, start);
+            start = p + 1;
+
+            if(eol)
+            {
+                compact_push_segment(self, first);
+                first = self->nfields;
+                fresh = true;
+            }
+        }
+        base += done;
+    }
+
+    /* Last segment, if it wasn't terminated. */
+    if(fresh)
+        start = skip_framing(buf, start, len);
+
+    if(!fresh || start < len)
+    {
+        compact_push_field(self, start);
+        compact_push_segment(self, first);
+    }
+    return self;
+}
+
+compact *
+compact_from_message(compact *self, message *msg)
+{
+    segment *seg = NULL;
+    char *field = NULL;
+    size_t n;
+    int first;
+
+    compact_clear(self);
+
+    HL7_FOREACH_SEGMENT(msg, seg)
+    {
+        first = self->nfields;
+
+        HL7_FOREACH_FIELD(seg, field)
+        {
+            n = strlen(field) + 1;
+            compact_reserve_bytes(self, n);
+            memcpy(self->buf + self->used, field, n);
+            compact_push_field(self, self->used);
+            self->used += n;
+        }
+
+        if(self->nfields > first)
+            compact_push_segment(self, first);
+    }
+    return self;
+}
+
+int
+compact_find(const compact *self, segid id, int n)
+{
+    int i;
+
+    for(i = 0; i != self->len; i++)
+        if(self->ids[i] == id && n-- == 0)
+            return i;
+
+    return -1;
+}
+
+int
+compact_column(const compact *self, segid id, int j, const char **out, int cap)
+{
+    int count = 0;
+    int i;
+
+    for(i = 0; i != self->len; i++)
+    {
+        if(self->ids[i] != id)
+            continue;
+
+        if(count < cap)
+            out[count] = compact_field(self, i, j);
+        count++;
+    }
+    return count;
+}
+
+void
+compact_dtor(compact *self)
+{
+    if(self != NULL)
+    {
+        free(self->buf);
+        free(self->offs);
+        free(self->starts);
+        free(self->ids);
+        free(self);
+    }
+    return;
+}
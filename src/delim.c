@@ -0,0 +1,366 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memchr, memset, strcmp */
+#include <hl7c/delim.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * \file delim.c
+ * \brief
+ *      Delimiter search. Each implementation turns whole 64-byte blocks
+ *      into one bitmap word; the few bytes left over at the end of a 
+ *      buffer always go through the scalar path.
+ */
+
+typedef void (*bitmap_fn)(const char *, size_t, const delimset *, uint64_t *);
+
+static uint64_t
+bitmap_tail(const char *buf, size_t len, const delimset *set)
+{
+    uint64_t m = 0;
+    size_t i;
+
+    for(i = 0; i != len; i++)
+        m |= (uint64_t)set->member[(unsigned char)buf[i]] << i;
+
+    return m;
+}
+
+static void
+bitmap_scalar(const char *buf, size_t nblocks, const delimset *set, uint64_t *bits)
+{
+    size_t b;
+
+    for(b = 0; b != nblocks; b++, buf += 64)
+        bits[b] = bitmap_tail(buf, 64, set);
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse2")))
+static void
+bitmap_sse2(const char *buf, size_t nblocks, const delimset *set, uint64_t *bits)
+{
+    __m128i needle[DELIM_MAX];
+    __m128i v, hit;
+    uint64_t m;
+    size_t b;
+    int j, k;
+
+    for(k = 0; k != set->n; k++)
+        needle[k] = _mm_set1_epi8((char)set->c[k]);
+
+    for(b = 0; b != nblocks; b++, buf += 64)
+    {
+        m = 0;
+        for(j = 0; j != 4; j++)
+        {
+            v = _mm_loadu_si128((const __m128i *)(buf + 16 * j));
+            hit = _mm_setzero_si128();
+
+            for(k = 0; k != set->n; k++)
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needle[k]));
+
+            m |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << (16 * j);
+        }
+        bits[b] = m;
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+bitmap_avx2(const char *buf, size_t nblocks, const delimset *set, uint64_t *bits)
+{
+    __m256i needle[DELIM_MAX];
+    __m256i lo, hi, hitlo, hithi;
+    size_t b;
+    int k;
+
+    for(k = 0; k != set->n; k++)
+        needle[k] = _mm256_set1_epi8((char)set->c[k]);
+
+    for(b = 0; b != nblocks; b++, buf += 64)
+    {
+        lo = _mm256_loadu_si256((const __m256i *)buf);
+        hi = _mm256_loadu_si256((const __m256i *)(buf + 32));
+        hitlo = hithi = _mm256_setzero_si256();
+
+        for(k = 0; k != set->n; k++)
+        {
+            hitlo = _mm256_or_si256(hitlo, _mm256_cmpeq_epi8(lo, needle[k]));
+            hithi = _mm256_or_si256(hithi, _mm256_cmpeq_epi8(hi, needle[k]));
+        }
+
+        bits[b] = (uint64_t)(uint32_t)_mm256_movemask_epi8(hitlo) |
+                  (uint64_t)(uint32_t)_mm256_movemask_epi8(hithi) << 32;
+    }
+}
+
+__attribute__((target("avx512bw")))
+static void
+bitmap_avx512(const char *buf, size_t nblocks, const delimset *set, uint64_t *bits)
+{
+    __m512i needle[DELIM_MAX];
+    __m512i v;
+    __mmask64 m;
+    size_t b;
+    int k;
+
+    for(k = 0; k != set->n; k++)
+        needle[k] = _mm512_set1_epi8((char)set->c[k]);
+
+    for(b = 0; b != nblocks; b++, buf += 64)
+    {
+        v = _mm512_loadu_si512((const void *)buf);
+        m = 0;
+
+        for(k = 0; k != set->n; k++)
+            m |= _mm512_cmpeq_epi8_mask(v, needle[k]);
+
+        bits[b] = (uint64_t)m;
+    }
+}
+
+static bool has_sse2(void)   { return __builtin_cpu_supports("sse2"); }
+static bool has_avx2(void)   { return __builtin_cpu_supports("avx2"); }
+static bool has_avx512(void) { return __builtin_cpu_supports("avx512bw"); }
+
+#endif /* __x86_64__ */
+
+static bool has_scalar(void) { return true; }
+
+/* Best first. */
+static const struct
+{
+    const char *name;
+    bitmap_fn fn;
+    bool (*supported)(void);
+} impls[] = {
+#if defined(__x86_64__)
+    { "avx512", bitmap_avx512, has_avx512 },
+    { "avx2",   bitmap_avx2,   has_avx2   },
+    { "sse2",   bitmap_sse2,   has_sse2   },
+#endif
+    { "scalar", bitmap_scalar, has_scalar },
+};
+
+static bitmap_fn kernel = bitmap_scalar;
+static const char *kernel_name = "scalar";
+
+bool
+delim_select(const char *name)
+{
+    size_t i;
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+#endif
+
+    for(i = 0; i != sizeof(impls) / sizeof(impls[0]); i++)
+    {
+        if(name != NULL && strcmp(name, impls[i].name) != 0)
+            continue;
+
+        if(impls[i].supported())
+        {
+            kernel = impls[i].fn;
+            kernel_name = impls[i].name;
+            return true;
+        }
+
+        if(name != NULL)
+            break;
+    }
+    return false;
+}
+
+/* Pick the best implementation before main() runs, so that the hot 
+ * paths never have to check.
+ */
+
+__attribute__((constructor))
+static void
+delim_resolve(void)
+{
+    delim_select(NULL);
+}
+
+const char *
+delim_impl(void)
+{
+    return kernel_name;
+}
+
+delimset *
+delimset_init(delimset *set, const char *chars, int n)
+{
+    unsigned char c;
+    int i;
+
+    memset(set, 0, sizeof(delimset));
+
+    for(i = 0; i != n && set->n != DELIM_MAX; i++)
+    {
+        c = (unsigned char)chars[i];
+
+        if(!set->member[c])
+        {
+            set->member[c] = true;
+            set->c[set->n++] = c;
+        }
+    }
+    return set;
+}
+
+size_t
+delim_find(const char *buf, size_t len, const delimset *set)
+{
+    const char *hit;
+    uint64_t bits[4];
+    size_t pos = 0;
+    size_t nblocks;
+    size_t i;
+    uint64_t tail;
+
+    /* glibc's memchr is already vectorized. */
+    if(set->n == 1)
+    {
+        hit = memchr(buf, set->c[0], len);
+        return hit ? (size_t)(hit - buf) : len;
+    }
+
+    while(len - pos >= 64)
+    {
+        nblocks = (len - pos) / 64;
+        if(nblocks > 4)
+            nblocks = 4;
+
+        kernel(buf + pos, nblocks, set, bits);
+
+        for(i = 0; i != nblocks; i++, pos += 64)
+            if(bits[i])
+                return pos + __builtin_ctzll(bits[i]);
+    }
+
+    tail = bitmap_tail(buf + pos, len - pos, set);
+    return tail ? pos + __builtin_ctzll(tail) : len;
+}
+
+size_t
+delim_bitmap(const char *buf, size_t len, const delimset *set, uint64_t *bits)
+{
+    size_t nblocks = len / 64;
+    size_t count = 0;
+    size_t i;
+
+    kernel(buf, nblocks, set, bits);
+
+    if(len % 64)
+        bits[nblocks] = bitmap_tail(buf + nblocks * 64, len % 64, set);
+
+    for(i = 0; i != DELIM_WORDS(len); i++)
+        count += __builtin_popcountll(bits[i]);
+
+    return count;
+}
+
+size_t
+delim_count(const char *buf, size_t len, const delimset *set)
+{
+    uint64_t bits[64];      /* bitmap of one 4k window */
+    size_t window;
+    size_t base = 0;
+    size_t count = 0;
+    const char *hit;
+
+    if(set->n == 1)
+    {
+        for(hit = buf; (hit = memchr(hit, set->c[0], buf + len - hit)) != NULL; hit++)
+            count++;
+        return count;
+    }
+
+    for(base = 0; base < len; base += window)
+    {
+        window = len - base;
+        if(window > sizeof(bits) * 8)
+            window = sizeof(bits) * 8;
+
+        count += delim_bitmap(buf + base, window, set, bits);
+    }
+    return count;
+}
+
+size_t
+delim_index(const char *buf, size_t len, const delimset *set,
+            uint32_t *pos, size_t cap, size_t *done)
+{
+    uint64_t bits[64];      /* bitmap of one 4k window */
+    uint64_t m;
+    size_t window;
+    size_t base = 0;
+    size_t n = 0;
+    size_t w;
+
+    while(base < len)
+    {
+        window = len - base;
+        if(window > sizeof(bits) * 8)
+            window = sizeof(bits) * 8;
+
+        delim_bitmap(buf + base, window, set, bits);
+
+        for(w = 0; w != DELIM_WORDS(window); w++)
+        {
+            m = bits[w];
+
+            /* Only take whole words, so the caller can resume on a
+             * block boundary.
+             */
+            if((size_t)__builtin_popcountll(m) > cap - n)
+            {
+                *done = base + w * 64;
+                return n;
+            }
+
+            while(m)
+            {
+                pos[n++] = base + w * 64 + __builtin_ctzll(m);
+                m &= m - 1;
+            }
+        }
+        base += window;
+    }
+
+    *done = len;
+    return n;
+}
@@ -0,0 +1,251 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memcpy */
+#include <time.h>   /* localtime_r */
+
+#include <hl7c/dtm.h>
+
+/**
+ * \file dtm.c
+ * \brief
+ *      HL7 date/time decoder.
+ */
+
+#define ONES 0x0101010101010101ULL
+
+/* Days from 1970-01-01 to the given civil date. */
+
+static int64_t
+days_from_civil(int y, int m, int d)
+{
+    int64_t era, yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int
+days_in_month(int y, int m)
+{
+    static const char days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    if(m == 2 && y % 4 == 0 && (y % 100 != 0 || y % 400 == 0))
+        return 29;
+    return days[m - 1];
+}
+
+/*
+ * Converts eight digits at p into four two-digit numbers, one in the
+ * low byte of each 16-bit lane, first pair lowest. Any byte that isn't
+ * a digit gets a high nibble in v or in v + 6, and fails the check.
+ */
+
+static inline bool
+pairs8(const char *p, uint64_t *out)
+{
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    v -= '0' * ONES;
+
+    if((v | (v + 6 * ONES)) & (0xf0 * ONES))
+        return false;
+
+    *out = (v * 10 + (v >> 8)) & 0x00ff00ff00ff00ffULL;
+    return true;
+}
+
+#define PAIR(v, k) ((int)(((v) >> (16 * (k))) & 0xff))
+
+static inline bool
+pair(const char *p, int *out)
+{
+    if(p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9')
+        return false;
+
+    *out = (p[0] - '0') * 10 + p[1] - '0';
+    return true;
+}
+
+/* Reads the date and time parts, returning how many were there. */
+
+static int
+fields(const char *p, size_t n, int *f)
+{
+    uint64_t lo, hi;
+    int k, i;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* YYYYMMDD and DDHHMMSS: two overlapping loads cover all 14. */
+    if(n >= 14 && pairs8(p, &lo) && pairs8(p + 6, &hi))
+    {
+        f[0] = PAIR(lo, 0) * 100 + PAIR(lo, 1);
+        f[1] = PAIR(lo, 2);
+        f[2] = PAIR(lo, 3);
+        f[3] = PAIR(hi, 1);
+        f[4] = PAIR(hi, 2);
+        f[5] = PAIR(hi, 3);
+        return 6;
+    }
+#endif
+
+    if(n < 4 || !pair(p, &f[0]) || !pair(p + 2, &i))
+        return 0;
+    f[0] = f[0] * 100 + i;
+
+    for(k = 1, i = 4; k != 6 && (size_t)i + 2 <= n && p[i] >= '0' && p[i] <= '9'; k++, i += 2)
+        if(!pair(p + i, &f[k]))
+            return 0;
+    return k;
+}
+
+static __thread struct
+{
+    int64_t key;
+    int32_t offset;
+    bool set;
+} zones[4];
+
+/* The local zone's offset at t, cached by quarter hour. */
+
+static int32_t
+local_offset(int64_t t)
+{
+    int64_t key = (t >= 0 ? t : t - 899) / 900;
+    time_t when = t;
+    struct tm tm;
+
+    if(zones[key & 3].set && zones[key & 3].key == key)
+        return zones[key & 3].offset;
+
+    localtime_r(&when, &tm);
+
+    zones[key & 3].key = key;
+    zones[key & 3].offset = tm.tm_gmtoff;
+    zones[key & 3].set = true;
+
+    return tm.tm_gmtoff;
+}
+
+bool
+dtm_decode(const char *p, size_t n, int32_t zone, dtm *out)
+{
+    int f[6] = { 0, 1, 1, 0, 0, 0 };    /* year, month, day, h, m, s */
+    int32_t nanos = 0;
+    int32_t offset;
+    int64_t wall;
+    int scale = 100000000;
+    bool fraction = false;
+    bool zoned = false;
+    int k, zh, zm;
+    size_t i, start;
+
+    if((k = fields(p, n, f)) == 0)
+        return false;
+
+    if(f[1] < 1 || f[1] > 12 || f[2] < 1 || f[2] > days_in_month(f[0], f[1]) ||
+       f[3] > 23 || f[4] > 59 || f[5] > 60)
+        return false;
+
+    i = 2 + 2 * k;
+
+    /* Up to nanoseconds; HL7 itself stops at a ten-thousandth. */
+    if(k == 6 && i < n && p[i] == '.')
+    {
+        for(start = ++i; i < n && p[i] >= '0' && p[i] <= '9'; i++, scale /= 10)
+            nanos += (p[i] - '0') * scale;
+
+        if(i == start || i - start > 9)
+            return false;
+        fraction = true;
+    }
+
+    /* No zone is further than 14 hours from UTC. */
+    if(i + 5 == n && (p[i] == '+' || p[i] == '-'))
+    {
+        if(!pair(p + i + 1, &zh) || !pair(p + i + 3, &zm) || zh > 14 || zm > 59)
+            return false;
+
+        zone = (zh * 60 + zm) * 60 * (p[i] == '-' ? -1 : 1);
+        zoned = true;
+        i = n;
+    }
+
+    if(i != n)
+        return false;
+
+    wall = days_from_civil(f[0], f[1], f[2]) * 86400 + f[3] * 3600 + f[4] * 60 + f[5];
+
+    /* The offset that applies is the one in force at the UTC time it
+     * gives; asking twice gets that right around a change.
+     */
+    if(zone == DTM_LOCAL)
+        offset = local_offset(wall - local_offset(wall));
+    else
+        offset = zone;
+
+    out->seconds = wall - offset;
+    out->nanos = nanos;
+    out->offset = offset;
+    out->precision = fraction ? DTM_FRACTION : k - 1;
+    out->zoned = zoned;
+
+    return true;
+}
+
+bool
+dtm_to_epoch(const char *p, size_t n, int32_t zone, int64_t *out)
+{
+    dtm d;
+
+    if(!dtm_decode(p, n, zone, &d))
+        return false;
+
+    *out = d.seconds;
+    return true;
+}
+
+int
+dtm_to_epoch_batch(const char *const *values, const size_t *lens, int n, int32_t zone,
+                   int64_t *out, bool *valid)
+{
+    int good = 0;
+    int i;
+
+    for(i = 0; i != n; i++)
+    {
+        valid[i] = values[i] != NULL && dtm_to_epoch(values[i], lens[i], zone, &out[i]);
+        good += valid[i];
+    }
+    return good;
+}
@@ -0,0 +1,351 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, free, qsort */
+#include <string.h> /* memchr, memcpy, memmove, memset */
+#include <errno.h>  /* ENOMEM */
+
+#include <hl7c/edit.h>
+#include <hl7c/escape.h>
+#include <hl7c/vector.h>
+
+/**
+ * \file edit.c
+ * \brief
+ *      Copy-on-write edits over a message_view.
+ */
+
+static const char terminator = '\r';
+
+message_edit *
+message_edit_ctor(message_edit *self, const message_view *mv)
+{
+    self = calloc(1, sizeof(message_edit));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    self->mv = mv;
+    return self;
+}
+
+/* Grows a byte buffer to hold at least need bytes. */
+
+static void
+reserve(char **buf, size_t *size, size_t need)
+{
+    size_t want;
+
+    if(need <= *size)
+        return;
+
+    want = *size ? *size : 256;
+    while(want < need)
+        want *= 2;
+
+    *buf = vector_resize(NULL, *buf, *size, want);
+    *size = want;
+}
+
+/* The encoding characters of MSH-2, FHS-2 and BHS-2 stay as they are. */
+
+static bool
+header(const message_view *mv, int seg)
+{
+    const segment_view *sv = &mv->segments[seg];
+
+    return segment_view_is(mv, sv, "MSH") || segment_view_is(mv, sv, "FHS") ||
+           segment_view_is(mv, sv, "BHS");
+}
+
+static bool
+record(message_edit *self, edit_kind kind, int seg, int field, int rep, int comp,
+       const delimset *set, const char *value, size_t len)
+{
+    const encoding *enc = self->mv->enc;
+    edit_patch *p;
+    size_t n;
+    int cap;
+
+    if(seg < 0 || seg >= self->mv->len || field < 0 || rep < 0)
+        return false;
+
+    if(kind != EDIT_SEGMENT && field == 1 && header(self->mv, seg))
+        return false;
+
+    if(self->len == self->cap)
+    {
+        cap = self->cap ? self->cap * 2 : 8;
+        self->patches = vector_resize(NULL, self->patches, sizeof(edit_patch) * self->cap,
+                                      sizeof(edit_patch) * cap);
+        self->rebuilt = vector_resize(NULL, self->rebuilt, sizeof(span) * self->cap,
+                                      sizeof(span) * cap);
+        self->cap = cap;
+    }
+
+    n = set != NULL && value != NULL ? escape_size(enc, set, value, len) : len;
+    reserve(&self->values, &self->size, self->used + n);
+
+    if(set != NULL && value != NULL)
+        escape_encode(enc, set, self->values + self->used, value, len);
+    else if(value != NULL)
+        memcpy(self->values + self->used, value, len);
+
+    p = &self->patches[self->len];
+    p->kind = kind;
+    p->segment = seg;
+    p->field = field;
+    p->rep = rep;
+    p->comp = comp;
+    p->order = self->len++;
+    p->value.off = self->used;
+    p->value.len = value != NULL ? n : 0;
+
+    self->used += p->value.len;
+    return true;
+}
+
+bool
+message_edit_field(message_edit *self, int seg, int field, const char *value, size_t len)
+{
+    return record(self, EDIT_FIELD, seg, field, 0, 0, &self->mv->enc->structure, value, len);
+}
+
+bool
+message_edit_component(message_edit *self, int seg, int field, int rep, int comp,
+                       const char *value, size_t len)
+{
+    if(comp < 1)
+        return false;
+
+    return record(self, EDIT_COMPONENT, seg, field, rep, comp, &self->mv->enc->all, value, len);
+}
+
+bool
+message_edit_segment(message_edit *self, int seg, const char *line, size_t len)
+{
+    return record(self, EDIT_SEGMENT, seg, 0, 0, 0, NULL, line, line != NULL ? len : 0);
+}
+
+/*
+ * Finds piece idx of s[a, b), split on sep. If it's there, returns 0
+ * with *start and *end around it; if not, returns the number of 
+ * separators to add at b to make it, with *start and *end both at b.
+ */
+
+static int
+locate(const char *s, size_t a, size_t b, char sep, int idx, size_t *start, size_t *end)
+{
+    const char *p;
+
+    for(; idx > 0; idx--)
+    {
+        if((p = memchr(s + a, sep, b - a)) == NULL)
+        {
+            *start = *end = b;
+            return idx;
+        }
+        a = p - s + 1;
+    }
+
+    *start = a;
+    *end = (p = memchr(s + a, sep, b - a)) != NULL ? (size_t)(p - s) : b;
+    return 0;
+}
+
+/* Replaces work[start, end) with n bytes, returning where they go. */
+
+static char *
+splice(message_edit *self, size_t *wn, size_t start, size_t end, size_t n)
+{
+    reserve(&self->work, &self->wsize, *wn - (end - start) + n);
+    memmove(self->work + start + n, self->work + end, *wn - end);
+    *wn = *wn - (end - start) + n;
+
+    return self->work + start;
+}
+
+static void
+apply(message_edit *self, size_t *wn, const edit_patch *p)
+{
+    const encoding *enc = self->mv->enc;
+    const char *value = self->values + p->value.off;
+    size_t fa, fb, ra, rb, ca, cb;
+    int mf, mr = 0, mc = 0;
+    char *gap;
+
+    if(p->kind == EDIT_SEGMENT)
+    {
+        reserve(&self->work, &self->wsize, p->value.len);
+        memcpy(self->work, value, p->value.len);
+        *wn = p->value.len;
+        return;
+    }
+
+    /* Narrow down to the part being replaced, counting the separators
+     * that are missing on the way.
+     */
+    mf = locate(self->work, 0, *wn, enc->field, p->field, &fa, &fb);
+
+    if(p->kind == EDIT_FIELD)
+    {
+        ca = fa;
+        cb = fb;
+    }
+    else if(mf > 0)
+    {
+        mr = p->rep;
+        mc = p->comp - 1;
+        ca = cb = fb;
+    }
+    else if((mr = locate(self->work, fa, fb, enc->repetition, p->rep, &ra, &rb)) > 0)
+    {
+        mc = p->comp - 1;
+        ca = cb = rb;
+    }
+    else
+        mc = locate(self->work, ra, rb, enc->component, p->comp - 1, &ca, &cb);
+
+    gap = splice(self, wn, ca, cb, mf + mr + mc + p->value.len);
+
+    memset(gap, enc->field, mf);
+    memset(gap + mf, enc->repetition, mr);
+    memset(gap + mf + mr, enc->component, mc);
+    memcpy(gap + mf + mr + mc, value, p->value.len);
+}
+
+static int
+by_segment(const void *a, const void *b)
+{
+    const edit_patch *x = a;
+    const edit_patch *y = b;
+
+    if(x->segment != y->segment)
+        return x->segment < y->segment ? -1 : 1;
+
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+serializer *
+message_edit_serialize(message_edit *self, serializer *out)
+{
+    const message_view *mv = self->mv;
+    edit_patch *p = self->patches;
+    edit_patch *end = p + self->len;
+    const char *line;
+    span s;
+    size_t wn;
+    int i, k;
+
+    if(self->len > 1)
+        qsort(self->patches, self->len, sizeof(edit_patch), by_segment);
+
+    /* Rebuild the patched segments first: out will point into lines, so
+     * it mustn't move once that starts.
+     */
+    self->lused = 0;
+
+    for(k = 0; p != end; k++)
+    {
+        s = mv->segments[p->segment].line;
+        reserve(&self->work, &self->wsize, s.len);
+        memcpy(self->work, mv->buf + s.off, s.len);
+        wn = s.len;
+
+        for(i = p->segment; p != end && p->segment == i; p++)
+            apply(self, &wn, p);
+
+        reserve(&self->lines, &self->lsize, self->lused + wn);
+        memcpy(self->lines + self->lused, self->work, wn);
+
+        self->rebuilt[k].off = self->lused;
+        self->rebuilt[k].len = wn;
+        self->lused += wn;
+    }
+
+    /* Untouched segments come from the original buffer, terminator 
+     * and all where there is one, so a run of them is a single iovec.
+     */
+    serializer_reset(out);
+
+    for(i = 0, k = 0, p = self->patches; i != mv->len; i++)
+    {
+        if(p != end && p->segment == i)
+        {
+            while(p != end && p->segment == i)
+                p++;
+
+            if((s = self->rebuilt[k++]).len > 0)
+            {
+                serializer_add(out, self->lines + s.off, s.len);
+                serializer_add(out, &terminator, 1);
+            }
+            continue;
+        }
+
+        s = mv->segments[i].line;
+        line = mv->buf + s.off;
+
+        if(s.off + s.len < mv->size && line[s.len] == terminator)
+            serializer_add(out, line, s.len + 1);
+        else
+        {
+            serializer_add(out, line, s.len);
+            serializer_add(out, &terminator, 1);
+        }
+    }
+    return out;
+}
+
+void
+message_edit_reset(message_edit *self, const message_view *mv)
+{
+    self->mv = mv;
+    self->len = 0;
+    self->used = 0;
+    self->lused = 0;
+}
+
+void
+message_edit_dtor(message_edit *self)
+{
+    if(self != NULL)
+    {
+        free(self->patches);
+        free(self->rebuilt);
+        free(self->values);
+        free(self->lines);
+        free(self->work);
+        free(self);
+    }
+    return;
+}
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memset, memcmp */
+#include <hl7c/encoding.h>
+
+/**
+ * \file encoding.c
+ * \brief
+ *      Detection of a message's encoding characters.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+const encoding encoding_standard =
+{
+    .field = '|',
+    .component = '^',
+    .repetition = '~',
+    .escape = '\\',
+    .subcomponent = '&',
+    .standard = true,
+
+
+    .structure = {
+        .n = 3,
+        .c = { '|', '\r', '\n' },
+        .member = { ['|'] = true, ['\r'] = true, ['\n'] = true },
+    },
+
+    .all = {
+        .n = 7,
+        .c = { '|', '\r', '\n', '^', '~', '\\', '&' },
+        .member = {
+            ['|'] = true, ['\r'] = true, ['\n'] = true, ['^'] = true,
+            ['~'] = true, ['\\'] = true, ['&'] = true,
+        },
+    },
+};
+
+encoding *
+encoding_init(encoding *enc, char field, char component, char repetition,
+              char escape, char subcomponent)
+{
+    char chars[7];
+
+    memset(enc, 0, sizeof(encoding));
+
+    enc->field        = field        ? field        : encoding_standard.field;
+    enc->component    = component    ? component    : encoding_standard.component;
+    enc->repetition   = repetition   ? repetition   : encoding_standard.repetition;
+    enc->escape       = escape       ? escape       : encoding_standard.escape;
+    enc->subcomponent = subcomponent ? subcomponent : encoding_standard.subcomponent;
+
+    enc->standard = (enc->field        == encoding_standard.field &&
+                     enc->component    == encoding_standard.component &&
+                     enc->repetition   == encoding_standard.repetition &&
+                     enc->escape       == encoding_standard.escape &&
+                     enc->subcomponent == encoding_standard.subcomponent);
+
+    chars[0] = enc->field;
+    chars[1] = '\r';
+    chars[2] = '\n';
+    chars[3] = enc->component;
+    chars[4] = enc->repetition;
+    chars[5] = enc->escape;
+    chars[6] = enc->subcomponent;
+
+    delimset_init(&enc->structure, chars, 3);
+    delimset_init(&enc->all, chars, 7);
+
+    return enc;
+}
+
+const encoding *
+encoding_detect(const char *buf, size_t len, encoding *scratch)
+{
+    char chars[4] = { 0, 0, 0, 0 };
+    char field;
+    size_t pos = 0;
+    int i;
+
+    while(pos < len && (buf[pos] == VT || buf[pos] == FS))
+        pos++;
+
+    buf += pos;
+    len -= pos;
+
+    if(len < 4 || (memcmp(buf, "MSH", 3) != 0 && 
+                   memcmp(buf, "FHS", 3) != 0 &&
+                   memcmp(buf, "BHS", 3) != 0))
+        return NULL;
+
+    /* The common case: a standard header. */
+    if(len >= 8 && memcmp(buf + 3, "|^~\\&", 5) == 0)
+        return &encoding_standard;
+
+    field = buf[3];
+
+    if(field == '\r' || field == '\n' || field == 0)
+        return NULL;
+
+    /* MSH-2 runs up to the next field separator. Characters it 
+     * leaves out keep their standard values.
+     */
+    for(i = 0; i != 4 && 4 + (size_t)i < len; i++)
+    {
+        if(buf[4 + i] == field || buf[4 + i] == '\r' || buf[4 + i] == '\n')
+            break;
+        chars[i] = buf[4 + i];
+    }
+
+    encoding_init(scratch, field, chars[0], chars[1], chars[2], chars[3]);
+
+    return scratch->standard ? &encoding_standard : scratch;
+}
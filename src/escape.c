@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memchr, memcpy, memmove */
+
+#include <hl7c/escape.h>
+
+/**
+ * \file escape.c
+ * \brief
+ *      Escape sequence encoder and decoder.
+ */
+
+/* The letter of the escape sequence for c, or 0 for a hex escape. */
+
+static char
+escape_code(const encoding *enc, unsigned char c)
+{
+    if(c == (unsigned char)enc->field)
+        return 'F';
+    if(c == (unsigned char)enc->component)
+        return 'S';
+    if(c == (unsigned char)enc->subcomponent)
+        return 'T';
+    if(c == (unsigned char)enc->repetition)
+        return 'R';
+    if(c == (unsigned char)enc->escape)
+        return 'E';
+    return 0;
+}
+
+size_t
+escape_size(const encoding *enc, const delimset *set, const char *s, size_t n)
+{
+    uint32_t idx[DELIM_BATCH];
+    size_t size = n;
+    size_t base = 0;
+    size_t done = 0;
+    size_t k, m;
+
+    /* Most values have nothing to escape. */
+    if(delim_find(s, n, set) == n)
+        return n;
+
+    while(base < n)
+    {
+        m = delim_index(s + base, n - base, set, idx, DELIM_BATCH, &done);
+
+        for(k = 0; k != m; k++)
+            size += escape_code(enc, s[base + idx[k]]) ? 2 : 4;
+
+        base += done;
+    }
+    return size;
+}
+
+size_t
+escape_encode(const encoding *enc, const delimset *set, char *dst, const char *s, size_t n)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char *out = dst;
+    size_t i = 0;
+    size_t run;
+    unsigned char c;
+    char code;
+
+    while(i < n)
+    {
+        run = delim_find(s + i, n - i, set);
+        memcpy(out, s + i, run);
+        out += run;
+        i += run;
+
+        if(i == n)
+            break;
+
+        c = s[i++];
+        *out++ = enc->escape;
+
+        if((code = escape_code(enc, c)) != 0)
+            *out++ = code;
+        else
+        {
+            *out++ = 'X';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 15];
+        }
+        *out++ = enc->escape;
+    }
+    return out - dst;
+}
+
+/* For decoding: the separator each code letter stands for, as an index
+ * into the encoding characters, and the value of each hex digit plus 
+ * one, so that 0 is anything else.
+ */
+
+enum { CODE_NONE = 0, CODE_F, CODE_S, CODE_T, CODE_R, CODE_E };
+
+static const unsigned char codes[256] =
+{
+    ['F'] = CODE_F, ['S'] = CODE_S, ['T'] = CODE_T, ['R'] = CODE_R, ['E'] = CODE_E,
+};
+
+static const unsigned char hexval[256] =
+{
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+/* Decodes the hex digits of \Xhh..\ into out, or returns false. */
+
+static bool
+decode_hex(const char *p, size_t n, char *out)
+{
+    size_t i;
+
+    if(n % 2 != 0)
+        return false;
+
+    for(i = 0; i != n; i++)
+        if(hexval[(unsigned char)p[i]] == 0)
+            return false;
+
+    for(i = 0; i != n; i += 2)
+        *out++ = (hexval[(unsigned char)p[i]] - 1) << 4 | (hexval[(unsigned char)p[i + 1]] - 1);
+
+    return true;
+}
+
+size_t
+escape_decode(const encoding *enc, char *dst, const char *s, size_t n)
+{
+    const char map[] = { 0, enc->field, enc->component, enc->subcomponent,
+                         enc->repetition, enc->escape };
+    const char *end = s + n;
+    const char *p, *close;
+    char *out = dst;
+    size_t len;
+    int code;
+
+    /* Output never gets ahead of input, so memmove does in place. */
+    while((p = memchr(s, enc->escape, end - s)) != NULL &&
+          (close = memchr(p + 1, enc->escape, end - p - 1)) != NULL)
+    {
+        memmove(out, s, p - s);
+        out += p - s;
+        len = close - p - 1;
+
+        if(len == 1 && (code = codes[(unsigned char)p[1]]) != CODE_NONE)
+            *out++ = map[code];
+        else if(len > 1 && p[1] == 'X' && decode_hex(p + 2, len - 1, out))
+            out += (len - 1) / 2;
+        else
+        {
+            memmove(out, p, len + 2);
+            out += len + 2;
+        }
+        s = close + 1;
+    }
+
+    memmove(out, s, end - s);
+    out += end - s;
+
+    return out - dst;
+}
@@ -0,0 +1,1037 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>          /* fprintf */
+#include <stdlib.h>         /* calloc, realloc, free */
+#include <string.h>         /* memcpy, memset */
+#include <errno.h>          /* errno, EAGAIN, ENOMEM */
+#include <unistd.h>         /* close */
+#include <netdb.h>          /* getaddrinfo */
+#include <netinet/in.h>     /* struct sockaddr_in */
+#include <netinet/tcp.h>    /* TCP_NODELAY */
+#include <arpa/inet.h>      /* htons */
+#include <sys/socket.h>     /* socket, accept4, sendmsg */
+#include <sys/epoll.h>      /* epoll_* */
+#include <sys/eventfd.h>    /* eventfd */
+#include <poll.h>           /* POLLIN */
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include <hl7c/listener.h>
+
+#ifdef HAVE_IO_URING
+#include <hl7c/uring.h>
+
+static bool uring_open(listener *self);
+static int uring_poll(listener *self, int ms);
+static void uring_flush(connection *conn);
+#endif
+
+/**
+ * \file listener.c
+ * \brief
+ *      epoll MLLP listener.
+ */
+
+static void
+listener_oom(const char *func, int line)
+{
+    fprintf(stderr, "%s: %d: Out of memory!\n", func, line);
+    exit(ENOMEM);
+}
+
+/* Fills addr for host and port; NULL is every address. */
+
+static bool
+resolve(const char *host, int port, struct sockaddr_in *addr)
+{
+    struct addrinfo hints, *res;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if(host == NULL)
+        return true;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(host, NULL, &hints, &res) != 0)
+    {
+        errno = EADDRNOTAVAIL;
+        return false;
+    }
+
+    addr->sin_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    return true;
+}
+
+/* listener_ctor_backend, optionally sharing the port with other listeners. */
+
+static listener *
+listener_open(listener *self, const char *host, int port, bool reuseport,
+              listener_backend backend, listener_fn handler, void *user)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    struct epoll_event wake = { .events = EPOLLIN };
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int one = 1;
+    int saved;
+
+    self = calloc(1, sizeof(listener));
+
+    if(self == NULL)
+        listener_oom(__func__, __LINE__);
+
+    self->handler = handler;
+    self->user = user;
+    self->ringsize = LISTENER_RING;
+    self->pool = arena_ctor(NULL, 0);
+    self->epfd = -1;
+    self->wakefd = -1;
+
+    /* The listening socket is NULL in the epoll set, the eventfd is self. */
+    wake.data.ptr = self;
+
+    if((self->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0 ||
+       setsockopt(self->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+       (reuseport && setsockopt(self->fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) ||
+       !resolve(host, port, &addr) ||
+       bind(self->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+       listen(self->fd, SOMAXCONN) != 0 ||
+       getsockname(self->fd, (struct sockaddr *)&addr, &addrlen) != 0 ||
+       (self->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+        saved = errno;
+        listener_dtor(self);
+        errno = saved;
+        return NULL;
+    }
+
+    self->port = ntohs(addr.sin_port);
+    self->backend = LISTENER_EPOLL;
+
+#ifdef HAVE_IO_URING
+    if(backend != LISTENER_EPOLL && uring_open(self))
+    {
+        self->backend = LISTENER_URING;
+        return self;
+    }
+#else
+    errno = ENOSYS;
+#endif
+
+    if(backend == LISTENER_URING ||
+       (self->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0 ||
+       epoll_ctl(self->epfd, EPOLL_CTL_ADD, self->fd, &ev) != 0 ||
+       epoll_ctl(self->epfd, EPOLL_CTL_ADD, self->wakefd, &wake) != 0)
+    {
+        saved = errno;
+        listener_dtor(self);
+        errno = saved;
+        return NULL;
+    }
+    return self;
+}
+
+listener *
+listener_ctor(listener *self, const char *host, int port, listener_fn handler, void *user)
+{
+    return listener_open(self, host, port, false, LISTENER_AUTO, handler, user);
+}
+
+listener *
+listener_ctor_backend(listener *self, const char *host, int port,
+                      listener_backend backend, listener_fn handler, void *user)
+{
+    return listener_open(self, host, port, false, backend, handler, user);
+}
+
+static connection *
+conn_new(listener *self, int fd)
+{
+    connection *conn;
+    int one = 1;
+
+    /* ACKs are small and wanted now. */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if((conn = calloc(1, sizeof(connection))) == NULL)
+        listener_oom(__func__, __LINE__);
+
+    conn->fd = fd;
+    conn->owner = self;
+    conn->ring = mllp_ring_ctor(conn->ring, self->ringsize);
+
+    if((conn->next = self->conns) != NULL)
+        conn->next->prev = conn;
+    self->conns = conn;
+
+    self->nconns++;
+    self->stats.accepted++;
+
+    return conn;
+}
+
+static void
+conn_free(listener *self, connection *conn)
+{
+    if(conn->prev != NULL)
+        conn->prev->next = conn->next;
+    else
+        self->conns = conn->next;
+
+    if(conn->next != NULL)
+        conn->next->prev = conn->prev;
+
+    close(conn->fd);
+    mllp_ring_dtor(conn->ring);
+    free(conn->out);
+    free(conn->sendbuf);
+    free(conn);
+
+    self->nconns--;
+    self->stats.closed++;
+}
+
+/* Takes every pending connection, up to a batch at a time; level 
+ * triggering brings us back for any more.
+ */
+
+static void
+accept_all(listener *self)
+{
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP };
+    connection *conn;
+    int fd, i;
+
+    for(i = 0; i != LISTENER_EVENTS; i++)
+    {
+        if((fd = accept4(self->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0)
+            break;
+
+        conn = conn_new(self, fd);
+        ev.data.ptr = conn;
+
+        if(epoll_ctl(self->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+            conn_free(self, conn);
+    }
+}
+
+/* Hands out every complete frame in the ring. */
+
+static int
+conn_frames(listener *self, connection *conn)
+{
+    const char *frame;
+    size_t len;
+    int msgs = 0;
+
+    self->current = conn;
+
+    while(!conn->closing && mllp_ring_next(conn->ring, &frame, &len))
+    {
+        self->handler(conn, frame, len, self->user);
+        self->stats.messages++;
+        msgs++;
+    }
+
+    self->current = NULL;
+
+    if(conn->ring->overflow && !conn->closing)
+    {
+        self->stats.overflows++;
+        conn->closing = true;
+    }
+    return msgs;
+}
+
+/* Asks for EPOLLOUT while there's something queued. The set is level
+ * triggered, so once the peer has hung up (eof), EPOLLIN and EPOLLRDHUP
+ * would stay ready for good; only EPOLLOUT is wanted then.
+ */
+
+static void
+conn_watch(connection *conn, bool out)
+{
+    struct epoll_event ev = { .events = 0, .data.ptr = conn };
+
+    if(!conn->eof)
+        ev.events |= EPOLLIN | EPOLLRDHUP;
+    if(out)
+        ev.events |= EPOLLOUT;
+
+    epoll_ctl(conn->owner->epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/* Writes out conn->out; false if some is left, or the connection failed. */
+
+static bool
+conn_drain(connection *conn)
+{
+    ssize_t n;
+
+    while(conn->outoff < conn->outlen)
+    {
+        n = send(conn->fd, conn->out + conn->outoff, conn->outlen - conn->outoff, MSG_NOSIGNAL);
+
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                conn->closing = true;
+            return false;
+        }
+        conn->outoff += n;
+    }
+
+    conn->outoff = conn->outlen = 0;
+    return true;
+}
+
+/* Reads until the socket is dry, handing out every frame. The replies
+ * to each read's messages go out together, in one send, unless earlier
+ * ones are still waiting for EPOLLOUT.
+ */
+
+static int
+conn_read(listener *self, connection *conn)
+{
+    bool full, waiting;
+    ssize_t n;
+    int msgs = 0;
+
+    while(!conn->closing)
+    {
+        full = conn->ring->tail - conn->ring->head == conn->ring->size;
+        waiting = conn->outoff < conn->outlen;
+
+        if((n = mllp_ring_read(conn->ring, conn->fd)) > 0)
+            self->stats.bytes += n;
+
+        msgs += conn_frames(self, conn);
+
+        if(!waiting && !conn->closing && !conn_drain(conn) && !conn->closing)
+            conn_watch(conn, true);
+
+        if(conn->closing)
+            break;
+        else if(n < 0 && errno != EINTR)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+                conn->closing = true;
+            break;
+        }
+        else if(n == 0 && !full)
+        {
+            /* The peer is done sending; let any reply finish first. */
+            if(conn->outlen == conn->outoff)
+                conn->closing = true;
+            else
+            {
+                conn->eof = true;
+                conn_watch(conn, true);
+            }
+            break;
+        }
+    }
+    return msgs;
+}
+
+/* Carries on with what is queued, once EPOLLOUT says there's room. */
+
+static void
+conn_flush(connection *conn)
+{
+    if(!conn_drain(conn))
+        return;
+
+    if(conn->eof)
+        conn->closing = true;
+    else
+        conn_watch(conn, false);
+}
+
+/* Appends the iovecs to conn->out, less the first skip bytes. */
+
+static void
+conn_queue(connection *conn, const struct iovec *iov, int n, size_t skip, size_t len)
+{
+    size_t k;
+    int i;
+
+    if(conn->outlen + len > conn->outcap)
+    {
+        for(k = conn->outcap ? conn->outcap : 4096; k < conn->outlen + len; k *= 2)
+            ;
+        if((conn->out = realloc(conn->out, k)) == NULL)
+            listener_oom(__func__, __LINE__);
+        conn->outcap = k;
+    }
+
+    for(i = 0; i != n; i++)
+    {
+        if(skip >= iov[i].iov_len)
+        {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        memcpy(conn->out + conn->outlen, (const char *)iov[i].iov_base + skip,
+               iov[i].iov_len - skip);
+        conn->outlen += iov[i].iov_len - skip;
+        skip = 0;
+    }
+}
+
+bool
+connection_sendv(connection *conn, const struct iovec *iov, int n)
+{
+    struct msghdr msg = { .msg_iov = (struct iovec *)iov, .msg_iovlen = n };
+    bool queued = conn->outlen > conn->outoff;
+    size_t total = 0;
+    ssize_t sent = 0;
+    int i;
+
+    if(conn->closing)
+        return false;
+
+    for(i = 0; i != n; i++)
+        total += iov[i].iov_len;
+
+    /* Every reply to a batch goes out in one send, after the batch; 
+     * with io_uring, so does anything sent outside one.
+     */
+    if(conn->owner->current == conn || conn->owner->ring != NULL)
+    {
+        conn_queue(conn, iov, n, 0, total);
+#ifdef HAVE_IO_URING
+        if(conn->owner->current != conn)
+            uring_flush(conn);
+#endif
+        return true;
+    }
+
+    /* Replies go out in order: only write now if nothing is waiting. */
+    if(!queued)
+    {
+        while((sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+            ;
+
+        if(sent < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                conn->closing = true;
+                return false;
+            }
+            sent = 0;
+        }
+    }
+
+    if((size_t)sent == total)
+        return true;
+
+    conn_queue(conn, iov, n, sent, total - sent);
+
+    if(!queued)
+        conn_watch(conn, true);
+    return true;
+}
+
+bool
+connection_send(connection *conn, const void *buf, size_t len)
+{
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+
+    return connection_sendv(conn, &iov, 1);
+}
+
+void
+connection_close(connection *conn)
+{
+    conn->closing = true;
+
+    /* Wakes the connection up, for when it isn't the one being handled. */
+    shutdown(conn->fd, SHUT_RDWR);
+}
+
+int
+listener_poll(listener *self, int ms)
+{
+    struct epoll_event ev[LISTENER_EVENTS];
+    connection *conn;
+    uint64_t count;
+    int msgs = 0;
+    int n, i;
+
+#ifdef HAVE_IO_URING
+    if(self->ring != NULL)
+        return uring_poll(self, ms);
+#endif
+
+    if((n = epoll_wait(self->epfd, ev, LISTENER_EVENTS, ms)) < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for(i = 0; i != n; i++)
+    {
+        if((conn = ev[i].data.ptr) == NULL)
+        {
+            accept_all(self);
+            continue;
+        }
+
+        if(ev[i].data.ptr == self)
+        {
+            /* Only here to wake epoll_wait up; running says why. */
+            if(read(self->wakefd, &count, sizeof(count)) < 0)
+                count = 0;
+            continue;
+        }
+
+        /* With replies queued, an error or hangup is found out by
+         * trying to write them.
+         */
+        if((ev[i].events & EPOLLOUT) ||
+           ((ev[i].events & (EPOLLERR | EPOLLHUP)) && conn->outoff < conn->outlen))
+            conn_flush(conn);
+
+        if(!conn->closing && !conn->eof)
+            msgs += conn_read(self, conn);
+
+        if(conn->closing)
+            conn_free(self, conn);
+    }
+
+    arena_reset(self->pool);
+    return msgs;
+}
+
+/* running may be cleared by another thread, hence the atomics. */
+
+static void
+listener_loop(listener *self)
+{
+    while(__atomic_load_n(&self->running, __ATOMIC_ACQUIRE))
+        if(listener_poll(self, -1) < 0)
+            break;
+}
+
+void
+listener_run(listener *self)
+{
+    __atomic_store_n(&self->running, true, __ATOMIC_RELEASE);
+    listener_loop(self);
+}
+
+void
+listener_stop(listener *self)
+{
+    uint64_t one = 1;
+
+    __atomic_store_n(&self->running, false, __ATOMIC_RELEASE);
+
+    if(write(self->wakefd, &one, sizeof(one)) < 0)
+        return;
+}
+
+void
+listener_dtor(listener *self)
+{
+    if(self != NULL)
+    {
+#ifdef HAVE_IO_URING
+        /* First, so that the kernel lets go of the sockets and buffers. */
+        uring_dtor(self->ring);
+#endif
+        while(self->conns != NULL)
+            conn_free(self, self->conns);
+
+        if(self->wakefd >= 0)
+            close(self->wakefd);
+        if(self->epfd >= 0)
+            close(self->epfd);
+        if(self->fd >= 0)
+            close(self->fd);
+        arena_dtor(self->pool);
+        free(self);
+    }
+    return;
+}
+
+listener_group *
+listener_group_ctor(listener_group *self, const char *host, int port,
+                    int n, listener_fn handler, void *user)
+{
+    int saved;
+    int i;
+
+#ifdef HAVE_PTHREAD
+    if(n <= 0)
+        n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(n <= 0)
+        n = 1;
+#else
+    n = 1;
+#endif
+
+    self = calloc(1, sizeof(listener_group));
+
+    if(self == NULL || (self->workers = calloc(n, sizeof(listener *))) == NULL)
+        listener_oom(__func__, __LINE__);
+
+    /* The first binds, so that port 0 picks one port for all of them. */
+    for(i = 0; i != n; i++)
+    {
+        if((self->workers[i] = listener_open(NULL, host, port, true, LISTENER_AUTO, handler, user)) == NULL)
+        {
+            saved = errno;
+            listener_group_dtor(self);
+            errno = saved;
+            return NULL;
+        }
+
+        port = self->workers[i]->port;
+        self->nworkers++;
+    }
+
+    self->port = port;
+    return self;
+}
+
+#ifdef HAVE_PTHREAD
+
+static void *
+listener_worker(void *arg)
+{
+    listener_loop(arg);
+    return NULL;
+}
+
+#endif
+
+void
+listener_group_run(listener_group *self)
+{
+    int i;
+
+    /* Set before any thread starts, so an early stop isn't lost. */
+    for(i = 0; i != self->nworkers; i++)
+        __atomic_store_n(&self->workers[i]->running, true, __ATOMIC_RELEASE);
+
+#ifdef HAVE_PTHREAD
+    if(self->nworkers > 1)
+    {
+        pthread_t tid[self->nworkers];
+        bool started[self->nworkers];
+
+        /* A worker without a thread just doesn't accept; the kernel 
+         * still queues connections on its socket, so it is better 
+         * to give up on the run.
+         */
+        for(i = 1; i != self->nworkers; i++)
+            if(!(started[i] = pthread_create(&tid[i], NULL, listener_worker, self->workers[i]) == 0))
+                listener_group_stop(self);
+
+        listener_loop(self->workers[0]);
+
+        for(i = 1; i != self->nworkers; i++)
+            if(started[i])
+                pthread_join(tid[i], NULL);
+        return;
+    }
+#endif
+
+    listener_loop(self->workers[0]);
+}
+
+void
+listener_group_stop(listener_group *self)
+{
+    int i;
+
+    for(i = 0; i != self->nworkers; i++)
+        listener_stop(self->workers[i]);
+}
+
+void
+listener_group_stats(const listener_group *self, listener_stats *total)
+{
+    const listener_stats *s;
+    int i;
+
+    memset(total, 0, sizeof(*total));
+
+    for(i = 0; i != self->nworkers; i++)
+    {
+        s = &self->workers[i]->stats;
+
+        total->accepted += s->accepted;
+        total->closed += s->closed;
+        total->messages += s->messages;
+        total->bytes += s->bytes;
+        total->overflows += s->overflows;
+    }
+}
+
+void
+listener_group_dtor(listener_group *self)
+{
+    int i;
+
+    if(self != NULL)
+    {
+        for(i = 0; i != self->nworkers; i++)
+            listener_dtor(self->workers[i]);
+
+        free(self->workers);
+        free(self);
+    }
+    return;
+}
+
+#ifdef HAVE_IO_URING
+
+/* What a completion is for, in the low bits of its user_data; the rest
+ * is the connection, if there is one.
+ */
+#define OP_RECV     0
+#define OP_SEND     1
+#define OP_ACCEPT   2
+#define OP_WAKE     3
+#define OP_MASK     3
+
+#define URING_ENTRIES   256
+#define URING_CQ        4096
+
+static bool
+uring_open(listener *self)
+{
+    /* DEFER_TASKRUN is 6.1, so its being there vouches for multishot
+     * receive (6.0) and provided buffer rings (5.19) too. The ring is
+     * left disabled for the thread that polls it to enable: being the
+     * single issuer, only that thread may then submit.
+     */
+    unsigned flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER |
+                     IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+    int saved;
+
+    if((self->ring = uring_ctor(self->ring, URING_ENTRIES, URING_CQ, flags)) == NULL)
+        return false;
+
+    if(!uring_buffers(self->ring, 0, LISTENER_BUFS, LISTENER_BUFSIZE))
+    {
+        saved = errno;
+        uring_dtor(self->ring);
+        self->ring = NULL;
+        errno = saved;
+        return false;
+    }
+    return true;
+}
+
+static struct io_uring_sqe *
+uring_op(listener *self, int opcode, int fd, connection *conn, int op)
+{
+    struct io_uring_sqe *sqe = uring_sqe(self->ring);
+
+    if(sqe != NULL)
+    {
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->user_data = (uintptr_t)conn | op;
+    }
+    return sqe;
+}
+
+static bool
+uring_accept(listener *self)
+{
+    struct io_uring_sqe *sqe = uring_op(self, IORING_OP_ACCEPT, self->fd, NULL, OP_ACCEPT);
+
+    if(sqe == NULL)
+        return false;
+
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    return true;
+}
+
+static bool
+uring_wake(listener *self)
+{
+    struct io_uring_sqe *sqe = uring_op(self, IORING_OP_POLL_ADD, self->wakefd, NULL, OP_WAKE);
+
+    if(sqe == NULL)
+        return false;
+
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    return true;
+}
+
+/* One receive for the life of the connection, into whichever of the
+ * shared buffers the kernel picks.
+ */
+
+static void
+uring_recv(connection *conn)
+{
+    listener *self = conn->owner;
+    struct io_uring_sqe *sqe = uring_op(self, IORING_OP_RECV, conn->fd, conn, OP_RECV);
+
+    if(sqe == NULL)
+    {
+        conn->closing = true;
+        return;
+    }
+
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = self->ring->bgid;
+    conn->recving = true;
+}
+
+/* A short send is finished by uring_sent sending the rest. */
+
+static void
+uring_send(connection *conn)
+{
+    struct io_uring_sqe *sqe = uring_op(conn->owner, IORING_OP_SEND, conn->fd, conn, OP_SEND);
+
+    if(sqe == NULL)
+    {
+        conn->closing = true;
+        return;
+    }
+
+    sqe->addr = (uintptr_t)(conn->sendbuf + conn->sendoff);
+    sqe->len = conn->sendlen - conn->sendoff;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    conn->sending = true;
+}
+
+/* Sends whatever has been queued, unless a send is already out; there
+ * is only ever one per connection, which keeps the replies in order.
+ */
+
+static void
+uring_flush(connection *conn)
+{
+    char *buf;
+    size_t cap;
+
+    if(conn->sending || conn->closing || conn->outlen == 0)
+        return;
+
+    buf = conn->sendbuf;
+    cap = conn->sendcap;
+
+    conn->sendbuf = conn->out;
+    conn->sendcap = conn->outcap;
+    conn->sendlen = conn->outlen;
+    conn->sendoff = 0;
+
+    conn->out = buf;
+    conn->outcap = cap;
+    conn->outlen = conn->outoff = 0;
+
+    uring_send(conn);
+}
+
+/* A connection can only go once the kernel has finished with it. */
+
+static void
+uring_reap(listener *self, connection *conn)
+{
+    if(!conn->closing)
+        return;
+
+    if(conn->recving || conn->sending)
+        shutdown(conn->fd, SHUT_RDWR);
+    else
+        conn_free(self, conn);
+}
+
+static int
+uring_received(listener *self, connection *conn, int res, unsigned flags)
+{
+    const char *data;
+    size_t avail, left, k;
+    char *p;
+    int msgs = 0;
+
+    if(!(flags & IORING_CQE_F_MORE))
+        conn->recving = false;
+
+    if(res > 0 && !conn->closing)
+    {
+        self->stats.bytes += res;
+        data = uring_buffer(self->ring, flags);
+
+        for(left = res; left > 0 && !conn->closing; left -= k, data += k)
+        {
+            p = mllp_ring_space(conn->ring, &avail);
+
+            if(avail == 0)
+            {
+                self->stats.overflows++;
+                conn->closing = true;
+                break;
+            }
+
+            k = avail < left ? avail : left;
+            memcpy(p, data, k);
+            mllp_ring_commit(conn->ring, k);
+
+            msgs += conn_frames(self, conn);
+        }
+
+        uring_flush(conn);
+    }
+    else if(res == 0 && !conn->closing)
+    {
+        /* The peer is done sending; let any reply finish first. */
+        if(conn->sending)
+            conn->eof = true;
+        else
+            conn->closing = true;
+    }
+    else if(res < 0 && res != -ENOBUFS)
+        conn->closing = true;
+
+    if(flags & IORING_CQE_F_BUFFER)
+        uring_recycle(self->ring, flags);
+
+    /* Out of buffers, or the completion queue overflowed. */
+    if(!conn->recving && !conn->closing && !conn->eof)
+        uring_recv(conn);
+
+    uring_reap(self, conn);
+    return msgs;
+}
+
+static void
+uring_sent(listener *self, connection *conn, int res)
+{
+    conn->sending = false;
+
+    if(res <= 0)
+        conn->closing = true;
+    else if(!conn->closing)
+    {
+        conn->sendoff += res;
+
+        if(conn->sendoff < conn->sendlen)
+            uring_send(conn);
+        else
+        {
+            conn->sendlen = conn->sendoff = 0;
+            uring_flush(conn);
+
+            if(!conn->sending && conn->eof)
+                conn->closing = true;
+        }
+    }
+
+    uring_reap(self, conn);
+}
+
+static int
+uring_poll(listener *self, int ms)
+{
+    struct io_uring_cqe *cqe;
+    connection *conn;
+    uint64_t data, count;
+    unsigned flags;
+    int msgs = 0;
+    int res;
+
+    /* The first poll, on the thread that will do all of them. */
+    if(!self->ring->enabled &&
+       (!uring_enable(self->ring) || !uring_accept(self) || !uring_wake(self)))
+        return -1;
+
+    if(!uring_wait(self->ring, ms) && errno != EINTR && errno != ETIME && errno != EBUSY)
+        return -1;
+
+    while((cqe = uring_cqe(self->ring)) != NULL)
+    {
+        data = cqe->user_data;
+        res = cqe->res;
+        flags = cqe->flags;
+        uring_seen(self->ring);
+
+        conn = (connection *)(uintptr_t)(data & ~(uint64_t)OP_MASK);
+
+        switch(data & OP_MASK)
+        {
+            case OP_RECV:
+                msgs += uring_received(self, conn, res, flags);
+                break;
+
+            case OP_SEND:
+                uring_sent(self, conn, res);
+                break;
+
+            case OP_ACCEPT:
+                if(res >= 0)
+                {
+                    conn = conn_new(self, res);
+                    uring_recv(conn);
+                    uring_reap(self, conn);
+                }
+                if(!(flags & IORING_CQE_F_MORE))
+                    uring_accept(self);
+                break;
+
+            case OP_WAKE:
+                /* Only here to end the wait; running says why. */
+                if(read(self->wakefd, &count, sizeof(count)) < 0)
+                    count = 0;
+                if(!(flags & IORING_CQE_F_MORE))
+                    uring_wake(self);
+                break;
+        }
+    }
+
+    /* The replies go now, rather than with the next wait. */
+    uring_submit(self->ring);
+    arena_reset(self->pool);
+    return msgs;
+}
+
+#endif
@@ -29,24 +29,57 @@
 #include <stdio.h>
 #include <hl7c/message.h>
 #include <hl7c/segment.h>
+#include <hl7c/proto.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+#include <hl7c/vector.h>
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+const message_class message_methods =
+{
+    .push  = message_push,
+    .begin = message_begin,
+    .end   = message_end,
+    .first = message_first,
+    .last  = message_last,
+    .parse = message_parse,
+    .dtor  = message_dtor,
+};
+
+const message_iter_class message_iter_methods =
+{
+    .begin = message_begin,
+    .end   = message_iter_end,
+    .next  = message_iter_next,
+    .dtor  = message_iter_dtor,
+};
 
 message *
 message_ctor(message *self)
+{
+    return message_ctor_arena(self, NULL);
+}
+
+message *
+message_ctor_arena(message *self, arena *pool)
 {
     /* Allocate the initial message structure */
-    self = calloc(1, sizeof(message));
+    if(pool != NULL)
+        self = arena_calloc(pool, sizeof(message));
+    else
+        self = calloc(1, sizeof(message));
+
     self->len = 0;
+    self->cap = 0;
     self->segments = NULL; /* actual storage - indexed by zero. */
+    self->pool = pool;
+    memset(&self->index, 0, sizeof(segindex));
 
     /* set up member functions */
-    self->dtor = message_dtor;   /* destructor */
-    self->push = message_push;   /* add segment */
-    self->begin = message_begin; /* first segment */
-    self->end = message_end;     /* last segment */
-    self->first = message_first; /* first position */
-    self->last = message_last;   /* last position */
-
-    self->parse = message_parse; /* parse hl7 message. */
+    self->vt = &message_methods;
+
     return self;
 }
 
@@ -75,6 +108,101 @@ message_last(message *m)
     return (m->len - 1);
 }
 
+/* Finds the slot for id: either its entry, or the empty slot it would take. */
+
+static segindex_entry *
+segindex_slot(segindex *idx, segid id)
+{
+    unsigned int i = (id * 2654435761u) >> 8;
+
+    for(i &= idx->cap - 1; ; i = (i + 1) & (idx->cap - 1))
+        if(idx->slots[i].id == id || idx->slots[i].id == SEG_NONE)
+            return &idx->slots[i];
+}
+
+/*
+ * Doubles the table, keeping it at most half full so probes stay short.
+ */
+
+static void
+segindex_grow(message *m)
+{
+    segindex *idx = &m->index;
+    segindex_entry *old = idx->slots;
+    int oldcap = idx->cap;
+    int i;
+
+    idx->cap = oldcap ? oldcap * 2 : 16;
+
+    if(m->pool != NULL)
+        idx->slots = arena_calloc(m->pool, sizeof(segindex_entry) * idx->cap);
+    else
+        idx->slots = calloc(idx->cap, sizeof(segindex_entry));
+
+    if(idx->slots == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n",
+                __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    for(i = 0; i != oldcap; i++)
+        if(old[i].id != SEG_NONE)
+            *segindex_slot(idx, old[i].id) = old[i];
+
+    if(m->pool == NULL)
+        free(old);
+}
+
+/* Records that the segment at position pos has the given ID. */
+
+static void
+segindex_add(message *m, segid id, int pos)
+{
+    segindex_entry *e;
+    int cap;
+
+    if(id == SEG_NONE)
+        return;
+
+    if((m->index.used + 1) * 2 > m->index.cap)
+        segindex_grow(m);
+
+    e = segindex_slot(&m->index, id);
+
+    if(e->id == SEG_NONE)
+    {
+        e->id = id;
+        m->index.used++;
+    }
+
+    if(e->count == e->cap)
+    {
+        cap = e->cap ? e->cap * 2 : 2;
+        e->at = vector_resize(m->pool, e->at, sizeof(int) * e->cap, sizeof(int) * cap);
+        e->cap = cap;
+    }
+    e->at[e->count++] = pos;
+}
+
+/* Indexes the segments from position first on. */
+
+static void
+segindex_add_from(message *m, int first)
+{
+    int i;
+
+    for(i = first; i < m->len; i++)
+        segindex_add(m, m->segments[i]->id, i);
+}
+
+/* Segment storage always keeps a spare slot for the NULL that 
+ * message_end returns.
+ */
+
+HL7_VECTOR_DEFINE(message, message, segment *, segments, len, cap, 1, self->pool,
+                  segindex_add_from(self, self->len - n))
+
 message *
 message_push(message *m, segment *seg)
 {
@@ -82,24 +210,41 @@ message_push(message *m, segment *seg)
 
     if(m != NULL && seg != NULL)
     {
-        m->segments = realloc(m->segments, sizeof(segment) * ++m->len);
+        message_grow(m, 1);
+        segindex_add(m, seg->id, m->len);
 
-        if(m->segments == NULL)
-        {
-            fprintf(stderr, "%s: %d: Out of memory!\n",
-                    __func__, __LINE__);
-            exit(ENOMEM);
-        }
-        m->segments[m->len -1] = seg;
+        m->segments[m->len++] = seg;
+        m->segments[m->len] = NULL;
     }
     return m;
 }
 
+segment *
+message_find(message *m, segid id, int n)
+{
+    segindex_entry *e;
+
+    if(m->index.cap == 0 || id == SEG_NONE)
+        return NULL;
+
+    e = segindex_slot(&m->index, id);
+    return (n >= 0 && n < e->count) ? m->segments[e->at[n]] : NULL;
+}
+
+int
+message_count(message *m, segid id)
+{
+    if(m->index.cap == 0 || id == SEG_NONE)
+        return 0;
+
+    return segindex_slot(&m->index, id)->count;
+}
+
 /**
  * \fn message_dtor
  * \brief 
  *      Destructor for the message object. Iterates over each segment, calling the 
- *      segment's destructor. 
+ *      segment's destructor. A message built in an arena just resets it.
  *
  *  \param m - message we want to remove.
  */
@@ -107,17 +252,20 @@ message_push(message *m, segment *seg)
 void
 message_dtor(message *m)
 {
-    segment *s = NULL;
-    message_iter *mit = NULL;
+    int i;
 
-    if(m != NULL)
+    if(m != NULL && m->pool != NULL)
     {
-        mit = message_iter_ctor(m); 
-
-        for(s = mit->begin(m); s != mit->end(mit); s = mit->next(mit))
-            s->dtor(s);
+        arena_reset(m->pool);
+    }
+    else if(m != NULL)
+    {
+        for(i = 0; i != m->len; i++)
+            m->segments[i]->vt->dtor(m->segments[i]);
 
-        mit->dtor(mit);
+        for(i = 0; i != m->index.cap; i++)
+            free(m->index.slots[i].at);
+        free(m->index.slots);
 
         free(m->segments);
         free(m);
@@ -130,15 +278,11 @@ message_iter_ctor(message *m)
 {
     message_iter *i = calloc(1, sizeof(message_iter));
     /* setup our member functions... */
+    i->vt = &message_iter_methods;
     i->klass = m;
-    i->begin = m->begin;
-
-    i->end   = message_iter_end;
-    i->dtor = message_iter_dtor;
-    i->next = message_iter_next;
 
-    i->first = m->first(m);
-    i->last = m->last(m);
+    i->first = m->vt->first(m);
+    i->last = m->vt->last(m);
     i->state = i->first;
 
     return i;
@@ -157,7 +301,7 @@ message_iter_next(message_iter *i)
     else
     {
         i->state = i->first;
-        it = i->klass->end(i->klass);
+        it = i->klass->vt->end(i->klass);
     }
 
     return it;
@@ -172,7 +316,7 @@ message_iter_begin(message_iter *i)
 segment *
 message_iter_end(message_iter *i)
 {
-    return i->klass->end(i->klass);
+    return i->klass->vt->end(i->klass);
 }
 
 void
@@ -182,31 +326,110 @@ message_iter_dtor(message_iter *i)
     return;
 }
 
+/* Steps over MLLP framing bytes at the start of a segment. */
+
+static size_t
+skip_framing(const char *buf, size_t pos, size_t end)
+{
+    while(pos < end && (buf[pos] == VT || buf[pos] == FS))
+        pos++;
+    return pos;
+}
+
 message *
 message_parse(message *msg, FILE *fp, const char *sep, const char *delim)
 {
     segment *seg = NULL;
-    char *line   = NULL;
-    int llen     = 0;       /* length of line  */
-    size_t l     = 0;
-    char end[3];
+    char *buf    = NULL;
+    size_t len   = 0;
+    size_t base  = 0;
+    size_t done  = 0;
+    size_t start = 0;       /* start of the current field */
+    size_t n, k, j, p;
+    uint32_t idx[DELIM_BATCH];
+    char set_chars[2];
+    const encoding *enc;
+    encoding scratch;
+    delimset set;
+    delimset eol;
+
+    /* Read the stream once, then find every separator and delimiter 
+     * in a single pass over it.
+     */
+    buf = slurp(fp, &len);
+
+    /* The field separator declared in MSH-1 wins; delim is only used
+     * for data without a header.
+     */
+    set_chars[0] = sep ? sep[0] : '\r';
+
+    if((enc = encoding_detect(buf, len, &scratch)) != NULL)
+        set_chars[1] = enc->field;
+    else
+        set_chars[1] = delim ? delim[0] : encoding_standard.field;
+
+    delimset_init(&set, set_chars, 2);
+    sep = set_chars;
 
-    /* Break data into lines */
-    while((llen = getdelim(&line, &l, sep[0], fp)) != -1)
+    /* Size the segment array from a count of line ends up front. */
+    delimset_init(&eol, sep, 1);
+    message_reserve(msg, msg->len + delim_count(buf, len, &eol) + 1);
+
+    while(base < len)
+    {
+        n = delim_index(buf + base, len - base, &set, idx, DELIM_BATCH, &done);
+
+        for(k = 0; k != n; k++)
+        {
+            p = base + idx[k];
+
+            /* Skip MLLP framing, then blank lines. */
+            if(seg == NULL)
+                start = skip_framing(buf, start, p);
+
+            if(seg == NULL && buf[p] == sep[0] && p == start)
+            {
+                start = p + 1;
+                continue;
+            }
+
+            /* Construct our segment object on its first field, sized
+             * from the separators between here and the end of the line.
+             */
+            if(seg == NULL)
+            {
+                seg = segment_ctor_arena(seg, msg->pool);
+
+                for(j = k; j != n && buf[base + idx[j]] != sep[0]; j++)
+                    ;
+                segment_reserve(seg, j - k + 1);
+            }
+
+            seg = segment_pushn(seg, buf + start, p - start);
+            start = p + 1;
+
+            /* End of line; push the segment into our message. */
+            if(buf[p] == sep[0])
+            {
+                msg = msg->vt->push(msg, seg);
+                seg = NULL;
+            }
+        }
+        base += done;
+    }
+
+    if(seg == NULL)
+        start = skip_framing(buf, start, len);
+
+    if(seg != NULL || start < len)
     {
-        /* Remove the record separator from the line. */
-        snprintf(end, 2, "%c", line[llen - 1]);
-
-        if(strcmp(end, sep) == 0)
-            line[llen - 1] = 0;
-
-        /* Construct our segment object, parse the line, and push
-         * the segment into our message.
-         */
-        seg = segment_ctor(seg);
-        seg = seg->parse(seg, line, delim);
-        msg = msg->push(msg, seg);
+        if(seg == NULL)
+            seg = segment_ctor_arena(seg, msg->pool);
+
+        seg = segment_pushn(seg, buf + start, len - start);
+        msg = msg->vt->push(msg, seg);
     }
-    free(line);
+
+    free(buf);
     return msg;
 }
@@ -15,6 +15,50 @@ getsize(const char *path)
     return st.st_size;
 }
 
+/**
+ * \fn slurp
+ * \brief
+ *      Reads the rest of fp into a single nul-terminated buffer.
+ *
+ * \param fp - stream to read.
+ * \param len - set to the number of bytes read, not counting the nul.
+ * \returns the buffer, which the caller must free.
+ */
+
+char *
+slurp(FILE *fp, size_t *len)
+{
+    size_t size = 4096;
+    size_t in;
+    char *buf = malloc(size);
+
+    *len = 0;
+
+    if(buf == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    while((in = fread(buf + *len, 1, size - *len - 1, fp)) > 0)
+    {
+        *len += in;
+
+        if(*len + 1 == size)
+        {
+            size *= 2;
+            if((buf = realloc(buf, size)) == NULL)
+            {
+                fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+                exit(ENOMEM);
+            }
+        }
+    }
+
+    buf[*len] = 0;
+    return buf;
+}
+
 void
 mklines(int num, FILE *out)
 {
@@ -0,0 +1,291 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>      /* fprintf */
+#include <stdlib.h>     /* calloc, malloc, free */
+#include <string.h>     /* memchr, memcpy, memmove */
+#include <errno.h>      /* ENOMEM */
+#include <unistd.h>     /* read, sysconf, ftruncate, close */
+#include <sys/mman.h>   /* mmap, memfd_create */
+
+#include <hl7c/mllp.h>
+
+/**
+ * \file mllp.c
+ * \brief
+ *      MLLP framing, and the receive ring.
+ */
+
+static const char frame_start[] = { MLLP_START };
+static const char frame_end[] = { MLLP_END, '\r' };
+
+/*
+ * Maps size bytes of memory twice in a row, so that base[i] and 
+ * base[i + size] are the same byte. Returns NULL if it can't be done.
+ */
+
+static char *
+map_mirrored(size_t size)
+{
+#ifdef MFD_CLOEXEC
+    char *base;
+    int fd;
+
+    if((fd = memfd_create("mllp_ring", MFD_CLOEXEC)) < 0)
+        return NULL;
+
+    if(ftruncate(fd, size) != 0 ||
+       (base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    if(mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+       mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, 2 * size);
+        close(fd);
+        return NULL;
+    }
+
+    close(fd);
+    return base;
+#else
+    return NULL;
+#endif
+}
+
+mllp_ring *
+mllp_ring_ctor(mllp_ring *self, size_t size)
+{
+    size_t want = sysconf(_SC_PAGESIZE);
+
+    self = calloc(1, sizeof(mllp_ring));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    while(want < size)
+        want *= 2;
+
+    self->size = want;
+
+    if((self->base = map_mirrored(want)) != NULL)
+        self->mirrored = true;
+    else if((self->base = malloc(want)) == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+    return self;
+}
+
+/* Where position pos lives. From there on, tail - pos bytes are 
+ * contiguous in either layout.
+ */
+
+static inline char *
+at(const mllp_ring *self, uint64_t pos)
+{
+    return self->base + (self->mirrored ? pos & (self->size - 1) : pos);
+}
+
+char *
+mllp_ring_space(mllp_ring *self, size_t *avail)
+{
+    uint64_t shift;
+
+    if(self->mirrored)
+    {
+        *avail = self->size - (self->tail - self->head);
+        return at(self, self->tail);
+    }
+
+    /* Flat: bring the unread bytes to the front once the end is near. */
+    if(self->head > 0 && self->size - self->tail < self->size / 4)
+    {
+        shift = self->head;
+        memmove(self->base, self->base + shift, self->tail - shift);
+
+        self->head -= shift;
+        self->tail -= shift;
+        self->scan -= shift;
+        self->start = self->start > shift ? self->start - shift : 0;
+    }
+
+    *avail = self->size - self->tail;
+    return at(self, self->tail);
+}
+
+void
+mllp_ring_commit(mllp_ring *self, size_t n)
+{
+    self->tail += n;
+}
+
+ssize_t
+mllp_ring_read(mllp_ring *self, int fd)
+{
+    size_t avail;
+    char *p = mllp_ring_space(self, &avail);
+    ssize_t n;
+
+    if(avail == 0)
+        return 0;
+
+    if((n = read(fd, p, avail)) > 0)
+        mllp_ring_commit(self, n);
+
+    return n;
+}
+
+bool
+mllp_ring_next(mllp_ring *self, const char **frame, size_t *len)
+{
+    const char *p;
+    uint64_t end;
+
+    while(self->scan < self->tail)
+    {
+        p = at(self, self->scan);
+
+        if(!self->inframe)
+        {
+            /* Anything before the start of a frame is dropped. */
+            if((p = memchr(p, MLLP_START, self->tail - self->scan)) == NULL)
+            {
+                self->head = self->scan = self->tail;
+                break;
+            }
+
+            self->scan += p - at(self, self->scan) + 1;
+            self->head = self->start = self->scan;
+            self->inframe = true;
+            continue;
+        }
+
+        if((p = memchr(p, MLLP_END, self->tail - self->scan)) == NULL)
+        {
+            self->scan = self->tail;
+            break;
+        }
+
+        end = self->scan + (p - at(self, self->scan));
+
+        /* Wait for the CR that should follow, unless it's plainly 
+         * not coming.
+         */
+        if(end + 1 == self->tail && self->tail - self->head < self->size)
+        {
+            self->scan = end;
+            break;
+        }
+
+        *frame = at(self, self->start);
+        *len = end - self->start;
+
+        self->scan = end + 1;
+        if(self->scan < self->tail && *at(self, self->scan) == '\r')
+            self->scan++;
+
+        self->head = self->scan;
+        self->inframe = false;
+        return true;
+    }
+
+    /* A frame that fills the ring can never end. */
+    self->overflow = self->inframe && self->tail - self->head == self->size;
+    return false;
+}
+
+void
+mllp_ring_reset(mllp_ring *self)
+{
+    self->head = self->tail = self->scan = self->start = 0;
+    self->inframe = false;
+    self->overflow = false;
+}
+
+void
+mllp_ring_dtor(mllp_ring *self)
+{
+    if(self != NULL)
+    {
+        if(self->mirrored)
+            munmap(self->base, 2 * self->size);
+        else
+            free(self->base);
+        free(self);
+    }
+    return;
+}
+
+size_t
+mllp_frame_end(const char *buf, size_t len, size_t scanned, void *user)
+{
+    const char *p;
+    size_t from = scanned > 0 ? scanned - 1 : 0;   /* an FS waiting for its CR */
+
+    while((p = memchr(buf + from, MLLP_END, len - from)) != NULL)
+    {
+        from = p - buf + 1;
+
+        if(from < len && buf[from] == '\r')
+            return from + 1;
+    }
+    return 0;
+}
+
+int
+mllp_frame(struct iovec *iov, const char *msg, size_t len)
+{
+    iov[0].iov_base = (void *)frame_start;
+    iov[0].iov_len = sizeof(frame_start);
+    iov[1].iov_base = (void *)msg;
+    iov[1].iov_len = len;
+    iov[2].iov_base = (void *)frame_end;
+    iov[2].iov_len = sizeof(frame_end);
+
+    return 3;
+}
+
+size_t
+mllp_encode(char *dst, const char *msg, size_t len)
+{
+    dst[0] = MLLP_START;
+    memcpy(dst + 1, msg, len);
+    dst[len + 1] = MLLP_END;
+    dst[len + 2] = '\r';
+
+    return len + 3;
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memchr, memcmp, memset */
+
+#include <hl7c/msh.h>
+
+/**
+ * \file msh.c
+ * \brief
+ *      MSH header peek.
+ */
+
+#define VT 0x0b
+#define FS 0x1c
+
+bool
+hl7_msh_peek(const char *buf, size_t len, msh_header *hdr)
+{
+    const char *p;
+    size_t i = 0;
+    size_t end;
+    int n;
+
+    while(i < len && (buf[i] == VT || buf[i] == FS || buf[i] == '\r' || buf[i] == '\n'))
+        i++;
+
+    if(len - i < 4 || memcmp(buf + i, "MSH", 3) != 0)
+        return false;
+
+    memset(hdr, 0, sizeof(msh_header));
+
+    /* The segment ends at the first CR, or LF before it. */
+    end = (p = memchr(buf + i, '\r', len - i)) != NULL ? (size_t)(p - buf) : len;
+
+    if((p = memchr(buf + i, '\n', end - i)) != NULL)
+        end = p - buf;
+
+    hdr->segment.off = i;
+    hdr->segment.len = end - i;
+
+    hdr->field = buf[i + 3];
+    hdr->fields[0].off = i;
+    hdr->fields[0].len = 3;
+    hdr->fields[1].off = i + 3;
+    hdr->fields[1].len = 1;
+    i += 4;
+
+    for(n = 2; n != MSH_PEEK_FIELDS && i <= end; n++)
+    {
+        p = memchr(buf + i, hdr->field, end - i);
+
+        hdr->fields[n].off = i;
+        hdr->fields[n].len = (p != NULL ? (size_t)(p - buf) : end) - i;
+        i += hdr->fields[n].len + 1;
+    }
+    hdr->nfields = n;
+
+    /* Encoding characters missing from MSH-2 take their usual values. */
+    p = buf + hdr->fields[2].off;
+    n = hdr->fields[2].len;
+
+    hdr->component    = n > 0 ? p[0] : '^';
+    hdr->repetition   = n > 1 ? p[1] : '~';
+    hdr->escape       = n > 2 ? p[2] : '\\';
+    hdr->subcomponent = n > 3 ? p[3] : '&';
+
+    return true;
+}
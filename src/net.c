@@ -29,6 +29,7 @@
 
 #include "hl7c/net.h"
 #include "hl7c/proto.h"
+#include "hl7c/mllp.h"
 
 #if 0
     bool Socket::create()
@@ -219,80 +220,187 @@ tcp_send(int sockfd, char *buf, int ms, int *sent)
  *
  * \param int total - Reference to int, populates with total number 
  *  of characters read, 
+ *
+ * Reads until the peer closes or goes quiet for ms, so every call 
+ * costs at least ms. Use tcp_recv_frame to stop at the end of a 
+ * message instead.
  */
 
 char *
 tcp_recv(int sockfd, int ms, int max, int *total)
 {
-    char * buf = NULL;
-    char * msg = NULL;
-    int in,
-        chunk,
-        req,
-        i;
-
-    chunk = 64;
+    char *msg = NULL;
+    char *p;
+    size_t cap = 0;
+    size_t want;
+    int in;
+
     *total = 0;
 
-    if(!set_recv_wait(sockfd, ms) || !(ms > 0))
-        return buf;
+    if(!(ms > 0) || sockfd < 0 || !set_recv_wait(sockfd, ms))
+        return msg;
 
+    for(;;)
+    {
+        /* Double the buffer as it fills, keeping a byte for the nul. 
+         * *total is never negative.
+         */
+        if((size_t)*total + 1 >= cap)
+        {
+            want = cap ? cap * 2 : 1024;
 
-    if((buf = (char*)calloc(1, chunk * sizeof(char))) == NULL)
-        return buf;
+            /* Out of memory: return what has arrived so far. */
+            if((p = realloc(msg, want)) == NULL)
+                break;
 
-    
-    if((msg = (char*)calloc(1, chunk * sizeof(char))) == NULL)
-    {
-        free(buf);
-        buf = NULL;
-        return buf;
+            msg = p;
+            cap = want;
+        }
+
+        want = cap - *total - 1;
+
+        /* We've been provided a maximum, so don't let the other side
+         * DoS us.
+         */
+        if(max > 0 && want > (size_t)(max - *total))
+            want = max - *total;
+
+        if(want == 0 || (in = recv(sockfd, msg + *total, want, 0)) <= 0)
+            break;
+
+        *total += in;
     }
 
+    if(msg != NULL)
+        msg[*total] = '\0';
+    return msg;
+}
+
+/* Milliseconds left of ms since start, or -1 to wait forever. */
 
-    if((ms > 0) && (sockfd > -1))
-    {
-        in = i = req = 0;
+static int
+time_left(const struct timespec *start, int ms)
+{
+    struct timespec now;
+    long spent;
+
+    if(ms <= 0)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    spent = (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+
+    return spent < ms ? ms - spent : 0;
+}
+
+/**
+ * \fn tcp_recv_frame
+ * \brief - Receives one message, returning as soon as it is complete.
+ *
+ * \param int sockfd - File descriptor to receive from.
+ *
+ * \param int ms - How long to wait for the whole frame, in 
+ * milliseconds. If 0 or less, will wait indefinitely.
+ *
+ * \param size_t max - Most bytes to accept, 0 for no limit.
+ *
+ * \param complete - Says when a frame is complete; NULL for an MLLP 
+ * end of block (see mllp_frame_end).
+ *
+ * \param char **buf - Set to what was received, nul terminated, to be
+ * freed by the caller whatever the outcome. Anything sent after the 
+ * frame is dropped; a connection that pipelines wants an mllp_ring.
+ *
+ * \param size_t *len - Set to the length of the frame, or of what did
+ * arrive if the frame didn't.
+ *
+ * \returns - TCP_FRAME, or why there is no frame.
+ */
 
-        if(max > 0) 
+tcp_status
+tcp_recv_frame(int sockfd, int ms, size_t max, tcp_frame_fn complete, void *user,
+               char **buf, size_t *len)
+{
+    struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+    struct timespec start;
+    tcp_status status;
+    size_t cap = 0;
+    size_t n = 0;
+    size_t end = 0;
+    size_t want;
+    ssize_t in;
+    char *p;
+    int ready;
+
+    if(complete == NULL)
+        complete = mllp_frame_end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    *buf = NULL;
+
+    for(;;)
+    {
+        /* Double the buffer as it fills, keeping a byte for the nul,
+         * but never past max.
+         */
+        if(n + 1 >= cap)
         {
-            /* We've been provided a maximum,
-             * so don't let the other side DoS 
-             * us.
-             */
-            while((in = recv(sockfd, buf, chunk, 0)) > 0)
+            want = cap ? cap * 2 : 1024;
+
+            if(max > 0 && want > max + 1)
+                want = max + 1;
+
+            if(want <= n + 1)
             {
-                if(req >= max)
-                {
-                    /* We've hit our limit. Return what we're allowed.*/
-                    free(buf);
-                    *total = strlen(msg);
-                    return msg;
-                }
-
-                req =  (strlen(msg)+in) + ++i;
-                msg = realloc(msg, req);
-                msg = strncat(msg, buf, in);
+                status = TCP_TOOBIG;
+                break;
             }
 
-            free(buf);
-            *total = strlen(msg);
-        }
-        else
-        {
-            /* Throw caution to the wind.  */
-            while((in = recv(sockfd, buf, chunk, 0)) > 0)
+            if((p = realloc(*buf, want)) == NULL)
             {
-                req =  (strlen(msg)+in) + ++i;
-                msg = realloc(msg, req);
-                msg = strncat(msg, buf, in);
+                status = TCP_ERROR;
+                errno = ENOMEM;
+                break;
             }
+            *buf = p;
+            cap = want;
+        }
 
-            free(buf);
-            *total = strlen(msg);
+        if((ready = poll(&pfd, 1, time_left(&start, ms))) == 0)
+        {
+            status = TCP_TIMEOUT;
+            break;
+        }
+
+        if(ready < 0 || (in = recv(sockfd, *buf + n, cap - n - 1, 0)) < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN)
+                continue;
+            status = TCP_ERROR;
+            break;
+        }
+
+        if(in == 0)
+        {
+            status = TCP_CLOSED;
+            break;
+        }
+
+        n += in;
+
+        if((end = complete(*buf, n, n - in, user)) > 0)
+        {
+            status = TCP_FRAME;
+            n = end;
+            break;
         }
     }
-    return msg;
+
+    if(*buf != NULL)
+        (*buf)[n] = '\0';
+
+    *len = n;
+    return status;
 }
 
 #ifdef USE_OLD_RESOLVE
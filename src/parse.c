@@ -27,6 +27,8 @@
  */
 
 #include <hl7c/parse.h>
+#include <hl7c/message.h>
+#include <hl7c/segid.h>
 
 /*
  * \fn parse
@@ -38,17 +40,16 @@
 bool
 parse(const char *message)
 {
-    int i,
-        eflag,
-        errn,
-        seg_len;
+    int eflag,
+        errn;
 
     FILE *msg_handle;    /* "file" handle. */
     char *ack = NULL;    /* Copy of message received. */
-    char *seg = NULL;    /* Segment header. */
-    char *field2 = NULL; /* Second field in segment */
+    bool ret = true;
 
-    Multi *hl7 = NULL;
+    struct _message *hl7 = NULL;
+    segment *msa = NULL;
+    segment *err = NULL;
 
     eflag = 0;
     errn  = 0;
@@ -80,88 +81,47 @@ parse(const char *message)
     }
 
     /* 
-     * Pass our handle to our scanning routine. It allocates
-     * the necessary memory, and we have to free it afterward. 
+     * Parse into a message. Every segment is indexed by its ID
+     * as it is pushed, so the ones we want are a lookup away.
      */
 
-    hl7 = multi_scan(msg_handle, "\r", "|");
+    hl7 = message_ctor(hl7);
+    hl7 = message_parse(hl7, msg_handle, "\r", NULL); /* fields split per MSH-1 */
     fclose(msg_handle);
 
-    /* Scan through segments */
-    for(i = 0; i != hl7->size; i++)
+    /* Check our ack field. */
+    if((msa = message_find(hl7, SEG_MSA, 0)) != NULL && msa->len >= 2)
     {
-        seg_len = hl7->members[i]->size;
-
-        if(seg_len >= 2)
+        if(strcmp(msa->data[1], "AE") == 0)
         {
-            /* Skip if it's not a real segment,
-             * i.e., "XXX|..."
-             */
-
-            if(strlen(hl7->members[i]->data[0]) > 1)
-            {
-                seg = strdup(hl7->members[i]->data[0]);
-
-                if(seg == NULL)
-                    die(stderr, ENOMEM,
-                            "%s: Out of memory!\n", libhl7c);
-
-                field2 = strdup(hl7->members[i]->data[1]);
-
-                if(field2 == NULL)
-                    die(stderr, ENOMEM,
-                            "%s: Out of memory!\n", libhl7c);
-
-                //d("[%s|%d] %d (f2 == %s)\n", seg, i, seg_len, field2); 
-                
-                /* Check our ack field. */
-                if(strcmp(seg, "MSA") == 0)
-                {
-                    if(strcmp(field2, "AE") == 0)
-                    {
-                        /* They've reported an error. */
-                        errn = EPROTO;
-                        eflag = 1;
-                    }
-                    else
-                    {
-                        printf("Response: %s\n", ack); 
-                    }
-                } /* MSA Segment */
-
-
-                if((eflag == 1) && 
-                   (strcmp(seg, "ERR") == 0))
-                {
-                    fprintf(stderr, "ERROR: %s\n", field2);
-                    return false;
-
-                } /* ERR Segment */
-
-
-                /* To iterate further through the segments, do 
-                 * something like this:
-                 *
-                 * for(x = 0; x != hl7->members[i]->size; x++)
-                 * {
-                 *      ... process hl7->members[i]->data[x] ...
-                 * }
-                 **/
-
-                /* Clean up after strdup */
-                free(seg);
-                free(field2);
-
-            } /* if strlen ... */
-
-        } /* if seg_len ... */
-
-    } /* for ... */
-
-    /* Release our memory. free_multi iterates
-     * through each segment.
-     */
-    free_multi(hl7);
+            /* They've reported an error. */
+            errn = EPROTO;
+            eflag = 1;
+        }
+        else
+        {
+            printf("Response: %s\n", ack); 
+        }
+    } /* MSA Segment */
+
+    if((eflag == 1) && 
+       (err = message_find(hl7, SEG_ERR, 0)) != NULL && err->len >= 2)
+    {
+        fprintf(stderr, "ERROR: %s\n", (char *)err->data[1]);
+        ret = false;
+
+    } /* ERR Segment */
+
+    /* To look further, fetch other segments the same way:
+     *
+     * for(i = 0; i != message_count(hl7, SEG_OBX); i++)
+     * {
+     *      ... process message_find(hl7, SEG_OBX, i) ...
+     * }
+     **/
+
+    /* Release our memory. message_dtor frees each segment. */
+    message_dtor(hl7);
     free(ack);
-    return true;
+    return ret;
 }
@@ -0,0 +1,362 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, malloc, qsort, free */
+#include <string.h> /* memchr, memcmp */
+#include <stdbool.h>
+#include <errno.h>  /* ENOMEM */
+
+#include <hl7c/query.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+
+/**
+ * \file query.c
+ * \brief
+ *      Compiles paths into a query, and runs queries over raw messages.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+/* Anything that ends a segment. */
+static const delimset terminators =
+{
+    .n = 4,
+    .c = { '\r', '\n', VT, FS },
+    .member = { ['\r'] = true, ['\n'] = true, [VT] = true, [FS] = true },
+};
+
+static void
+query_oom(const char *func, int line)
+{
+    fprintf(stderr, "%s: %d: Out of memory!\n", func, line);
+    exit(ENOMEM);
+}
+
+static bool
+is_header(segid seg)
+{
+    return seg == SEG_MSH || seg == SEG_FHS || seg == SEG_BHS;
+}
+
+/* Reads a positive number, advancing s past it. Returns 0 if there is none. */
+
+static int
+number(const char **s)
+{
+    int n = 0;
+
+    while(**s >= '0' && **s <= '9' && n < 100000)
+        n = n * 10 + *(*s)++ - '0';
+
+    return n;
+}
+
+/*
+ * Compiles one path. Returns false if it is malformed.
+ */
+
+static bool
+parse_path(const char *s, query_path *path)
+{
+    int i;
+
+    for(i = 0; i != 3; i++)
+        if(!((s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= '0' && s[i] <= '9')))
+            return false;
+
+    path->seg = segid_of(s, 3);
+    path->occurrence = 1;
+    path->rep = -1;
+    path->comp = 0;
+    path->sub = 0;
+    s += 3;
+
+    if(*s == '[')
+    {
+        s++;
+        if((path->occurrence = number(&s)) == 0 || *s++ != ']')
+            return false;
+    }
+
+    if(*s++ != '-' || (path->field = number(&s)) == 0)
+        return false;
+
+    if(*s == '(')
+    {
+        s++;
+        if((path->rep = number(&s) - 1) < 0 || *s++ != ')')
+            return false;
+    }
+
+    if(*s == '-')
+    {
+        s++;
+        if((path->comp = number(&s)) == 0)
+            return false;
+        if(path->rep < 0)
+            path->rep = 0;
+    }
+
+    if(*s == '-')
+    {
+        s++;
+        if((path->sub = number(&s)) == 0)
+            return false;
+    }
+
+    /* MSH-1 and MSH-2 are the encoding characters; there's nothing 
+     * below them.
+     */
+    if(is_header(path->seg) && path->field <= 2 && path->rep >= 0)
+        return false;
+
+    return *s == '\0';
+}
+
+static int
+path_cmp(const void *a, const void *b)
+{
+    const query_path *x = a;
+    const query_path *y = b;
+
+    if(x->seg != y->seg)
+        return x->seg < y->seg ? -1 : 1;
+    if(x->occurrence != y->occurrence)
+        return x->occurrence - y->occurrence;
+    if(x->field != y->field)
+        return x->field - y->field;
+    return x->index - y->index;
+}
+
+query *
+query_compile(const char *const *paths, int n, int *bad)
+{
+    query *self = NULL;
+    int i;
+
+    if(bad)
+        *bad = -1;
+
+    if((self = calloc(1, sizeof(query))) == NULL ||
+       (self->paths = calloc(n + 1, sizeof(query_path))) == NULL ||
+       (self->segments = calloc(n + 1, sizeof(query_segment))) == NULL)
+        query_oom(__func__, __LINE__);
+
+    self->n = n;
+
+    for(i = 0; i != n; i++)
+    {
+        self->paths[i].index = i;
+
+        if(!parse_path(paths[i], &self->paths[i]))
+        {
+            if(bad)
+                *bad = i;
+            query_dtor(self);
+            return NULL;
+        }
+    }
+
+    /* Group the paths by segment, so a run only looks each segment 
+     * name up once, and in field order, so fields are walked once.
+     */
+    qsort(self->paths, n, sizeof(query_path), path_cmp);
+
+    for(i = 0; i != n; i++)
+    {
+        if(i == 0 || self->paths[i].seg != self->paths[i - 1].seg)
+        {
+            self->segments[self->nsegments].seg = self->paths[i].seg;
+            self->segments[self->nsegments].first = i;
+            self->nsegments++;
+        }
+        self->segments[self->nsegments - 1].n++;
+    }
+
+    return self;
+}
+
+/* Finds c in [p, end), or returns end. */
+
+static const char *
+find(const char *p, const char *end, char c)
+{
+    const char *hit = memchr(p, c, end - p);
+    return hit ? hit : end;
+}
+
+/*
+ * Narrows [*p, *end) to its n-th piece, counting from 0, when split on
+ * c. Returns false if there are not that many pieces.
+ */
+
+static bool
+nth(const char **p, const char **end, char c, int n)
+{
+    const char *s = *p;
+
+    while(n-- > 0)
+    {
+        if((s = memchr(s, c, *end - s)) == NULL)
+            return false;
+        s++;
+    }
+
+    *p = s;
+    *end = find(s, *end, c);
+    return true;
+}
+
+static bool
+extract(const encoding *enc, const query_path *path, const char *p, const char *end,
+        query_value *out)
+{
+    if(path->rep >= 0 && !nth(&p, &end, enc->repetition, path->rep))
+        return false;
+    if(path->comp > 0 && !nth(&p, &end, enc->component, path->comp - 1))
+        return false;
+    if(path->sub > 0 && !nth(&p, &end, enc->subcomponent, path->sub - 1))
+        return false;
+
+    out->value = p;
+    out->len = end - p;
+    return true;
+}
+
+/*
+ * Resolves the paths of one run that fall on this occurrence of its 
+ * segment. Returns how many were found.
+ */
+
+static int
+query_segment_run(const query *self, const query_segment *run, int occurrence,
+                  const encoding *enc, const char *seg, const char *end,
+                  query_value *out)
+{
+    const query_path *path;
+    const char *fp = seg;
+    const char *fend = find(seg, end, enc->field);
+    bool header = is_header(run->seg);
+    int fieldno = 0;        /* field under the cursor, as split */
+    int want;
+    int found = 0;
+    int i;
+
+    for(i = run->first; i != run->first + run->n; i++)
+    {
+        path = &self->paths[i];
+
+        if(path->occurrence != occurrence)
+            continue;
+
+        /* MSH-1 isn't between separators: it is the separator. */
+        if(header && path->field == 1)
+        {
+            out[path->index].value = seg + 3;
+            out[path->index].len = 1;
+            found++;
+            continue;
+        }
+
+        want = header ? path->field - 1 : path->field;
+
+        while(fieldno < want && fend < end)
+        {
+            fp = fend + 1;
+            fend = find(fp, end, enc->field);
+            fieldno++;
+        }
+
+        if(fieldno == want && extract(enc, path, fp, fend, &out[path->index]))
+            found++;
+    }
+
+    return found;
+}
+
+int
+query_run(const query *self, const char *buf, size_t len, query_value *out)
+{
+    const encoding *enc = NULL;
+    encoding scratch;
+    int seen[self->nsegments + 1];  /* occurrences of each segment so far */
+    size_t pos = 0;
+    size_t end;
+    segid seg;
+    int found = 0;
+    bool any = false;       /* a segment has been seen */
+    int s;
+
+    memset(out, 0, sizeof(query_value) * self->n);
+    memset(seen, 0, sizeof(seen));
+
+    if((enc = encoding_detect(buf, len, &scratch)) == NULL)
+        enc = &encoding_standard;
+
+    while(pos < len && found < self->n)
+    {
+        end = pos + delim_find(buf + pos, len - pos, &terminators);
+
+        if(end - pos >= 3 && (end - pos == 3 || buf[pos + 3] == enc->field))
+        {
+            seg = segid_of(buf + pos, 3);
+            any = true;
+
+            for(s = 0; s != self->nsegments; s++)
+                if(self->segments[s].seg == seg)
+                    break;
+
+            if(s != self->nsegments)
+                found += query_segment_run(self, &self->segments[s], ++seen[s], enc,
+                                           buf + pos, buf + end, out);
+        }
+
+        /* One message only. */
+        if(end < len && buf[end] == FS && any)
+            break;
+
+        pos = end + 1;
+    }
+
+    return found;
+}
+
+void
+query_dtor(query *self)
+{
+    if(self != NULL)
+    {
+        free(self->paths);
+        free(self->segments);
+        free(self);
+    }
+    return;
+}
@@ -57,9 +57,6 @@ readmsg(const char *str)
     message *msg      = NULL;
     segment *seg      = NULL;
 
-    segment_iter *si  = NULL;
-    message_iter *mi  = NULL;
-
     errn  = 0;
 
     /* 
@@ -88,23 +85,21 @@ readmsg(const char *str)
     }
 
     msg = message_ctor(msg);
-    msg = msg->parse(msg, msg_handle, "\r", "|");
+    msg = msg->vt->parse(msg, msg_handle, "\r", NULL);
     fclose(msg_handle);
 
-    for(mi = message_iter_ctor(msg), /* Construct message iterator, and */
-        seg = mi->begin(msg);        /* initialize segment to the first one in the message. */
-        seg != mi->end(mi);          /* While seg != one past end, */
-        seg = mi->next(mi))          /* go on to next segment. */
+    HL7_FOREACH_SEGMENT(msg, seg)      /* No allocation; just an index. */
     {
         printf("%-6.4s %-10.7s %-10.5s %-10.4s\n", "Seq.", "Segment", "Field", "Data");
 
         /* Same as above, but for fields in segments. */
-        for(i = 0, si = segment_iter_ctor(seg), field = si->begin(seg); field != si->end(si); field = si->next(si), i++)
+        i = 0;
+        HL7_FOREACH_FIELD(seg, field)
         {
             if(has_cntrl(field))
             {
                 copy = convert_cntrl(field);
-                segcpy = convert_cntrl((char*)seg->begin(seg));
+                segcpy = convert_cntrl((char*)seg->data[0]);
 
                 printf("[%-3d]%2s%-10.12s %-10d [%s]\n", i, " ", segcpy, i + 1, copy);
 
@@ -113,21 +108,18 @@ readmsg(const char *str)
             }
             else
             {
-                printf("[%-3d]%2s%-10.12s %-10d [%s]\n", i, " ", (char *)seg->begin(seg), i + 1, field);
+                printf("[%-3d]%2s%-10.12s %-10d [%s]\n", i, " ", (char *)seg->data[0], i + 1, field);
             }
+            i++;
         }
 
         printf("\n\n");
-
-        si->dtor(si); 
     }
-    /* Clean up message iterator.*/
-    mi->dtor(mi);
 
     /* Release message object. Calls destructors for contained 
      * segments, as well.
      */
-    msg->dtor(msg);
+    msg->vt->dtor(msg);
     free(ack);
     return true;
 }
@@ -0,0 +1,206 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <string.h> /* memchr, memcmp */
+
+#include <hl7c/sax.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+
+/**
+ * \file sax.c
+ * \brief
+ *      Event-driven parser. Walks the buffer one segment at a time, 
+ *      splitting fields and components only as far as the handler 
+ *      asks for them.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+/* Anything that ends a segment. */
+static const delimset terminators =
+{
+    .n = 4,
+    .c = { '\r', '\n', VT, FS },
+    .member = { ['\r'] = true, ['\n'] = true, [VT] = true, [FS] = true },
+};
+
+static bool
+is_header(const char *seg, size_t len)
+{
+    return len >= 4 && (memcmp(seg, "MSH", 3) == 0 ||
+                        memcmp(seg, "FHS", 3) == 0 ||
+                        memcmp(seg, "BHS", 3) == 0);
+}
+
+/* Finds c in [p, end), or returns end. */
+
+static const char *
+find(const char *p, const char *end, char c)
+{
+    const char *hit = memchr(p, c, end - p);
+    return hit ? hit : end;
+}
+
+/*
+ * Reports every component of every repetition of a field.
+ */
+
+static sax_action
+sax_components(const encoding *enc, const sax_handler *handler, void *user,
+               int field, const char *p, const char *end)
+{
+    const char *rep_end;
+    const char *comp_end;
+    sax_action act;
+    int rep = 0;
+    int comp;
+
+    while(true)
+    {
+        rep_end = find(p, end, enc->repetition);
+
+        for(comp = 1; ; comp++)
+        {
+            comp_end = find(p, rep_end, enc->component);
+            act = handler->on_component(user, field, rep, comp, p, comp_end - p);
+
+            if(act != SAX_CONTINUE)
+                return act;
+
+            if(comp_end == rep_end)
+                break;
+            p = comp_end + 1;
+        }
+
+        if(rep_end == end)
+            return SAX_CONTINUE;
+
+        p = rep_end + 1;
+        rep++;
+    }
+}
+
+/*
+ * Reports one segment. Returns SAX_STOP if a callback asked to stop,
+ * SAX_CONTINUE otherwise.
+ */
+
+static sax_action
+sax_segment(const encoding *enc, const sax_handler *handler, void *user,
+            const char *seg, size_t len, bool header)
+{
+    const char *end = seg + len;
+    const char *p = seg;
+    const char *next = find(p, end, enc->field);
+    sax_action act = SAX_CONTINUE;
+    int field;
+
+    if(handler->on_segment_start)
+        act = handler->on_segment_start(user, seg, next - seg);
+
+    for(field = 0; act == SAX_CONTINUE; field++)
+    {
+        if(handler->on_field)
+            act = handler->on_field(user, field, p, next - p);
+
+        /* MSH-2 holds the encoding characters themselves. */
+        if(act == SAX_CONTINUE && handler->on_component && field > 0 &&
+           !(header && field == 1))
+            act = sax_components(enc, handler, user, field, p, next);
+
+        if(next == end)
+            break;
+
+        p = next + 1;
+        next = find(p, end, enc->field);
+    }
+
+    if(act != SAX_STOP && handler->on_segment_end)
+        act = handler->on_segment_end(user, seg, len);
+
+    return act == SAX_STOP ? SAX_STOP : SAX_CONTINUE;
+}
+
+static bool
+sax_message_end(const sax_handler *handler, void *user, int *nsegments)
+{
+    sax_action act = SAX_CONTINUE;
+
+    if(*nsegments > 0 && handler->on_message_end)
+        act = handler->on_message_end(user, *nsegments);
+
+    *nsegments = 0;
+    return act != SAX_STOP;
+}
+
+bool
+sax_parse(const char *buf, size_t len, const sax_handler *handler, void *user)
+{
+    const encoding *enc = &encoding_standard;
+    encoding scratch;
+    const char *seg;
+    size_t pos = 0;
+    size_t end;
+    int nsegments = 0;
+    bool header;
+
+    while(pos < len)
+    {
+        end = pos + delim_find(buf + pos, len - pos, &terminators);
+        seg = buf + pos;
+
+        /* Blank lines and framing bytes leave empty segments behind. */
+        if(end > pos)
+        {
+            header = is_header(seg, end - pos);
+
+            if(header)
+            {
+                if(!sax_message_end(handler, user, &nsegments))
+                    return false;
+
+                if((enc = encoding_detect(seg, end - pos, &scratch)) == NULL)
+                    enc = &encoding_standard;
+            }
+
+            nsegments++;
+
+            if(sax_segment(enc, handler, user, seg, end - pos, header) == SAX_STOP)
+                return false;
+        }
+
+        if(end < len && buf[end] == FS && !sax_message_end(handler, user, &nsegments))
+            return false;
+
+        pos = end + 1;
+    }
+
+    return sax_message_end(handler, user, &nsegments);
+}
@@ -27,76 +27,111 @@
  */
 
 #include <hl7c/scan.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+#include <hl7c/proto.h>
 
 /**
  * \file scan.c
  *
  */
 
-Array *
-array_scan(FILE *fp,  char *sep, char *delim)
-{
-    FILE *fake_line;   /* fake file pointer */
-
-    ssize_t llen;       /* length of line read */
-    ssize_t flen;       /* length of field read */
-
-    size_t l = 0;       /* Needed for first getdelim */
-    size_t f = 0;       /* Needed for second getdelim */
-
-    int err = 0;        /* storage for errno */
-
-    char *line = NULL;  
-    char *field = NULL;
-    char end[3];
-
-    Array * array;
-    array = array_init();
+/*
+ * Reads fp, and splits it into lines on sep[0] and each line into 
+ * fields on the separator from MSH-1 (delim[0] if there is no header),
+ * with a single pass of the delimiter search. 
+ * Fields go into a new Array per line when multi is given, otherwise
+ * all of them are pushed into flat. Blank lines are skipped.
+ */
 
-    /* Break data into lines */
-    while((getdelim(&line, &l, sep[0], fp)) != -1)
+static void
+scan(FILE *fp, const char *sep, const char *delim, Multi *multi, Array *flat)
+{
+    Array *array = flat;
+    char *buf    = NULL;
+    size_t len   = 0;
+    size_t base  = 0;
+    size_t done  = 0;
+    size_t start = 0;       /* start of the current field */
+    size_t n, k, p;
+    bool fresh   = true;    /* nothing pushed yet for this line */
+    bool eol;
+    uint32_t idx[DELIM_BATCH];
+    char set_chars[2];
+    const encoding *enc;
+    encoding scratch;
+    delimset set;
+
+    buf = slurp(fp, &len);
+
+    /* As in message_parse, MSH-1 overrides delim. */
+    set_chars[0] = sep ? sep[0] : '\r';
+
+    if((enc = encoding_detect(buf, len, &scratch)) != NULL)
+        set_chars[1] = enc->field;
+    else
+        set_chars[1] = delim ? delim[0] : encoding_standard.field;
+
+    delimset_init(&set, set_chars, 2);
+    sep = set_chars;
+
+    while(base < len)
     {
-        /* get the line length, not counting the nul */
-        llen = strlen(line);
-
-        (void)snprintf(end, 2, "%c", line[llen-1]);
-        
-        if(strcmp(end, sep) == 0)
-            line[llen-1] = 0;
+        n = delim_index(buf + base, len - base, &set, idx, DELIM_BATCH, &done);
 
-        /* Create fake file pointer for our second scan. */
-        if((fake_line = fmemopen(line, strlen(line)+1, "r")) == NULL)
+        for(k = 0; k != n; k++)
         {
-            err = errno;
-            (void)fprintf(stderr, "Internal error: aborting\n");
-            exit(err);
+            p = base + idx[k];
+            eol = (buf[p] == sep[0]);
+
+            if(fresh && eol && p == start)
+            {
+                start = p + 1;
+                continue;
+            }
+
+            if(fresh && multi != NULL)
+                array = array_init();
+            fresh = false;
+
+            /* The buffer is ours, so terminate the field in place 
+             * and let push make its copy.
+             */
+            buf[p] = 0;
+            array = push(array, buf + start);
+            start = p + 1;
+
+            if(eol)
+            {
+                if(multi != NULL)
+                    multi = mpush(multi, array);
+                fresh = true;
+            }
         }
+        base += done;
+    }
 
-        /* Now break each line into fields */
-        while((getdelim(&field, &f, delim[0], fake_line)) != -1)
-        {
-            /* Get the field length, not counting the nul */
-            flen = strlen(field);
-
-            /*
-             * Make a copy of the field, push it into our Array.
-             * Must use free_array to clean up afterward.
-             **/
-
-            array = push(array, field);
-
-            (void)snprintf(end, 2, "%c", array->data[array->len][flen-1]);
+    /* Last line, if it wasn't terminated. */
+    if(!fresh || start < len)
+    {
+        if(fresh && multi != NULL)
+            array = array_init();
 
-            if(strcmp(end, delim) == 0)
-                array->data[array->len][flen-1] = 0;
+        array = push(array, buf + start);
 
-        }
-        (void)fclose(fake_line);
+        if(multi != NULL)
+            multi = mpush(multi, array);
     }
 
-    free(line);
-    free(field);
+    free(buf);
+}
 
+Array *
+array_scan(FILE *fp,  char *sep, char *delim)
+{
+    Array *array = array_init();
+
+    scan(fp, sep, delim, NULL, array);
     return array;
 }
 
@@ -107,67 +142,9 @@ array_scan(FILE *fp,  char *sep, char *delim)
 Multi *
 multi_scan(FILE *fp,  char *sep, char *delim)
 {
-    FILE *fake_line;   /* fake file pointer */
-
-    //ssize_t llen;       /* length of line read */
-    //ssize_t flen;       /* length of field read */
-    int llen = 0;
-    int flen = 0;
-
-    size_t l = 0;       /* Needed for first getdelim */
-    size_t f = 0;       /* Needed for second getdelim */
-
-    int err = 0;        /* storage for errno */
-
-    char *line = NULL;
-    char *field = NULL;
-    char end[3];
-
-    Multi *multi;
-    Array *array;
-
-    multi = multi_init();
-
-    /* Break data into lines */
-    while((llen=getdelim(&line, &l, sep[0], fp)) != -1)
-    {
-        (void)snprintf(end, 2, "%c", line[llen-1]);
-
-        if(strcmp(end, sep) == 0)
-            line[llen-1] = 0;
-
-        /* Create fake file pointer for our second scan. */
-        if((fake_line = fmemopen(line, strlen(line)+1, "r")) == NULL)
-        {
-            err = errno;
-            (void)fprintf(stderr, "Internal error: aborting\n");
-            exit(err);
-        }
-
-        array = array_init();
-
-        /* Now break each line into fields */
-        while((flen=getdelim(&field, &f, delim[0], fake_line)) != -1)
-        {
-            /*
-             * Make a copy of the field, push it into our Array.
-             * Must use free_array to clean up afterward.
-             **/
-
-            array = push(array, field);
-            (void)snprintf(end, 2, "%c", array->data[array->len][flen-1]);
-
-            if(strcmp(end, delim) == 0)
-                array->data[array->len][flen-1] = 0;
-
-        }
-        (void)fclose(fake_line);
-        multi = mpush(multi, array);
-    }
-
-    free(line);
-    free(field);
+    Multi *multi = multi_init();
 
+    scan(fp, sep, delim, multi, NULL);
     return multi;
 }
 
@@ -28,6 +28,8 @@
 
 #include <stdio.h>
 #include <hl7c/segment.h>
+#include <hl7c/delim.h>
+#include <hl7c/vector.h>
 
 /**
  * \file segment.c
@@ -36,6 +38,25 @@
  *      well as iterators.
  */
 
+const segment_class segment_methods =
+{
+    .push  = segment_push,
+    .parse = segment_parse,
+    .begin = segment_begin, /* Note, this can be used to get the
+                             * segment type. */
+    .end   = segment_end,
+    .first = segment_first,
+    .last  = segment_last,
+    .dtor  = segment_dtor,
+};
+
+const segment_iter_class segment_iter_methods =
+{
+    .begin = segment_begin,
+    .end   = segment_iter_end,
+    .next  = segment_iter_next,
+    .dtor  = segment_iter_dtor,
+};
 
 /**
  * \fn segment_ctor
@@ -48,26 +69,48 @@
 
 segment *
 segment_ctor(segment *self)
+{
+    return segment_ctor_arena(self, NULL);
+}
+
+/**
+ * \fn segment_ctor_arena
+ * \brief 
+ *      Constructor for a segment living in an arena.
+ *
+ * \param self - the segment we're initializing.
+ * \param pool - the arena to allocate from, or NULL for the heap.
+ * \returns the initialized segment.
+ */
+
+segment *
+segment_ctor_arena(segment *self, arena *pool)
 {
     /* Allocate the initial segment object */
-    self = calloc(1, sizeof(segment));
+    if(pool != NULL)
+        self = arena_calloc(pool, sizeof(segment));
+    else
+        self = calloc(1, sizeof(segment));
+
     self->len = 0;
+    self->cap = 0;
     self->data = NULL; /* actual storage - indexed by zero. */
+    self->pool = pool;
+    self->id = SEG_NONE;
 
     /* set up member functions */
-    self->dtor = segment_dtor;
-    self->push = segment_push;
-    self->begin = segment_begin; /* Note, this can be used to get the
-                                  * segment type. */
-    self->end = segment_end;
-
-    self->first = segment_first;
-    self->last = segment_last;
-    self->parse = segment_parse;
+    self->vt = &segment_methods;
 
     return self;
 }
 
+/* Field storage always keeps a spare slot for the NULL that 
+ * segment_end returns. Appending the first fields sets the ID, as 
+ * pushing does.
+ */
+
+HL7_VECTOR_DEFINE(segment, segment, void *, data, len, cap, 1, self->pool,
+                  if(self->len == n) self->id = segid_of(self->data[0], strlen(self->data[0])))
 
 /**
  * \fn segment_begin
@@ -142,32 +185,44 @@ segment_last(segment *s)
 segment *
 segment_push(segment *s, const void *item)
 {
-    size_t len;
-    void *copy;
-
     /*
      * Don't bother if a hasn't been initialized.
      */
+    if(s != NULL && item != NULL)
+        s = segment_pushn(s, item, strlen(item));
+
+    return s;
+}
+
+/**
+ * \fn segment_pushn
+ * \brief 
+ *      Pushes a copy of the first len bytes of item into segment,
+ *      nul-terminating the copy.
+ *
+ * \param s - the segment to contain the item
+ * \param item - the bytes to copy. Need not be nul-terminated.
+ * \param len - the number of bytes to copy.
+ * \returns the segment, after the push operation.
+ */
+
+segment *
+segment_pushn(segment *s, const char *item, size_t len)
+{
+    char *copy;
+
     if(s != NULL && item != NULL)
     {
-        s->data = realloc(s->data, sizeof(char*) * ++s->len);
+        segment_grow(s, 1);
 
-        if(s->data == NULL)
+        if(s->pool != NULL)
+            copy = arena_strndup(s->pool, item, len);
+        else if((copy = malloc(len + 1)) != NULL)
         {
-            fprintf(stderr, "%s: %d: Out of memory!\n",
-                    __func__, __LINE__);
-            exit(ENOMEM);
+            memcpy(copy, item, len);
+            copy[len] = 0;
         }
 
-        /*
-         * Below is almost exactly how strdup is implemented by
-         * the GNU devs, except that I've made "out of memory"
-         * a fatal error, instead of just returning NULL.
-         */
-
-        len = strlen(item) + 1;
-        copy = malloc(len);
-
         if(copy == NULL)
         {
             fprintf(stderr, "%s: %d: Out of memory!\n",
@@ -175,7 +230,11 @@ segment_push(segment *s, const void *item)
             exit(ENOMEM);
         }
 
-        s->data[s->len - 1] = (char*)memcpy(copy, item, len);
+        if(s->len == 0)
+            s->id = segid_of(item, len);
+
+        s->data[s->len++] = copy;
+        s->data[s->len] = NULL;
     }
     return s;
 }
@@ -193,15 +252,14 @@ segment_push(segment *s, const void *item)
 void
 segment_dtor(segment *s)
 {
-    void *it = NULL;
-    segment_iter *i = NULL;
+    int i;
 
-    i = segment_iter_ctor(s);
+    /* Arena memory is released all at once, by arena_reset. */
+    if(s->pool != NULL)
+        return;
 
-    for(it = i->begin(s); it != i->end(i); it = i->next(i))
-        free(it);
-
-    i->dtor(i);
+    for(i = 0; i != s->len; i++)
+        free(s->data[i]);
 
     free(s->data);
     free(s);
@@ -214,16 +272,12 @@ segment_iter_ctor(segment *s)
 {
     segment_iter *i = calloc(1, sizeof(segment_iter));
     /* setup our member functions... */
+    i->vt = &segment_iter_methods;
     i->klass = s;
-    i->begin = s->begin;
-
-    i->end   = segment_iter_end;
-    i->dtor = segment_iter_dtor;
-    i->next = segment_iter_next;
 
-    i->first = s->first(s);
-    i->last = s->last(s);
-    i->state = s->first(s);
+    i->first = s->vt->first(s);
+    i->last = s->vt->last(s);
+    i->state = s->vt->first(s);
     return i;
 }
 
@@ -237,7 +291,7 @@ segment_iter_next(segment_iter *i)
     else
     {
         i->state = i->first;
-        it = i->klass->end(i->klass);
+        it = i->klass->vt->end(i->klass);
     }
 
     return it;
@@ -270,7 +324,7 @@ segment_iter_begin(segment_iter *i)
 void *
 segment_iter_end(segment_iter *i)
 {
-    return i->klass->end(i->klass);
+    return i->klass->vt->end(i->klass);
 }
 
 void
@@ -283,35 +337,42 @@ segment_iter_dtor(segment_iter *i)
 segment *
 segment_parse(segment *self, char *line, const char *delim)
 {
-    FILE *fp    = NULL;
-    char *field = NULL;
-    int flen    = 0;       /* length of field. */
-    int err     = 0;       /* storage for errno */
-    size_t f    = 0;
-    char end[3];
-
-    if((fp = fmemopen(line, strlen(line) + 1, "r")) == NULL)
-    {
-        err = errno;
-        fprintf(stderr, "Internal error: aborting\n");
-        exit(err);
-    }
+    return segment_parsen(self, line, strlen(line), delim[0]);
+}
 
-    /* Break line into fields. */
-    while((flen = getdelim(&field, &f, delim[0], fp)) != -1)
-    {
-        /* Remove the delimiter from the field. */
-        snprintf(end, 2, "%c", field[flen - 1]);
+/**
+ * \fn segment_parsen
+ * \brief
+ *      Splits len bytes of line on delim, pushing a copy of each field 
+ *      into the segment. Fields are found in place; line does not need 
+ *      to be nul-terminated and is not modified.
+ */
+
+segment *
+segment_parsen(segment *self, const char *line, size_t len, char delim)
+{
+    uint32_t idx[DELIM_BATCH];
+    size_t base  = 0;
+    size_t done  = 0;
+    size_t start = 0;
+    size_t n, k;
+    delimset set;
 
-        if(strcmp(end, delim) == 0)
-            field[flen - 1] = 0;
+    delimset_init(&set, &delim, 1);
+    segment_reserve(self, self->len + delim_count(line, len, &set) + 1);
 
-        /* Make a copy of the field, push it into our segment. */
-        self = self->push(self, field);
-    }
+    while(base < len)
+    {
+        n = delim_index(line + base, len - base, &set, idx, DELIM_BATCH, &done);
 
-    fclose(fp);
-    free(field);
+        for(k = 0; k != n; k++)
+        {
+            self = segment_pushn(self, line + start, base + idx[k] - start);
+            start = base + idx[k] + 1;
+        }
+        base += done;
+    }
 
-    return self;
+    /* Whatever follows the last delimiter is the final field. */
+    return segment_pushn(self, line + start, len - start);
 }
@@ -0,0 +1,322 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, free */
+#include <string.h> /* memcpy, strlen */
+#include <limits.h> /* IOV_MAX */
+#include <unistd.h> /* writev */
+#include <errno.h>  /* ENOMEM, EINTR */
+
+#include <hl7c/serialize.h>
+#include <hl7c/escape.h>
+#include <hl7c/vector.h>
+
+/**
+ * \file serialize.c
+ * \brief
+ *      Message serializer, to a buffer or to iovecs.
+ */
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static const char terminator = '\r';
+
+/* MSH-2, and its FHS and BHS twins, hold the encoding characters. */
+
+static bool
+literal(const segment *seg, int j)
+{
+    return j == 1 && (seg->id == SEG_MSH || seg->id == SEG_FHS || seg->id == SEG_BHS);
+}
+
+/* Size of field j of seg once written. */
+
+static size_t
+field_size(const encoding *enc, const segment *seg, int j, size_t n)
+{
+    return literal(seg, j) ? n : escape_size(enc, &enc->structure, seg->data[j], n);
+}
+
+size_t
+message_serialize_size(message *msg, const encoding *enc)
+{
+    segment *seg = NULL;
+    size_t size = 0;
+    int j;
+
+    if(enc == NULL)
+        enc = &encoding_standard;
+
+    HL7_FOREACH_SEGMENT(msg, seg)
+    {
+        if(seg->len == 0)
+            continue;
+
+        /* A separator between each field, and a terminator. */
+        size += seg->len;
+
+        for(j = 0; j != seg->len; j++)
+            size += field_size(enc, seg, j, strlen(seg->data[j]));
+    }
+    return size;
+}
+
+size_t
+message_serialize(message *msg, const encoding *enc, char *out, size_t cap)
+{
+    segment *seg = NULL;
+    size_t size;
+    size_t n;
+    int j;
+
+    if(enc == NULL)
+        enc = &encoding_standard;
+
+    if((size = message_serialize_size(msg, enc)) > cap)
+        return size;
+
+    HL7_FOREACH_SEGMENT(msg, seg)
+    {
+        if(seg->len == 0)
+            continue;
+
+        for(j = 0; j != seg->len; j++)
+        {
+            if(j > 0)
+                *out++ = enc->field;
+
+            n = strlen(seg->data[j]);
+
+            if(literal(seg, j))
+                out = (char *)memcpy(out, seg->data[j], n) + n;
+            else
+                out += escape_encode(enc, &enc->structure, out, seg->data[j], n);
+        }
+        *out++ = terminator;
+    }
+    return size;
+}
+
+serializer *
+serializer_ctor(serializer *self)
+{
+    self = calloc(1, sizeof(serializer));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+    return self;
+}
+
+void
+serializer_add(serializer *self, const void *base, size_t len)
+{
+    struct iovec *last;
+    int cap;
+
+    if(len == 0)
+        return;
+
+    self->total += len;
+
+    if(self->niov > 0)
+    {
+        last = &self->iov[self->niov - 1];
+
+        if((const char *)last->iov_base + last->iov_len == (const char *)base)
+        {
+            last->iov_len += len;
+            return;
+        }
+    }
+
+    if(self->niov == self->iovcap)
+    {
+        cap = self->iovcap ? self->iovcap * 2 : 64;
+        self->iov = vector_resize(NULL, self->iov, sizeof(struct iovec) * self->iovcap,
+                                  sizeof(struct iovec) * cap);
+        self->iovcap = cap;
+    }
+
+    self->iov[self->niov].iov_base = (void *)base;
+    self->iov[self->niov].iov_len = len;
+    self->niov++;
+}
+
+serializer *
+serializer_message(serializer *self, message *msg, const encoding *enc)
+{
+    segment *seg = NULL;
+    size_t need = 0;
+    size_t n, size;
+    int j;
+
+    if(enc == NULL)
+        enc = &encoding_standard;
+
+    serializer_reset(self);
+
+    /* Size the scratch buffer first: the iovecs will point into it, so
+     * it mustn't move once they do.
+     */
+    HL7_FOREACH_SEGMENT(msg, seg)
+    {
+        for(j = 0; j != seg->len; j++)
+        {
+            n = strlen(seg->data[j]);
+            if((size = field_size(enc, seg, j, n)) != n)
+                need += size;
+        }
+    }
+
+    if(need > self->cap)
+    {
+        self->scratch = vector_resize(NULL, self->scratch, self->cap, need);
+        self->cap = need;
+    }
+
+    HL7_FOREACH_SEGMENT(msg, seg)
+    {
+        if(seg->len == 0)
+            continue;
+
+        for(j = 0; j != seg->len; j++)
+        {
+            if(j > 0)
+                serializer_add(self, &enc->field, 1);
+
+            n = strlen(seg->data[j]);
+
+            if((size = field_size(enc, seg, j, n)) == n)
+                serializer_add(self, seg->data[j], n);
+            else
+            {
+                escape_encode(enc, &enc->structure, self->scratch + self->used, seg->data[j], n);
+                serializer_add(self, self->scratch + self->used, size);
+                self->used += size;
+            }
+        }
+        serializer_add(self, &terminator, 1);
+    }
+    return self;
+}
+
+serializer *
+serializer_view(serializer *self, const message_view *mv)
+{
+    const char *line;
+    span s;
+    int i;
+
+    serializer_reset(self);
+
+    /* Lines ending in '\r' go out with their own terminator, so an
+     * untouched run of segments becomes a single iovec.
+     */
+    for(i = 0; i != mv->len; i++)
+    {
+        s = mv->segments[i].line;
+        line = mv->buf + s.off;
+
+        if(s.off + s.len < mv->size && line[s.len] == terminator)
+            serializer_add(self, line, s.len + 1);
+        else
+        {
+            serializer_add(self, line, s.len);
+            serializer_add(self, &terminator, 1);
+        }
+    }
+    return self;
+}
+
+ssize_t
+writev_all(int fd, struct iovec *iov, int n)
+{
+    size_t total = 0;
+    ssize_t w;
+
+    while(n > 0)
+    {
+        if((w = writev(fd, iov, n < IOV_MAX ? n : IOV_MAX)) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += w;
+
+        /* Step over what went out, and trim a partly written entry. */
+        while(n > 0 && (size_t)w >= iov->iov_len)
+        {
+            w -= iov->iov_len;
+            iov++;
+            n--;
+        }
+
+        if(n > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    return total;
+}
+
+ssize_t
+serializer_writev(serializer *self, int fd)
+{
+    ssize_t n = writev_all(fd, self->iov, self->niov);
+
+    self->niov = 0;
+    return n;
+}
+
+void
+serializer_reset(serializer *self)
+{
+    self->niov = 0;
+    self->used = 0;
+    self->total = 0;
+}
+
+void
+serializer_dtor(serializer *self)
+{
+    if(self != NULL)
+    {
+        free(self->iov);
+        free(self->scratch);
+        free(self);
+    }
+    return;
+}
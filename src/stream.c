@@ -0,0 +1,271 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* calloc, realloc, free */
+#include <string.h> /* memcpy, memmove, memcmp */
+#include <errno.h>  /* ENOMEM */
+
+#include <hl7c/stream.h>
+#include <hl7c/delim.h>
+
+/**
+ * \file stream.c
+ * \brief
+ *      Incremental parser. Input is appended to a buffer, searched for 
+ *      segment terminators from where the last call left off, and each
+ *      complete segment is split into fields and handed out.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+/* Anything that ends a segment. */
+static const delimset terminators =
+{
+    .n = 4,
+    .c = { '\r', '\n', VT, FS },
+    .member = { ['\r'] = true, ['\n'] = true, [VT] = true, [FS] = true },
+};
+
+static void
+stream_oom(const char *func, int line)
+{
+    fprintf(stderr, "%s: %d: Out of memory!\n", func, line);
+    exit(ENOMEM);
+}
+
+stream_parser *
+stream_parser_ctor(stream_parser *self, const stream_handler *handler,
+                   void *user, bool keep, size_t max)
+{
+    self = calloc(1, sizeof(stream_parser));
+
+    if(self == NULL)
+        stream_oom(__func__, __LINE__);
+
+    self->handler = handler;
+    self->user = user;
+    self->keep = keep;
+    self->max = max;
+    return self;
+}
+
+static bool
+is_header(const char *seg, size_t len)
+{
+    return len >= 4 && (memcmp(seg, "MSH", 3) == 0 ||
+                        memcmp(seg, "FHS", 3) == 0 ||
+                        memcmp(seg, "BHS", 3) == 0);
+}
+
+static void
+stream_close_message(stream_parser *self, size_t end)
+{
+    if(self->nsegments == 0)
+        return;
+
+    /* Without keep, the message's bytes are mostly gone already. */
+    if(self->handler && self->handler->on_message)
+    {
+        if(self->keep)
+            self->handler->on_message(self->user, self->buf + self->msg,
+                                      end - self->msg, self->nsegments);
+        else
+            self->handler->on_message(self->user, NULL, 0, self->nsegments);
+    }
+
+    self->nsegments = 0;
+    self->msg = end;
+}
+
+/*
+ * Splits a complete segment into fields and hands it out. A header 
+ * closes whatever message came before it, and sets the encoding for 
+ * the one it starts.
+ */
+
+static void
+stream_segment(stream_parser *self, size_t start, size_t end)
+{
+    uint32_t idx[DELIM_BATCH];
+    const char *seg = self->buf + start;
+    size_t len = end - start;
+    size_t base = 0;
+    size_t done = 0;
+    size_t field = 0;
+    size_t n, k;
+    int nfields = 0;
+
+    if(is_header(seg, len))
+        stream_close_message(self, start);
+
+    if(self->nsegments++ == 0)
+    {
+        self->msg = start;
+        if((self->enc = encoding_detect(seg, len, &self->scratch)) == NULL)
+            self->enc = &encoding_standard;
+    }
+
+    if(self->handler == NULL || self->handler->on_segment == NULL)
+        return;
+
+    /* A segment holds no terminators, so the structure set finds only
+     * field separators.
+     */
+    while(true)
+    {
+        n = base < len ? delim_index(seg + base, len - base, &self->enc->structure,
+                                     idx, DELIM_BATCH, &done) : 0;
+
+        if(nfields + (int)n + 1 > self->fieldcap)
+        {
+            self->fieldcap = (nfields + n + 1) * 2;
+            self->fields = realloc(self->fields, sizeof(span) * self->fieldcap);
+
+            if(self->fields == NULL)
+                stream_oom(__func__, __LINE__);
+        }
+
+        for(k = 0; k != n; k++)
+        {
+            self->fields[nfields].off = field;
+            self->fields[nfields].len = base + idx[k] - field;
+            field = base + idx[k] + 1;
+            nfields++;
+        }
+
+        if(base >= len || (base += done) >= len)
+            break;
+    }
+
+    self->fields[nfields].off = field;
+    self->fields[nfields].len = len - field;
+    nfields++;
+
+    self->handler->on_segment(self->user, seg, len, self->fields, nfields);
+}
+
+bool
+stream_parser_feed(stream_parser *self, const char *buf, size_t n)
+{
+    size_t p, drop;
+
+    if(self->overflow)
+        return false;
+
+    if(self->max && self->len + n > self->max)
+    {
+        self->overflow = true;
+        return false;
+    }
+
+    if(self->len + n > self->cap)
+    {
+        self->cap = self->cap ? self->cap : 4096;
+        while(self->cap < self->len + n)
+            self->cap *= 2;
+
+        if((self->buf = realloc(self->buf, self->cap)) == NULL)
+            stream_oom(__func__, __LINE__);
+    }
+
+    memcpy(self->buf + self->len, buf, n);
+    self->len += n;
+
+    /* Only the new bytes need searching. */
+    while(self->scan < self->len)
+    {
+        p = self->scan + delim_find(self->buf + self->scan, self->len - self->scan,
+                                    &terminators);
+        if(p == self->len)
+            break;
+
+        if(p > self->seg)
+            stream_segment(self, self->seg, p);
+
+        if(self->buf[p] == FS)
+            stream_close_message(self, p);
+
+        self->seg = self->scan = p + 1;
+    }
+    self->scan = self->len;
+
+    /* Forget what has been handed out: everything before the current
+     * segment, or before the current message when keeping messages.
+     */
+    drop = self->seg;
+    if(self->keep && self->nsegments > 0 && self->msg < drop)
+        drop = self->msg;
+
+    if(drop > 0)
+    {
+        memmove(self->buf, self->buf + drop, self->len - drop);
+        self->len -= drop;
+        self->scan -= drop;
+        self->seg -= drop;
+        self->msg = self->msg > drop ? self->msg - drop : 0;
+    }
+    return true;
+}
+
+void
+stream_parser_finish(stream_parser *self)
+{
+    if(self->overflow)
+        return;
+
+    if(self->len > self->seg)
+        stream_segment(self, self->seg, self->len);
+
+    stream_close_message(self, self->len);
+    stream_parser_reset(self);
+}
+
+void
+stream_parser_reset(stream_parser *self)
+{
+    self->len = 0;
+    self->scan = 0;
+    self->seg = 0;
+    self->msg = 0;
+    self->nsegments = 0;
+    self->overflow = false;
+}
+
+void
+stream_parser_dtor(stream_parser *self)
+{
+    if(self != NULL)
+    {
+        free(self->buf);
+        free(self->fields);
+        free(self);
+    }
+    return;
+}
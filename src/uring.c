@@ -0,0 +1,321 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+/**
+ * \file uring.c
+ * \brief
+ *      io_uring through the bare system calls.
+ */
+
+#ifdef HAVE_IO_URING
+
+#define _GNU_SOURCE
+#include <stdio.h>          /* fprintf */
+#include <stdlib.h>         /* calloc, free */
+#include <string.h>         /* memset */
+#include <errno.h>          /* errno, ENOMEM, ENOSYS */
+#include <stdint.h>         /* uintptr_t */
+#include <unistd.h>         /* syscall, close */
+#include <sys/mman.h>       /* mmap */
+#include <sys/syscall.h>    /* __NR_io_uring_* */
+
+#include <hl7c/uring.h>
+
+static int
+sys_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_enter(int fd, unsigned submit, unsigned wait, unsigned flags, void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, argsz);
+}
+
+static int
+sys_register(int fd, unsigned op, void *arg, unsigned n)
+{
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+uring *
+uring_ctor(uring *self, unsigned entries, unsigned cq, unsigned flags)
+{
+    struct io_uring_params p;
+    size_t sqsize, cqsize;
+    char *rings;
+    int saved;
+
+    self = calloc(1, sizeof(uring));
+
+    if(self == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    memset(&p, 0, sizeof(p));
+    p.flags = flags | IORING_SETUP_CQSIZE;
+    p.cq_entries = cq;
+
+    self->rings = self->sqes = MAP_FAILED;
+    self->br = MAP_FAILED;
+    self->enabled = !(flags & IORING_SETUP_R_DISABLED);
+
+    if((self->fd = sys_setup(entries, &p)) < 0)
+    {
+        saved = errno;
+        uring_dtor(self);
+        errno = saved;
+        return NULL;
+    }
+
+    /* Both queues in one mapping, and no dropped completions: 5.5 on. */
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP))
+    {
+        uring_dtor(self);
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    self->ringsize = sqsize > cqsize ? sqsize : cqsize;
+    self->sqesize = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    self->rings = mmap(NULL, self->ringsize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, self->fd, IORING_OFF_SQ_RING);
+    self->sqes = mmap(NULL, self->sqesize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, self->fd, IORING_OFF_SQES);
+
+    if(self->rings == MAP_FAILED || self->sqes == MAP_FAILED)
+    {
+        saved = errno;
+        uring_dtor(self);
+        errno = saved;
+        return NULL;
+    }
+
+    rings = self->rings;
+
+    self->sqhead = (unsigned *)(rings + p.sq_off.head);
+    self->sqtail = (unsigned *)(rings + p.sq_off.tail);
+    self->sqarray = (unsigned *)(rings + p.sq_off.array);
+    self->sqmask = *(unsigned *)(rings + p.sq_off.ring_mask);
+    self->sqentries = p.sq_entries;
+
+    self->cqhead = (unsigned *)(rings + p.cq_off.head);
+    self->cqtail = (unsigned *)(rings + p.cq_off.tail);
+    self->cqmask = *(unsigned *)(rings + p.cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe *)(rings + p.cq_off.cqes);
+
+    return self;
+}
+
+bool
+uring_buffers(uring *self, unsigned short bgid, unsigned n, size_t size)
+{
+    struct io_uring_buf_reg reg;
+    struct io_uring_buf *buf;
+    unsigned i;
+
+    self->brsize = n * sizeof(struct io_uring_buf);
+    self->br = mmap(NULL, self->brsize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(self->br == MAP_FAILED)
+        return false;
+
+    if((self->bufs = malloc(n * size)) == NULL)
+    {
+        fprintf(stderr, "%s: %d: Out of memory!\n", __func__, __LINE__);
+        exit(ENOMEM);
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)self->br;
+    reg.ring_entries = n;
+    reg.bgid = bgid;
+
+    if(sys_register(self->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return false;
+
+    self->bgid = bgid;
+    self->bufsize = size;
+    self->nbufs = n;
+
+    for(i = 0; i != n; i++)
+    {
+        buf = &self->br->bufs[i];
+        buf->addr = (uintptr_t)(self->bufs + i * size);
+        buf->len = size;
+        buf->bid = i;
+    }
+
+    __atomic_store_n(&self->br->tail, (unsigned short)n, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool
+uring_enable(uring *self)
+{
+    if(!self->enabled && sys_register(self->fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) != 0)
+        return false;
+
+    self->enabled = true;
+    return true;
+}
+
+struct io_uring_sqe *
+uring_sqe(uring *self)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail = *self->sqtail;
+
+    if(tail - __atomic_load_n(self->sqhead, __ATOMIC_ACQUIRE) == self->sqentries)
+    {
+        if(!uring_submit(self) ||
+           tail - __atomic_load_n(self->sqhead, __ATOMIC_ACQUIRE) == self->sqentries)
+            return NULL;
+    }
+
+    sqe = &self->sqes[tail & self->sqmask];
+    memset(sqe, 0, sizeof(*sqe));
+
+    self->sqarray[tail & self->sqmask] = tail & self->sqmask;
+    __atomic_store_n(self->sqtail, tail + 1, __ATOMIC_RELEASE);
+    self->queued++;
+
+    return sqe;
+}
+
+bool
+uring_submit(uring *self)
+{
+    int n;
+
+    if(self->queued == 0)
+        return true;
+
+    if((n = sys_enter(self->fd, self->queued, 0, 0, NULL, 0)) < 0)
+        return false;
+
+    self->queued -= n;
+    return true;
+}
+
+bool
+uring_wait(uring *self, int ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    void *argp = NULL;
+    size_t argsz = 0;
+    int n;
+
+    if(ms >= 0)
+    {
+        ts.tv_sec = ms / 1000;
+        ts.tv_nsec = (ms % 1000) * 1000000L;
+
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uintptr_t)&ts;
+
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    /* What was submitted counts even if the wait then failed. */
+    if((n = sys_enter(self->fd, self->queued, 1, flags, argp, argsz)) < 0)
+        return false;
+
+    self->queued -= n;
+    return true;
+}
+
+struct io_uring_cqe *
+uring_cqe(uring *self)
+{
+    unsigned head = *self->cqhead;
+
+    if(head == __atomic_load_n(self->cqtail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &self->cqes[head & self->cqmask];
+}
+
+void
+uring_seen(uring *self)
+{
+    __atomic_store_n(self->cqhead, *self->cqhead + 1, __ATOMIC_RELEASE);
+}
+
+char *
+uring_buffer(uring *self, unsigned flags)
+{
+    return self->bufs + (flags >> IORING_CQE_BUFFER_SHIFT) * self->bufsize;
+}
+
+void
+uring_recycle(uring *self, unsigned flags)
+{
+    unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    unsigned short tail = self->br->tail;
+    struct io_uring_buf *buf = &self->br->bufs[tail & (self->nbufs - 1)];
+
+    buf->addr = (uintptr_t)(self->bufs + bid * self->bufsize);
+    buf->len = self->bufsize;
+    buf->bid = bid;
+
+    __atomic_store_n(&self->br->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+void
+uring_dtor(uring *self)
+{
+    if(self != NULL)
+    {
+        if(self->fd >= 0)
+            close(self->fd);
+        if(self->rings != MAP_FAILED)
+            munmap(self->rings, self->ringsize);
+        if(self->sqes != MAP_FAILED)
+            munmap(self->sqes, self->sqesize);
+        if(self->br != MAP_FAILED)
+            munmap(self->br, self->brsize);
+        free(self->bufs);
+        free(self);
+    }
+    return;
+}
+
+#endif
@@ -0,0 +1,503 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <hl7c/view.h>
+#include <hl7c/delim.h>
+#include <hl7c/encoding.h>
+#include <hl7c/escape.h>
+
+/**
+ * \file view.c
+ * \brief
+ *      Zero-copy message parser. Fills a message_view with spans
+ *      pointing into the caller's buffer.
+ */
+
+#define VT 0x0b     /* MLLP start block */
+#define FS 0x1c     /* MLLP end block */
+
+
+static void
+view_oom(const char *func, int line)
+{
+    fprintf(stderr, "%s: %d: Out of memory!\n", func, line);
+    exit(ENOMEM);
+}
+
+/*
+ * Appends a field span, doubling the field array when it fills up.
+ */
+
+static void
+view_push_field(message_view *self, uint32_t off, uint32_t len)
+{
+    if(self->nfields == self->fieldcap)
+    {
+        self->fieldcap = self->fieldcap ? self->fieldcap * 2 : 64;
+        self->fields = realloc(self->fields, sizeof(span) * self->fieldcap);
+
+        if(self->fields == NULL)
+            view_oom(__func__, __LINE__);
+    }
+
+    self->fields[self->nfields].off = off;
+    self->fields[self->nfields].len = len;
+    self->nfields++;
+}
+
+static void
+view_push_segment(message_view *self, uint32_t off, uint32_t len, uint32_t first)
+{
+    segment_view *seg;
+
+    if(self->len == self->cap)
+    {
+        self->cap = self->cap ? self->cap * 2 : 16;
+        self->segments = realloc(self->segments, sizeof(segment_view) * self->cap);
+
+        if(self->segments == NULL)
+            view_oom(__func__, __LINE__);
+    }
+
+    seg = &self->segments[self->len++];
+    seg->line.off = off;
+    seg->line.len = len;
+    seg->first = first;
+    seg->len = self->nfields - first;
+}
+
+/* Steps over MLLP framing bytes at the start of a segment. */
+
+static size_t
+skip_framing(const char *buf, size_t pos, size_t end)
+{
+    while(pos < end && (buf[pos] == VT || buf[pos] == FS))
+        pos++;
+    return pos;
+}
+
+static void
+view_tree_free(field_view *fv)
+{
+    int r, c;
+
+    for(r = 0; r != fv->nreps; r++)
+    {
+        for(c = 0; c < fv->reps[r].ncomps; c++)
+            free(fv->reps[r].comps[c].subs);
+        free(fv->reps[r].comps);
+    }
+    free(fv->reps);
+    free(fv);
+}
+
+/* Drops the cached splits of the previous message. */
+
+static void
+view_tree_clear(message_view *self)
+{
+    int i;
+
+    for(i = 0; i != self->ntree; i++)
+    {
+        if(self->tree[i] != NULL)
+        {
+            view_tree_free(self->tree[i]);
+            self->tree[i] = NULL;
+        }
+    }
+    self->ntree = 0;
+}
+
+message_view *
+message_view_ctor(message_view *self)
+{
+    self = calloc(1, sizeof(message_view));
+
+    if(self == NULL)
+        view_oom(__func__, __LINE__);
+
+    return self;
+}
+
+/*
+ * The parser proper. Always inlined, so that ENCODING_DISPATCH gets 
+ * a copy with the standard characters folded in as constants.
+ */
+
+static inline __attribute__((always_inline)) void
+view_parse(const encoding *enc, message_view *self, const char *buf, size_t len)
+{
+    uint32_t idx[DELIM_BATCH];
+    size_t base  = 0;       /* start of the unsearched part of buf */
+    size_t done  = 0;
+    size_t n, k;
+    size_t p;               /* position of the current delimiter */
+    size_t start = 0;       /* start of the current field */
+    size_t line  = 0;       /* start of the current segment */
+    uint32_t first = 0;     /* first field of the current segment */
+    bool fresh = true;      /* no field closed yet in this segment */
+
+    /* One pass over the delimiter index: a field separator closes a 
+     * field, a terminator closes a field and its segment. Blank lines
+     * and framing bytes never produce a segment.
+     */
+    while(base < len)
+    {
+        n = delim_index(buf + base, len - base, &enc->structure, idx, DELIM_BATCH, &done);
+
+        for(k = 0; k != n; k++)
+        {
+            p = base + idx[k];
+
+            if(fresh)
+            {
+                start = line = skip_framing(buf, start, p);
+
+                if(buf[p] != enc->field && start == p)
+                {
+                    start = p + 1;  /* blank line */
+                    continue;
+                }
+                fresh = false;
+            }
+
+            view_push_field(self, start, p - start);
+            start = p + 1;
+
+            if(buf[p] != enc->field)
+            {
+                view_push_segment(self, line, p - line, first);
+                first = self->nfields;
+                fresh = true;
+            }
+        }
+        base += done;
+    }
+
+    /* Last segment, if it wasn't terminated. */
+    if(fresh)
+        start = line = skip_framing(buf, start, len);
+
+    if(!fresh || start < len)
+    {
+        view_push_field(self, start, len - start);
+        view_push_segment(self, line, len - line, first);
+    }
+}
+
+message_view *
+message_view_parse(message_view *self, const char *buf, size_t len)
+{
+    view_tree_clear(self);
+
+    self->buf = buf;
+    self->size = len;
+    self->len = 0;
+    self->nfields = 0;
+    if(self->text != NULL)
+        arena_reset(self->text);
+    if((self->enc = encoding_detect(buf, len, &self->scratch)) == NULL)
+        self->enc = &encoding_standard;
+
+    ENCODING_DISPATCH(self->enc, view_parse, self, buf, len);
+
+    return self;
+}
+
+/*
+ * Splits whole on c, returning the number of parts and an array of 
+ * their spans in *out. A literal span is never split.
+ */
+
+static int
+view_split(const char *buf, span whole, char c, bool literal, span **out)
+{
+    const char *p = buf + whole.off;
+    const char *end = p + whole.len;
+    const char *next;
+    int n = 1;
+    int i;
+
+    if(!literal)
+        for(next = p; (next = memchr(next, c, end - next)) != NULL; next++)
+            n++;
+
+    if((*out = malloc(sizeof(span) * n)) == NULL)
+        view_oom(__func__, __LINE__);
+
+    for(i = 0; i != n - 1; i++)
+    {
+        next = memchr(p, c, end - p);
+        (*out)[i].off = p - buf;
+        (*out)[i].len = next - p;
+        p = next + 1;
+    }
+
+    (*out)[i].off = p - buf;
+    (*out)[i].len = end - p;
+    return n;
+}
+
+/*
+ * Gets the split of a field into repetitions, splitting it now if
+ * this is the first time it has been asked for.
+ */
+
+static field_view *
+view_field(message_view *self, const segment_view *seg, int field)
+{
+    field_view *fv;
+    span *parts;
+    uint32_t idx;
+    int i;
+
+    if(seg == NULL || field < 0 || (uint32_t)field >= seg->len)
+        return NULL;
+
+    if(self->ntree < self->nfields)
+    {
+        if(self->treecap < self->nfields)
+        {
+            self->treecap = self->fieldcap;
+            self->tree = realloc(self->tree, sizeof(field_view *) * self->treecap);
+
+            if(self->tree == NULL)
+                view_oom(__func__, __LINE__);
+        }
+        memset(self->tree + self->ntree, 0,
+               sizeof(field_view *) * (self->nfields - self->ntree));
+        self->ntree = self->nfields;
+    }
+
+    idx = seg->first + field;
+
+    if((fv = self->tree[idx]) == NULL)
+    {
+        if((fv = calloc(1, sizeof(field_view))) == NULL)
+            view_oom(__func__, __LINE__);
+
+        fv->literal = (field == 1 && segment_view_is(self, seg, "MSH"));
+        fv->nreps = view_split(self->buf, self->fields[idx], self->enc->repetition,
+                               fv->literal, &parts);
+
+        if((fv->reps = malloc(sizeof(repetition_view) * fv->nreps)) == NULL)
+            view_oom(__func__, __LINE__);
+
+        for(i = 0; i != fv->nreps; i++)
+        {
+            fv->reps[i].whole = parts[i];
+            fv->reps[i].ncomps = -1;
+            fv->reps[i].comps = NULL;
+        }
+        free(parts);
+        self->tree[idx] = fv;
+    }
+    return fv;
+}
+
+static repetition_view *
+view_repetition(message_view *self, const segment_view *seg, int field, int rep)
+{
+    field_view *fv = view_field(self, seg, field);
+    repetition_view *rv;
+    span *parts;
+    int i;
+
+    if(fv == NULL || rep < 0 || rep >= fv->nreps)
+        return NULL;
+
+    rv = &fv->reps[rep];
+
+    if(rv->ncomps < 0)
+    {
+        rv->ncomps = view_split(self->buf, rv->whole, self->enc->component,
+                                fv->literal, &parts);
+
+        if((rv->comps = malloc(sizeof(component_view) * rv->ncomps)) == NULL)
+            view_oom(__func__, __LINE__);
+
+        for(i = 0; i != rv->ncomps; i++)
+        {
+            rv->comps[i].whole = parts[i];
+            rv->comps[i].nsubs = -1;
+            rv->comps[i].subs = NULL;
+        }
+        free(parts);
+    }
+    return rv;
+}
+
+static component_view *
+view_component(message_view *self, const segment_view *seg, int field, int rep, int comp)
+{
+    repetition_view *rv = view_repetition(self, seg, field, rep);
+    component_view *cv;
+
+    if(rv == NULL || comp < 1 || comp > rv->ncomps)
+        return NULL;
+
+    cv = &rv->comps[comp - 1];
+
+    if(cv->nsubs < 0)
+        cv->nsubs = view_split(self->buf, cv->whole, self->enc->subcomponent,
+                               self->tree[seg->first + field]->literal, &cv->subs);
+    return cv;
+}
+
+const char *
+message_view_get(message_view *self, const segment_view *seg,
+                 int field, int rep, int comp, int sub, size_t *len)
+{
+    repetition_view *rv;
+    component_view *cv;
+    const span *part = NULL;
+
+    if(comp == 0)
+    {
+        if((rv = view_repetition(self, seg, field, rep)) != NULL)
+            part = &rv->whole;
+    }
+    else if((cv = view_component(self, seg, field, rep, comp)) != NULL)
+    {
+        if(sub == 0)
+            part = &cv->whole;
+        else if(sub > 0 && sub <= cv->nsubs)
+            part = &cv->subs[sub - 1];
+    }
+
+    if(len != NULL)
+        *len = part ? part->len : 0;
+
+    return part ? self->buf + part->off : NULL;
+}
+
+const char *
+message_view_text(message_view *self, const segment_view *seg,
+                  int field, int rep, int comp, int sub, size_t *len)
+{
+    const char *raw;
+    char *text;
+    size_t n;
+
+    raw = message_view_get(self, seg, field, rep, comp, sub, &n);
+
+    if(raw != NULL && !self->tree[seg->first + field]->literal &&
+       memchr(raw, self->enc->escape, n) != NULL)
+    {
+        if(self->text == NULL)
+            self->text = arena_ctor(self->text, 0);
+
+        text = arena_alloc(self->text, n);
+        n = escape_decode(self->enc, text, raw, n);
+        raw = text;
+    }
+
+    if(len != NULL)
+        *len = n;
+
+    return raw;
+}
+
+int
+message_view_repetitions(message_view *self, const segment_view *seg, int field)
+{
+    field_view *fv = view_field(self, seg, field);
+
+    return fv ? fv->nreps : 0;
+}
+
+int
+message_view_components(message_view *self, const segment_view *seg, int field, int rep)
+{
+    repetition_view *rv = view_repetition(self, seg, field, rep);
+
+    return rv ? rv->ncomps : 0;
+}
+
+int
+message_view_subcomponents(message_view *self, const segment_view *seg,
+                           int field, int rep, int comp)
+{
+    component_view *cv = view_component(self, seg, field, rep, comp);
+
+    return cv ? cv->nsubs : 0;
+}
+
+segment_view *
+message_view_segment(message_view *self, int i)
+{
+    if(i < 0 || i >= self->len)
+        return NULL;
+
+    return &self->segments[i];
+}
+
+const char *
+message_view_field(const message_view *self, const segment_view *seg, int i, size_t *len)
+{
+    const span *f;
+
+    if(seg == NULL || i < 0 || (uint32_t)i >= seg->len)
+    {
+        if(len != NULL)
+            *len = 0;
+        return NULL;
+    }
+
+    f = &self->fields[seg->first + i];
+
+    if(len != NULL)
+        *len = f->len;
+
+    return self->buf + f->off;
+}
+
+bool
+segment_view_is(const message_view *self, const segment_view *seg, const char *name)
+{
+    size_t len;
+    const char *id = message_view_field(self, seg, 0, &len);
+
+    return id != NULL && len == strlen(name) && memcmp(id, name, len) == 0;
+}
+
+void
+message_view_dtor(message_view *self)
+{
+    if(self != NULL)
+    {
+        view_tree_clear(self);
+        arena_dtor(self->text);
+        free(self->tree);
+        free(self->segments);
+        free(self->fields);
+        free(self);
+    }
+    return;
+}
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/view.h>
+#include <hl7c/ack.h>
+#include "tests.h"
+
+static const char *oru = "MSH|^~\\&|A|B|C|D|20090811||ORU^R01^ORU_R01|MSG0001|P|2.5\rOBX|1\r";
+static const char *tail = "||ACK^R01|1|P|2.5\rMSA|AE|MSG0001|Message Accepted\r";
+
+/* Field i of segment seg equals s. */
+
+static bool
+field_is(message_view *mv, int seg, int i, const char *s)
+{
+    size_t len;
+    const char *f = message_view_field(mv, message_view_segment(mv, seg), i, &len);
+
+    return f != NULL && len == strlen(s) && memcmp(f, s, len) == 0;
+}
+
+bool
+ack_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    char *buf = NULL;
+    char got[512];
+    size_t len = 0;
+    ssize_t n;
+    bool ret = true;
+    int fd[2];
+
+    message_view *mv = NULL;
+    ack *a = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    fclose(fp);
+
+    a = ack_ctor(a, "Message Accepted", true);
+
+    if(ack_build(a, "PID|1\r", 6, "AA"))
+    {
+        fprintf(stderr, "ack_test: acknowledged a message without MSH\n");
+        ret = false;
+    }
+
+    if(!ack_build(a, buf, len, "AA") || pipe(fd) != 0)
+    {
+        fprintf(stderr, "ack_test: no ACK\n");
+        ret = false;
+    }
+    else
+    {
+        n = ack_send(a, fd[1]);
+        close(fd[1]);
+        n = n > 0 ? read(fd[0], got, sizeof(got)) : -1;
+        close(fd[0]);
+
+        if(n < 3 || got[0] != 0x0b || got[n - 2] != 0x1c || got[n - 1] != '\r')
+        {
+            fprintf(stderr, "ack_test: bad framing\n");
+            ret = false;
+        }
+        else
+        {
+            /* Sender and receiver swap, and MSA-2 is the inbound MSH-10;
+             * for MSH field i is MSH-(i+1).
+             */
+            mv = message_view_parse(message_view_ctor(mv), got, n);
+
+            if(mv->len != 2 || !field_is(mv, 0, 2, "ReceivingApplication") ||
+               !field_is(mv, 0, 3, "ReceivingFacility") || !field_is(mv, 0, 4, "SendingApp") ||
+               !field_is(mv, 0, 5, "SendingFacility") || !field_is(mv, 0, 8, "ACK^A04") ||
+               !field_is(mv, 0, 9, "0") || !field_is(mv, 0, 11, "2.3") ||
+               !field_is(mv, 1, 1, "AA") || !field_is(mv, 1, 2, "") ||
+               !field_is(mv, 1, 3, "Message Accepted"))
+            {
+                fprintf(stderr, "ack_test: bad ACK: %.*s\n", (int)n, got);
+                ret = false;
+            }
+            message_view_dtor(mv);
+        }
+    }
+
+    /* The next one gets the next control ID, and MSA-2 the sender's. */
+    if(!ack_build(a, oru, strlen(oru), "AE") || a->len < strlen(tail) ||
+       memcmp(a->buf + a->len - strlen(tail), tail, strlen(tail)) != 0)
+    {
+        fprintf(stderr, "ack_test: bad second ACK: %.*s\n", (int)a->len, a->buf);
+        ret = false;
+    }
+
+    ack_dtor(a);
+    free(buf);
+
+    return ret;
+}
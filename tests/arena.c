@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/arena.h>
+#include <hl7c/message.h>
+#include "tests.h"
+
+/*
+ * One oversized cycle mustn't leave the arena big: the block a reset
+ * keeps is capped, and a small cycle after it brings the arena back to
+ * the size it was made with.
+ */
+
+static bool
+arena_shrink_test(void)
+{
+    arena *pool = arena_ctor(NULL, 256);
+    size_t mallocs;
+    bool ret = true;
+    int i;
+
+    for(i = 0; i != 1000; i++)
+        arena_alloc(pool, 100);
+    arena_reset(pool);
+
+    if(pool->first->size > 256 * ARENA_KEEP)
+    {
+        fprintf(stderr, "arena_test: kept %zu bytes after a big cycle\n", pool->first->size);
+        ret = false;
+    }
+
+    /* A middling cycle settles at one block... */
+    for(i = 0; i != 20; i++)
+        arena_alloc(pool, 100);
+    arena_reset(pool);
+    mallocs = pool->mallocs;
+
+    for(i = 0; i != 20; i++)
+        arena_alloc(pool, 100);
+    arena_reset(pool);
+
+    if(pool->mallocs != mallocs || pool->first->next != NULL)
+    {
+        fprintf(stderr, "arena_test: a repeated cycle still allocates\n");
+        ret = false;
+    }
+
+    /* ...and a small one goes back to the original size. */
+    arena_alloc(pool, 100);
+    arena_reset(pool);
+
+    if(pool->first->size != 256)
+    {
+        fprintf(stderr, "arena_test: %zu bytes after a small cycle, not 256\n", pool->first->size);
+        ret = false;
+    }
+
+    arena_dtor(pool);
+    return ret;
+}
+
+/*
+ * Parses the same message into the heap and, repeatedly, into one 
+ * arena, checking the fields agree and that a recycled arena stops
+ * asking malloc for memory.
+ */
+
+bool
+arena_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    arena *pool = NULL;
+    message *heap = NULL;
+    message *m = NULL;
+    size_t mallocs = 0;
+    bool ret = true;
+    int round, i, j;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    heap = message_ctor(heap);
+    heap = heap->vt->parse(heap, fp, "\r", NULL);
+
+    /* A deliberately small arena, so the first message overflows it. */
+    pool = arena_ctor(pool, 256);
+
+    for(round = 0; round != 3; round++)
+    {
+        rewind(fp);
+
+        m = message_ctor_arena(m, pool);
+        m = m->vt->parse(m, fp, "\r", NULL);
+
+        if(m->len != heap->len)
+        {
+            fprintf(stderr, "arena_test: %d segments, expected %d\n", m->len, heap->len);
+            ret = false;
+        }
+
+        for(i = 0; ret && i != m->len; i++)
+            for(j = 0; ret && j != m->segments[i]->len; j++)
+                if(strcmp(m->segments[i]->data[j], heap->segments[i]->data[j]) != 0)
+                {
+                    fprintf(stderr, "arena_test: field %d of segment %d differs\n", j, i);
+                    ret = false;
+                }
+
+        m->vt->dtor(m);
+
+        if(round == 1)
+            mallocs = pool->mallocs;
+    }
+
+    if(pool->mallocs != mallocs)
+    {
+        fprintf(stderr, "arena_test: recycled arena still allocating\n");
+        ret = false;
+    }
+
+    fclose(fp);
+    heap->vt->dtor(heap);
+    arena_dtor(pool);
+
+    if(!arena_shrink_test())
+        ret = false;
+
+    return ret;
+}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/batch.h>
+#include "tests.h"
+
+#define ROWS 300
+
+static const char *lab =
+    "MSH|^~\\&|Lab||||20090103102955.09-0500||ORU^R01|9|P|2.3\r"
+    "PID|1||4711\r"
+    "OBX|1|NM|GLU||98.5\r";
+
+static const char *paths[] = { "MSH-7", "MSH-9-2", "PID-3", "OBX-5", "PV1-2" };
+static const batch_type types[] = { BATCH_EPOCH, BATCH_TEXT, BATCH_INT64, BATCH_DOUBLE, BATCH_TEXT };
+
+/* Checks row i; even rows are the ADT from the file, odd ones the lab result. */
+
+static bool
+check_row(const batch *b, int i, const char *const *msgs)
+{
+    const char *v = NULL;
+    size_t len = 0;
+
+    if(i % 2 == 0)
+        return b->cols[0].valid[i] && b->cols[0].i64[i] == 1250022618 &&
+               (v = batch_text(b, 1, i, msgs, &len)) != NULL && len == 3 && memcmp(v, "A04", 3) == 0 &&
+               b->cols[2].valid[i] && b->cols[2].i64[i] == 13885 &&
+               !b->cols[3].valid[i] && batch_text(b, 3, i, msgs, &len) == NULL &&
+               (v = batch_text(b, 4, i, msgs, &len)) != NULL && len == 1 && *v == 'O';
+
+    return b->cols[0].valid[i] && b->cols[0].i64[i] == 1230996595 &&
+           (v = batch_text(b, 1, i, msgs, &len)) != NULL && len == 3 && memcmp(v, "R01", 3) == 0 &&
+           b->cols[2].valid[i] && b->cols[2].i64[i] == 4711 &&
+           b->cols[3].valid[i] && b->cols[3].f64[i] == 98.5 &&
+           !b->cols[4].valid[i];
+}
+
+bool
+batch_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    const char *msgs[ROWS];
+    size_t lens[ROWS];
+    FILE *fp = NULL;
+    char *adt = NULL;
+    size_t adtlen = 0;
+    bool ret = true;
+    int threads, i;
+
+    batch *b = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    adt = slurp(fp, &adtlen);
+    fclose(fp);
+
+    for(i = 0; i != ROWS; i++)
+    {
+        msgs[i] = i % 2 ? lab : adt;
+        lens[i] = i % 2 ? strlen(lab) : adtlen;
+    }
+
+    if((b = batch_ctor(paths, types, 5, NULL)) == NULL)
+    {
+        fprintf(stderr, "batch_test: couldn't compile the columns\n");
+        free(adt);
+        return false;
+    }
+
+    /* Same answers whatever the number of threads; the batch is reused. */
+    for(threads = 1; threads <= 4; threads += 3)
+    {
+        if(batch_run(b, msgs, lens, ROWS, threads) != ROWS || b->rows != ROWS)
+            ret = false;
+
+        for(i = 0; i != ROWS; i++)
+        {
+            if(!check_row(b, i, msgs))
+            {
+                fprintf(stderr, "batch_test: row %d wrong with %d threads\n", i, threads);
+                ret = false;
+                break;
+            }
+        }
+    }
+
+    batch_dtor(b);
+
+    /* No columns is an empty batch, not a failure. */
+    if((b = batch_ctor(NULL, NULL, 0, NULL)) == NULL ||
+       batch_run(b, msgs, lens, ROWS, 1) != ROWS)
+    {
+        fprintf(stderr, "batch_test: a batch of no columns failed\n");
+        ret = false;
+    }
+
+    batch_dtor(b);
+    free(adt);
+
+    return ret;
+}
@@ -54,6 +54,7 @@ client_test(int argc, char **argv)
     FILE *err = NULL;
 
     char *ack = NULL;
+    size_t acklen = 0;
 
     const char *filename = NULL;
     const char *host = NULL;
@@ -68,7 +69,6 @@ client_test(int argc, char **argv)
         fdin,
         size,
         wait_for_ack,
-        req,
         next_opt;
 
     const char *short_opt = "no:";
@@ -217,9 +217,12 @@ client_test(int argc, char **argv)
 
         if(wait_for_ack)
         {
-            ack = tcp_recv(sockfd, 5000, MAX_READ, &req);
-            if(ack==NULL)
+            if(tcp_recv_frame(sockfd, 5000, MAX_READ, NULL, NULL, &ack, &acklen) != TCP_FRAME)
+            {
+                free(ack);
+                close(sockfd);
                 return false;
+            }
 
             if((ack!=NULL) && 
                 (strlen(ack) > 0))
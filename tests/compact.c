@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/message.h>
+#include <hl7c/compact.h>
+#include "tests.h"
+
+static const char *obs =
+    "MSH|^~\\&|Lab\r"
+    "OBR|1\r"
+    "OBX|1|NM|GLU||98\r"
+    "NTE|1||fasting\r"
+    "OBX|2|NM|NA||140\r"
+    "OBX|3|ST\r";
+
+bool
+compact_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    const char *column[4];
+    FILE *fp = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    bool ret = true;
+    int i, j;
+
+    compact *c = NULL;
+    compact *d = NULL;
+    message *m = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    rewind(fp);
+    m = message_ctor(m);
+    m = m->vt->parse(m, fp, "\r", NULL);
+    fclose(fp);
+
+    /* Parsing raw bytes and packing a parsed message agree with the 
+     * message, field for field. message_parse only ends lines at '\r',
+     * so it also keeps the stray '\n' at the end of the file.
+     */
+    c = compact_parse(compact_ctor(c), buf, len);
+    d = compact_from_message(compact_ctor(d), m);
+
+    if(c->len != 7 || d->len != m->len)
+    {
+        fprintf(stderr, "compact_test: %d and %d segments, expected 7 and %d\n",
+                c->len, d->len, m->len);
+        ret = false;
+    }
+
+    for(i = 0; ret && i != c->len; i++)
+    {
+        if(compact_segment_len(c, i) != m->segments[i]->len || c->ids[i] != m->segments[i]->id)
+        {
+            fprintf(stderr, "compact_test: segment %d differs\n", i);
+            ret = false;
+        }
+
+        for(j = 0; ret && j != m->segments[i]->len; j++)
+        {
+            if(strcmp(compact_field(c, i, j), m->segments[i]->data[j]) != 0 ||
+               strcmp(compact_field(d, i, j), m->segments[i]->data[j]) != 0)
+            {
+                fprintf(stderr, "compact_test: field %d.%d differs\n", i, j);
+                ret = false;
+            }
+        }
+    }
+
+    if(compact_field(c, 2, 99) != NULL || compact_field(c, 99, 0) != NULL ||
+       compact_find(c, SEG_IN1, 1) != 6 || compact_find(c, SEG_OBX, 0) != -1)
+    {
+        fprintf(stderr, "compact_test: bad lookups\n");
+        ret = false;
+    }
+
+    /* OBX-5 of every observation; the last one is too short. Reusing
+     * c keeps its storage.
+     */
+    c = compact_parse(c, obs, strlen(obs));
+
+    if(compact_column(c, SEG_OBX, 5, column, 4) != 3 || strcmp(column[0], "98") != 0 ||
+       strcmp(column[1], "140") != 0 || column[2] != NULL)
+    {
+        fprintf(stderr, "compact_test: bad OBX-5 column\n");
+        ret = false;
+    }
+
+    compact_dtor(c);
+    compact_dtor(d);
+    m->vt->dtor(m);
+    free(buf);
+
+    return ret;
+}
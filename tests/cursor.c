@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/message.h>
+#include <hl7c/segment.h>
+#include "tests.h"
+
+bool
+cursor_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    char *field = NULL;
+    bool ret = true;
+    int nsegs = 0;
+    int nfields = 0;
+    int expected = 0;
+    int i;
+
+    message *m = NULL;
+    message *empty = NULL;
+    segment *s = NULL;
+    segment_cursor sc;
+    message_iter *mit = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    m = message_ctor(m);
+    m = m->vt->parse(m, fp, "\r", NULL);
+    fclose(fp);
+
+    for(i = 0; i != m->len; i++)
+        expected += m->segments[i]->len;
+
+    HL7_FOREACH_SEGMENT(m, s)
+    {
+        nsegs++;
+        HL7_FOREACH_FIELD(s, field)
+            nfields++;
+    }
+
+    if(nsegs != m->len || nfields != expected)
+    {
+        fprintf(stderr, "cursor_test: walked %d segments, %d fields\n", nsegs, nfields);
+        ret = false;
+    }
+
+    /* A cursor can be stopped and picked up again. */
+    sc = segment_cursor_at(m->segments[2]);
+    segment_cursor_next(&sc);
+    field = segment_cursor_next(&sc);
+
+    if(field == NULL || strcmp(field, "1") != 0 || sc.pos != 2)
+    {
+        fprintf(stderr, "cursor_test: bad PID-1\n");
+        ret = false;
+    }
+
+    /* Cursors and heap iterators agree. */
+    mit = message_iter_ctor(m);
+    i = 0;
+    HL7_FOREACH_SEGMENT(m, s)
+    {
+        if(s != (i++ == 0 ? mit->vt->begin(m) : mit->vt->next(mit)))
+        {
+            fprintf(stderr, "cursor_test: iterator disagrees\n");
+            ret = false;
+            break;
+        }
+    }
+    mit->vt->dtor(mit);
+
+    /* Nothing to walk. */
+    empty = message_ctor(empty);
+    HL7_FOREACH_SEGMENT(empty, s)
+        ret = false;
+    empty->vt->dtor(empty);
+
+    m->vt->dtor(m);
+    return ret;
+}
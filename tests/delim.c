@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hl7c/delim.h>
+#include "tests.h"
+
+#define BUFLEN 5000
+
+/*
+ * Runs each implementation the CPU supports over the same random 
+ * buffer, and checks them against a naive search.
+ */
+
+bool
+delim_test(int argc, char **argv)
+{
+    static const char *impls[] = { "scalar", "sse2", "avx2", "avx512" };
+    static const char alphabet[] = "ABC|^~\\&\r\n";
+    char buf[BUFLEN];
+    uint64_t bits[DELIM_WORDS(BUFLEN)];
+    uint32_t pos[DELIM_BATCH];
+    size_t expect, got, base, done, n, k, off, i;
+    delimset set;
+    bool ret = true;
+    int j;
+
+    srand(7);
+    for(i = 0; i != BUFLEN; i++)
+        buf[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+    delimset_init(&set, "|\r^", 3);
+
+    for(j = 0; j != sizeof(impls) / sizeof(impls[0]); j++)
+    {
+        if(!delim_select(impls[j]))
+            continue;
+
+        /* Lengths that end on, before and after a block boundary. */
+        for(off = 0; off != 70; off++)
+        {
+            expect = BUFLEN - off;
+            for(i = off; i != BUFLEN; i++)
+                if(buf[i] == '|' || buf[i] == '\r' || buf[i] == '^')
+                {
+                    expect = i - off;
+                    break;
+                }
+
+            if((got = delim_find(buf + off, BUFLEN - off, &set)) != expect)
+            {
+                fprintf(stderr, "delim_test: %s: find at %zu: %zu != %zu\n",
+                        impls[j], off, got, expect);
+                ret = false;
+            }
+        }
+
+        delim_bitmap(buf + 3, BUFLEN - 3, &set, bits);
+        for(i = 3; i != BUFLEN; i++)
+        {
+            if(((bits[(i - 3) / 64] >> ((i - 3) % 64)) & 1) != 
+               (buf[i] == '|' || buf[i] == '\r' || buf[i] == '^'))
+            {
+                fprintf(stderr, "delim_test: %s: bitmap wrong at %zu\n", impls[j], i);
+                ret = false;
+                break;
+            }
+        }
+
+        /* Walk the whole buffer through a small index. */
+        i = 0;
+        for(base = 0; base < BUFLEN; base += done)
+        {
+            n = delim_index(buf + base, BUFLEN - base, &set, pos, 64, &done);
+
+            for(k = 0; k != n; k++, i++)
+            {
+                while(buf[i] != '|' && buf[i] != '\r' && buf[i] != '^')
+                    i++;
+
+                if(base + pos[k] != i)
+                {
+                    fprintf(stderr, "delim_test: %s: index %zu != %zu\n", 
+                            impls[j], base + pos[k], i);
+                    ret = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    delim_select(NULL);
+    return ret;
+}
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <hl7c/dtm.h>
+#include "tests.h"
+
+static const char *bad[] =
+{
+    "", "abcd", "2009081", "20091301", "20090230", "20090811203060.",
+    "20090811203018+05", "20090811203018.1234567890", "200908112a3018",
+    "20090811203018+9900", "20090811203018-1500",
+};
+
+static bool
+is(const char *s, int32_t zone, int64_t seconds, int32_t nanos, dtm_precision precision)
+{
+    dtm d;
+
+    if(!dtm_decode(s, strlen(s), zone, &d) || d.seconds != seconds || d.nanos != nanos ||
+       d.precision != precision)
+    {
+        fprintf(stderr, "dtm_test: %s decoded wrong\n", s);
+        return false;
+    }
+    return true;
+}
+
+bool
+dtm_test(int argc, char **argv)
+{
+    const char *column[3] = { "20090811203018", NULL, "2009" };
+    size_t lens[3] = { 14, 0, 4 };
+    const char *tz = getenv("TZ");
+    char *saved = tz != NULL ? strdup(tz) : NULL;
+    int64_t out[3];
+    bool valid[3];
+    char buf[32];
+    struct tm tm;
+    time_t t;
+    bool ret = true;
+    dtm d;
+    int i;
+
+    ret &= is("20090811203018", DTM_UTC, 1250022618, 0, DTM_SECOND);
+    ret &= is("20090103102955.09-0500", DTM_UTC, 1230996595, 90000000, DTM_FRACTION);
+    ret &= is("2009", DTM_UTC, 1230768000, 0, DTM_YEAR);
+    ret &= is("200908112030+0530", DTM_UTC, 1250002800, 0, DTM_MINUTE);
+    ret &= is("200908112030+1400", DTM_UTC, 1249972200, 0, DTM_MINUTE);
+    ret &= is("20090811203018", -4 * 3600, 1250022618 + 4 * 3600, 0, DTM_SECOND);
+
+    for(i = 0; i != sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        if(dtm_decode(bad[i], strlen(bad[i]), DTM_UTC, &d))
+        {
+            fprintf(stderr, "dtm_test: %s decoded\n", bad[i]);
+            ret = false;
+        }
+    }
+
+    /* The word-at-a-time path agrees with the calendar, and with the 
+     * digit-at-a-time path that minutes take.
+     */
+    for(t = -2208988800LL; ret && t < 4102444800LL; t += 7919 * 3607)
+    {
+        gmtime_r(&t, &tm);
+        strftime(buf, sizeof(buf), "%Y%m%d%H%M%S", &tm);
+
+        if(!dtm_decode(buf, 14, DTM_UTC, &d) || d.seconds != t ||
+           !dtm_decode(buf, 12, DTM_UTC, &d) || d.seconds != t - tm.tm_sec)
+        {
+            fprintf(stderr, "dtm_test: %s decoded wrong\n", buf);
+            ret = false;
+        }
+    }
+
+    /* Local time, summer and winter; an offset in the value wins. */
+    setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+    tzset();
+
+    ret &= is("20090811203018", DTM_LOCAL, 1250022618 + 4 * 3600, 0, DTM_SECOND);
+    ret &= is("20090103102955", DTM_LOCAL, 1230996595, 0, DTM_SECOND);
+    ret &= is("20090103102955-0500", DTM_LOCAL, 1230996595, 0, DTM_SECOND);
+
+    if(saved != NULL)
+        setenv("TZ", saved, 1);
+    else
+        unsetenv("TZ");
+    tzset();
+    free(saved);
+
+    if(dtm_to_epoch_batch(column, lens, 3, DTM_UTC, out, valid) != 2 || !valid[0] || valid[1] ||
+       !valid[2] || out[0] != 1250022618 || out[2] != 1230768000)
+    {
+        fprintf(stderr, "dtm_test: bad column\n");
+        ret = false;
+    }
+
+    return ret;
+}
@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hl7c/view.h>
+#include <hl7c/edit.h>
+#include <hl7c/serialize.h>
+#include "tests.h"
+
+static const char *adt =
+    "MSH|^~\\&|Sender|Fac|Receiver|Fac|20090811203018||ADT^A04|1|P|2.3\r"
+    "EVN|A04|20090811203018\r"
+    "PID|1||13885||Public^John^Q\r"
+    "PV1|1|O\r"
+    "NTE|1||drop me\r"
+    "IN1|1|UHC3\r";
+
+static const char *expect =
+    "MSH|^~\\&|Sender|Fac|Router^Hub|Fac|20090811203018||ADT^A04|1|P|2.3\r"
+    "EVN|A04|20090811203018\r"
+    "PID|1||13885||Public^Jon\\S\\Q^Q\r"
+    "PV1|1|O|||||~^^DOC\r"
+    "IN1|1|UHC3\r";
+
+/* Gathers what out describes. */
+
+static char *
+gather(const serializer *out)
+{
+    char *buf = malloc(out->total + 1);
+    size_t n = 0;
+    int i;
+
+    for(i = 0; i != out->niov; i++)
+    {
+        memcpy(buf + n, out->iov[i].iov_base, out->iov[i].iov_len);
+        n += out->iov[i].iov_len;
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+bool
+edit_test(int argc, char **argv)
+{
+    bool ret = true;
+    char *got = NULL;
+
+    message_view *mv = NULL;
+    message_edit *e = NULL;
+    serializer *out = NULL;
+
+    mv = message_view_parse(message_view_ctor(mv), adt, strlen(adt));
+    e = message_edit_ctor(e, mv);
+    out = serializer_ctor(out);
+
+    /* Untouched, the message is one iovec of the original buffer. */
+    message_edit_serialize(e, out);
+
+    if(out->niov != 1 || out->iov[0].iov_base != (void *)adt || out->total != strlen(adt))
+    {
+        fprintf(stderr, "edit_test: unedited message was copied\n");
+        ret = false;
+    }
+
+    /* MSH-5 is field 4. Later patches to a segment see the earlier 
+     * ones, and are made in any order across segments.
+     */
+    if(!message_edit_segment(e, 4, NULL, 0) ||
+       !message_edit_component(e, 3, 7, 1, 3, "DOC", 3) ||
+       !message_edit_field(e, 0, 4, "Router", 6) ||
+       !message_edit_component(e, 2, 5, 0, 2, "Jon^Q", 5) ||
+       !message_edit_component(e, 0, 4, 0, 2, "Hub", 3))
+    {
+        fprintf(stderr, "edit_test: patch refused\n");
+        ret = false;
+    }
+
+    if(message_edit_field(e, 0, 1, "", 0) || message_edit_field(e, 6, 1, "", 0) ||
+       message_edit_component(e, 1, 1, 0, 0, "", 0))
+    {
+        fprintf(stderr, "edit_test: bad patch accepted\n");
+        ret = false;
+    }
+
+    message_edit_serialize(e, out);
+    got = gather(out);
+
+    if(strcmp(got, expect) != 0)
+    {
+        fprintf(stderr, "edit_test: got\n%s\n", got);
+        ret = false;
+    }
+
+    /* EVN goes out from the original buffer; IN1 too. */
+    if(out->niov != 8)
+    {
+        fprintf(stderr, "edit_test: %d iovecs, expected 8\n", out->niov);
+        ret = false;
+    }
+
+    free(got);
+
+    message_edit_reset(e, mv);
+    message_edit_serialize(e, out);
+
+    if(out->niov != 1)
+    {
+        fprintf(stderr, "edit_test: reset kept patches\n");
+        ret = false;
+    }
+
+    serializer_dtor(out);
+    message_edit_dtor(e);
+    message_view_dtor(mv);
+
+    return ret;
+}
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hl7c/view.h>
+#include <hl7c/escape.h>
+#include "tests.h"
+
+static const struct
+{
+    const char *in;
+    const char *out;
+} cases[] =
+{
+    { "plain", "plain" },
+    { "a\\F\\b\\S\\c\\T\\d\\R\\e\\E\\f", "a|b^c&d~e\\f" },
+    { "\\X0D0A\\x\\X41\\", "\r\nxA" },
+    { "bold \\H\\on\\N\\, \\.br\\", "bold \\H\\on\\N\\, \\.br\\" },
+    { "odd \\X0\\ and \\Xzz\\", "odd \\X0\\ and \\Xzz\\" },
+    { "trailing \\F\\ \\", "trailing | \\" },
+    { "\\\\", "\\\\" },
+};
+
+static const char *obx =
+    "MSH|^~\\&|Lab\r"
+    "OBX|1|ST|Note||Smith \\T\\ Jones^Ward \\F\\ 5|\\H\\raw\r";
+
+bool
+escape_test(int argc, char **argv)
+{
+    const encoding *enc = &encoding_standard;
+    char buf[128];
+    char enc_buf[256];
+    const char *text;
+    size_t n, m;
+    bool ret = true;
+    int i;
+
+    message_view *mv = NULL;
+    segment_view *seg = NULL;
+
+    /* In place, and back again. */
+    for(i = 0; i != sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        strcpy(buf, cases[i].in);
+        n = escape_decode(enc, buf, buf, strlen(buf));
+
+        if(n != strlen(cases[i].out) || memcmp(buf, cases[i].out, n) != 0)
+        {
+            fprintf(stderr, "escape_test: %s decoded to %.*s\n", cases[i].in, (int)n, buf);
+            ret = false;
+        }
+
+        m = escape_encode(enc, &enc->all, enc_buf, buf, n);
+
+        if(m != escape_size(enc, &enc->all, buf, n) ||
+           escape_decode(enc, enc_buf, enc_buf, m) != n || memcmp(enc_buf, buf, n) != 0)
+        {
+            fprintf(stderr, "escape_test: %s doesn't survive encoding\n", cases[i].out);
+            ret = false;
+        }
+    }
+
+    /* Fields are decoded when read, and only then. */
+    mv = message_view_parse(message_view_ctor(mv), obx, strlen(obx));
+    seg = message_view_segment(mv, 1);
+
+    text = message_view_text(mv, seg, 5, 0, 1, 0, &n);
+
+    if(n != 13 || memcmp(text, "Smith & Jones", n) != 0 || mv->text == NULL)
+    {
+        fprintf(stderr, "escape_test: bad OBX-5.1 %.*s\n", (int)n, text);
+        ret = false;
+    }
+
+    text = message_view_text(mv, seg, 5, 0, 2, 0, &n);
+
+    if(n != 8 || memcmp(text, "Ward | 5", n) != 0)
+    {
+        fprintf(stderr, "escape_test: bad OBX-5.2 %.*s\n", (int)n, text);
+        ret = false;
+    }
+
+    if(message_view_text(mv, seg, 3, 0, 1, 0, &n) != obx + 22 ||
+       message_view_text(mv, message_view_segment(mv, 0), 1, 0, 0, 0, &n) != obx + 4 || n != 4 ||
+       message_view_text(mv, seg, 9, 0, 1, 0, &n) != NULL)
+    {
+        fprintf(stderr, "escape_test: copied a value that needn't be\n");
+        ret = false;
+    }
+
+    message_view_dtor(mv);
+
+    return ret;
+}
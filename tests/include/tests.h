@@ -33,4 +33,26 @@ bool tcp_test(int argc, char **argv);
 bool client_test(int argc, char **argv);
 bool parser_test(int argc, char **argv);
 bool testread(int argc, char **argv);
+bool view_test(int argc, char **argv);
+bool delim_test(int argc, char **argv);
+bool arena_test(int argc, char **argv);
+bool stream_test(int argc, char **argv);
+bool sax_test(int argc, char **argv);
+bool query_test(int argc, char **argv);
+bool segid_test(int argc, char **argv);
+bool legacy_test(int argc, char **argv);
+bool cursor_test(int argc, char **argv);
+bool vector_test(int argc, char **argv);
+bool compact_test(int argc, char **argv);
+bool batch_test(int argc, char **argv);
+bool serialize_test(int argc, char **argv);
+bool edit_test(int argc, char **argv);
+bool ack_test(int argc, char **argv);
+bool msh_test(int argc, char **argv);
+bool dtm_test(int argc, char **argv);
+bool escape_test(int argc, char **argv);
+bool mllp_test(int argc, char **argv);
+bool recv_test(int argc, char **argv);
+bool listener_test(int argc, char **argv);
+bool listener_group_test(int argc, char **argv);
 #endif
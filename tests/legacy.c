@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/segment.h>
+#include <hl7c/message.h>
+#include <hl7c/legacy.h>
+#include "tests.h"
+
+/*
+ * Code written before the method tables, as it was: every call goes
+ * through obj->method(...), which legacy.h turns into obj->vt->method.
+ */
+
+bool
+legacy_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    void *field = NULL;
+    bool ret = true;
+    int fields = 0, want = 0;
+    int i;
+
+    segment *s;
+    segment_iter *sit;
+
+    message *m = NULL;
+    message_iter *mit = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    m = message_ctor(m);
+    m = m->parse(m, fp, "\r", "|");
+    fclose(fp);
+
+    for(mit = message_iter_ctor(m), s = mit->begin(m);
+        s != mit->end(mit);
+        s = mit->next(mit))
+    {
+        for(sit = segment_iter_ctor(s), field = sit->begin(s);
+            field != sit->end(sit);
+            field = sit->next(sit))
+            fields++;
+
+        sit->dtor(sit);
+    }
+    mit->dtor(mit);
+
+    for(i = m->first(m); i <= m->last(m); i++)
+        want += m->segments[i]->len;
+
+    if(m->len == 0 || fields != want)
+    {
+        fprintf(stderr, "legacy_test: %d fields through the iterators, expected %d\n", fields, want);
+        ret = false;
+    }
+
+    s = segment_ctor(NULL);
+    s = s->push(s, "ZZZ");
+    s = s->push(s, "1");
+
+    if(s->last(s) != 1 || strcmp(s->begin(s), "ZZZ") != 0)
+    {
+        fprintf(stderr, "legacy_test: pushed segment is wrong\n");
+        ret = false;
+    }
+
+    m = m->push(m, s);
+
+    if(m->end(m) != NULL || m->segments[m->last(m)] != s)
+    {
+        fprintf(stderr, "legacy_test: pushed message is wrong\n");
+        ret = false;
+    }
+
+    m->dtor(m);
+    return ret;
+}
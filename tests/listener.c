@@ -0,0 +1,413 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <hl7c/listener.h>
+#include <hl7c/mllp.h>
+#include <hl7c/ack.h>
+#include "tests.h"
+
+#define CLIENTS 40
+#define EACH    3
+
+#define PENDING 2000   /* messages whose ACKs a half-closed peer leaves queued */
+
+typedef struct
+{
+    ack *reply;
+    int expect;
+    int sndbuf;         /* shrinks the send buffer, if set */
+} server;
+
+static void
+on_message(connection *conn, const char *msg, size_t len, void *user)
+{
+    server *s = user;
+
+    /* Anything the handler needs for the batch can come from the pool. */
+    msg = arena_strndup(conn->owner->pool, msg, len);
+
+    if(s->sndbuf)
+        setsockopt(conn->fd, SOL_SOCKET, SO_SNDBUF, &s->sndbuf, sizeof(s->sndbuf));
+
+    if(ack_build(s->reply, msg, len, "AA"))
+        connection_sendv(conn, s->reply->iov, s->reply->niov);
+
+    if(conn->owner->stats.messages + 1 == (uint64_t)s->expect)
+        listener_stop(conn->owner);
+}
+
+static int
+dial(int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Reads n ACKs from fd, checking that MSA-2 is each control ID in turn. */
+
+static bool
+read_acks(int fd, int client, int n)
+{
+    mllp_ring *ring = mllp_ring_ctor(NULL, 4096);
+    const char *frame, *msa;
+    char want[32];
+    size_t len;
+    int got = 0;
+
+    while(got != n)
+    {
+        if(!mllp_ring_next(ring, &frame, &len))
+        {
+            if(mllp_ring_read(ring, fd) <= 0)
+                break;
+            continue;
+        }
+
+        snprintf(want, sizeof(want), "MSA|AA|C%d-%d\r", client, got);
+        msa = memmem(frame, len, "MSA|", 4);
+
+        if(msa == NULL || (size_t)(frame + len - msa) != strlen(want) ||
+           memcmp(msa, want, strlen(want)) != 0)
+            break;
+        got++;
+    }
+
+    mllp_ring_dtor(ring);
+    return got == n;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* A peer that sends, hangs up its side and is slow to read its ACKs:
+ * the listener must wait for the socket to drain, not spin, and close
+ * it once every ACK is out.
+ */
+
+static bool
+half_close_test(listener *l, server *s, const char *name)
+{
+    static char buf[PENDING * 64];
+    char msg[128];
+    uint64_t before = l->stats.messages;
+    int small = 4096;
+    int fd, acks = 0;
+    size_t n = 0, off;
+    ssize_t got;
+    double start;
+    bool ret = true;
+    int i, m;
+
+    s->sndbuf = small;
+    fd = dial(l->port);
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    for(i = 0; i != PENDING; i++)
+    {
+        m = snprintf(msg, sizeof(msg), "MSH|^~\\&|A|B|C|D|||ADT^A01|H%d|P|2.5\r", i);
+        n += mllp_encode(buf + n, msg, m);
+    }
+    /* The listener reads while we write, or both sides could fill up. */
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    for(off = 0; off != n; listener_poll(l, 10))
+        if((got = write(fd, buf + off, n - off)) > 0)
+            off += got;
+    shutdown(fd, SHUT_WR);
+
+    for(i = 0; i != 100 && l->stats.messages != before + PENDING; i++)
+        listener_poll(l, 100);
+
+    /* Until the peer reads, little can happen: a short send or two may
+     * complete, but polls should mostly wait out their timeout.
+     */
+    start = now();
+    for(i = 0; now() - start < 0.3; i++)
+        listener_poll(l, 50);
+
+    if(i > 30)
+    {
+        fprintf(stderr, "listener_test: %s: spinning on a half-closed connection\n", name);
+        ret = false;
+    }
+
+    for(i = 0; i != 1000; i++)
+    {
+        listener_poll(l, 10);
+
+        while((got = read(fd, buf, sizeof(buf))) > 0)
+            for(m = 0; m != got; m++)
+                acks += buf[m] == MLLP_END;
+
+        if(got == 0)
+            break;
+    }
+
+    if(acks != PENDING || got != 0)
+    {
+        fprintf(stderr, "listener_test: %s: %d of %d ACKs after a half close\n",
+                name, acks, PENDING);
+        ret = false;
+    }
+
+    close(fd);
+    s->sndbuf = 0;
+    return ret;
+}
+
+/* Everything below, on the backend given. */
+
+static bool
+listener_run_test(listener_backend backend)
+{
+    const char *name = backend == LISTENER_URING ? "io_uring" : "epoll";
+    int fd[CLIENTS];
+    char buf[EACH * 128];
+    char msg[128];
+    char big[8192];
+    size_t n;
+    bool ret = true;
+    int i, k, m;
+
+    server s = { ack_ctor(NULL, NULL, true), CLIENTS * EACH, 0 };
+    listener *l = listener_ctor_backend(NULL, "127.0.0.1", 0, backend, on_message, &s);
+
+    if(l == NULL)
+    {
+        ack_dtor(s.reply);
+        return backend == LISTENER_URING;
+    }
+
+    for(i = 0; i != CLIENTS; i++)
+        fd[i] = dial(l->port);
+
+    while(l->stats.accepted != CLIENTS)
+        if(listener_poll(l, 1000) < 0)
+            break;
+
+    /* Every client sends all its messages in one write, and the last
+     * client splits one of them in two.
+     */
+    for(i = 0; i != CLIENTS; i++)
+    {
+        for(k = 0, n = 0; k != EACH; k++)
+        {
+            m = snprintf(msg, sizeof(msg), "MSH|^~\\&|A|B|C|D|||ADT^A01|C%d-%d|P|2.5\rPID|1\r", i, k);
+            n += mllp_encode(buf + n, msg, m);
+        }
+
+        if(i == CLIENTS - 1)
+        {
+            write(fd[i], buf, 20);
+            listener_poll(l, 0);
+            write(fd[i], buf + 20, n - 20);
+        }
+        else
+            write(fd[i], buf, n);
+    }
+
+    listener_run(l);
+
+    for(i = 0; ret && i != CLIENTS; i++)
+    {
+        if(!read_acks(fd[i], i, EACH))
+        {
+            fprintf(stderr, "listener_test: %s: client %d got the wrong ACKs\n", name, i);
+            ret = false;
+        }
+    }
+
+    if(l->pool->head->used != 0)
+    {
+        fprintf(stderr, "listener_test: %s: the pool outlived the poll\n", name);
+        ret = false;
+    }
+
+    /* Hanging up, and sending a frame bigger than the ring. */
+    close(fd[0]);
+    l->ringsize = 4096;
+    fd[0] = dial(l->port);
+
+    while(l->stats.accepted != CLIENTS + 1)
+        if(listener_poll(l, 1000) < 0)
+            break;
+
+    memset(big, 'x', sizeof(big));
+    big[0] = MLLP_START;
+    write(fd[0], big, sizeof(big));
+
+    for(i = 0; i != 10 && (l->stats.closed != 2 || l->stats.overflows != 1); i++)
+        listener_poll(l, 100);
+
+    if(l->nconns != CLIENTS - 1 || l->stats.messages != CLIENTS * EACH)
+    {
+        fprintf(stderr, "listener_test: %s: %d connections, %d closed, %d overflows\n",
+                name, l->nconns, (int)l->stats.closed, (int)l->stats.overflows);
+        ret = false;
+    }
+
+    if(!half_close_test(l, &s, name))
+        ret = false;
+
+    for(i = 0; i != CLIENTS; i++)
+        close(fd[i]);
+
+    listener_dtor(l);
+    ack_dtor(s.reply);
+
+    return ret;
+}
+
+bool
+listener_test(int argc, char **argv)
+{
+    /* io_uring is only checked where the library and kernel have it. */
+    return listener_run_test(LISTENER_EPOLL) && listener_run_test(LISTENER_URING);
+}
+
+#define WORKERS 4
+
+typedef struct
+{
+    ack *reply;
+    int *handled;               /* across all workers */
+    int expect;
+    listener_group *group;
+} worker;
+
+static void
+on_group_message(connection *conn, const char *msg, size_t len, void *user)
+{
+    worker *w = user;
+
+    if(ack_build(w->reply, msg, len, "AA"))
+        connection_sendv(conn, w->reply->iov, w->reply->niov);
+
+    if(__atomic_add_fetch(w->handled, 1, __ATOMIC_ACQ_REL) == w->expect)
+        listener_group_stop(w->group);
+}
+
+bool
+listener_group_test(int argc, char **argv)
+{
+    worker w[WORKERS];
+    listener_stats total;
+    int fd[CLIENTS];
+    char buf[EACH * 128];
+    char msg[128];
+    size_t n;
+    bool ret = true;
+    int handled = 0;
+    int i, k, m;
+
+    listener_group *g = listener_group_ctor(NULL, "127.0.0.1", 0, WORKERS, on_message, NULL);
+
+    if(g == NULL)
+    {
+        fprintf(stderr, "listener_group_test: no group\n");
+        return false;
+    }
+
+    for(i = 0; i != g->nworkers; i++)
+    {
+        w[i].reply = ack_ctor(NULL, NULL, true);
+        w[i].handled = &handled;
+        w[i].expect = CLIENTS * EACH;
+        w[i].group = g;
+
+        g->workers[i]->handler = on_group_message;
+        g->workers[i]->user = &w[i];
+    }
+
+    /* Everything is queued in the kernel before any worker runs. */
+    for(i = 0; i != CLIENTS; i++)
+    {
+        fd[i] = dial(g->port);
+
+        for(k = 0, n = 0; k != EACH; k++)
+        {
+            m = snprintf(msg, sizeof(msg), "MSH|^~\\&|A|B|C|D|||ADT^A01|C%d-%d|P|2.5\rPID|1\r", i, k);
+            n += mllp_encode(buf + n, msg, m);
+        }
+        write(fd[i], buf, n);
+    }
+
+    listener_group_run(g);
+
+    for(i = 0; ret && i != CLIENTS; i++)
+    {
+        if(!read_acks(fd[i], i, EACH))
+        {
+            fprintf(stderr, "listener_group_test: client %d got the wrong ACKs\n", i);
+            ret = false;
+        }
+    }
+
+    listener_group_stats(g, &total);
+
+    if(total.accepted != CLIENTS || total.messages != CLIENTS * EACH)
+    {
+        fprintf(stderr, "listener_group_test: %d accepted, %d messages\n",
+                (int)total.accepted, (int)total.messages);
+        ret = false;
+    }
+
+    for(i = 0; i != CLIENTS; i++)
+        close(fd[i]);
+
+    for(i = 0; i != g->nworkers; i++)
+        ack_dtor(w[i].reply);
+    listener_group_dtor(g);
+
+    return ret;
+}
@@ -41,6 +41,116 @@ main(int argc, char **argv)
     if(testread(argc, argv))
         fprintf(stderr, "testread passed.\n");
 
+    if(view_test(argc, argv))
+        fprintf(stderr, "view_test passed.\n");
+    else
+        fprintf(stderr, "view_test failed.\n");
+
+    if(delim_test(argc, argv))
+        fprintf(stderr, "delim_test passed.\n");
+    else
+        fprintf(stderr, "delim_test failed.\n");
+
+    if(arena_test(argc, argv))
+        fprintf(stderr, "arena_test passed.\n");
+    else
+        fprintf(stderr, "arena_test failed.\n");
+
+    if(stream_test(argc, argv))
+        fprintf(stderr, "stream_test passed.\n");
+    else
+        fprintf(stderr, "stream_test failed.\n");
+
+    if(sax_test(argc, argv))
+        fprintf(stderr, "sax_test passed.\n");
+    else
+        fprintf(stderr, "sax_test failed.\n");
+
+    if(query_test(argc, argv))
+        fprintf(stderr, "query_test passed.\n");
+    else
+        fprintf(stderr, "query_test failed.\n");
+
+    if(segid_test(argc, argv))
+        fprintf(stderr, "segid_test passed.\n");
+    else
+        fprintf(stderr, "segid_test failed.\n");
+
+    if(legacy_test(argc, argv))
+        fprintf(stderr, "legacy_test passed.\n");
+    else
+        fprintf(stderr, "legacy_test failed.\n");
+
+    if(cursor_test(argc, argv))
+        fprintf(stderr, "cursor_test passed.\n");
+    else
+        fprintf(stderr, "cursor_test failed.\n");
+
+    if(vector_test(argc, argv))
+        fprintf(stderr, "vector_test passed.\n");
+    else
+        fprintf(stderr, "vector_test failed.\n");
+
+    if(compact_test(argc, argv))
+        fprintf(stderr, "compact_test passed.\n");
+    else
+        fprintf(stderr, "compact_test failed.\n");
+
+    if(batch_test(argc, argv))
+        fprintf(stderr, "batch_test passed.\n");
+    else
+        fprintf(stderr, "batch_test failed.\n");
+
+    if(serialize_test(argc, argv))
+        fprintf(stderr, "serialize_test passed.\n");
+    else
+        fprintf(stderr, "serialize_test failed.\n");
+
+    if(edit_test(argc, argv))
+        fprintf(stderr, "edit_test passed.\n");
+    else
+        fprintf(stderr, "edit_test failed.\n");
+
+    if(ack_test(argc, argv))
+        fprintf(stderr, "ack_test passed.\n");
+    else
+        fprintf(stderr, "ack_test failed.\n");
+
+    if(msh_test(argc, argv))
+        fprintf(stderr, "msh_test passed.\n");
+    else
+        fprintf(stderr, "msh_test failed.\n");
+
+    if(dtm_test(argc, argv))
+        fprintf(stderr, "dtm_test passed.\n");
+    else
+        fprintf(stderr, "dtm_test failed.\n");
+
+    if(escape_test(argc, argv))
+        fprintf(stderr, "escape_test passed.\n");
+    else
+        fprintf(stderr, "escape_test failed.\n");
+
+    if(mllp_test(argc, argv))
+        fprintf(stderr, "mllp_test passed.\n");
+    else
+        fprintf(stderr, "mllp_test failed.\n");
+
+    if(recv_test(argc, argv))
+        fprintf(stderr, "recv_test passed.\n");
+    else
+        fprintf(stderr, "recv_test failed.\n");
+
+    if(listener_test(argc, argv))
+        fprintf(stderr, "listener_test passed.\n");
+    else
+        fprintf(stderr, "listener_test failed.\n");
+
+    if(listener_group_test(argc, argv))
+        fprintf(stderr, "listener_group_test passed.\n");
+    else
+        fprintf(stderr, "listener_group_test failed.\n");
+
 //    if(parser_test(argc, argv))
 //        fprintf(stderr, "parser_test passed.\n");
 
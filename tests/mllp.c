@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hl7c/mllp.h>
+#include "tests.h"
+
+/* Copies n bytes of s into the ring, a piece of at most step at a time,
+ * checking each frame that comes out against the expected message.
+ */
+
+static int
+feed(mllp_ring *ring, const char *s, size_t n, size_t step, const char *expect, size_t elen)
+{
+    const char *frame;
+    size_t len, avail, k;
+    int frames = 0;
+    char *p;
+
+    while(n > 0)
+    {
+        p = mllp_ring_space(ring, &avail);
+        k = n < step ? n : step;
+        k = k < avail ? k : avail;
+
+        if(k == 0)
+            break;
+
+        memcpy(p, s, k);
+        mllp_ring_commit(ring, k);
+        s += k;
+        n -= k;
+
+        while(mllp_ring_next(ring, &frame, &len))
+        {
+            if(len != elen || memcmp(frame, expect, len) != 0)
+                return -1;
+            frames++;
+        }
+    }
+    return frames;
+}
+
+bool
+mllp_test(int argc, char **argv)
+{
+    const char *msg = "MSH|^~\\&|A|B\rPID|1||13885\r";
+    size_t mlen = strlen(msg);
+    char *stream = malloc(64 * (mlen + 8));
+    char big[8192];
+    size_t n = 0;
+    bool ret = true;
+    int i;
+
+    mllp_ring *ring = mllp_ring_ctor(NULL, 4096);
+
+    /* 64 frames with junk between them: about twice around the ring. */
+    for(i = 0; i != 64; i++)
+    {
+        memcpy(stream + n, "\r\n", 2);
+        n += 2 + mllp_encode(stream + n + 2, msg, mlen);
+    }
+
+    /* Whole, one byte at a time, and in pieces that split frames. */
+    if(feed(ring, stream, n, n, msg, mlen) != 64 || feed(ring, stream, n, 1, msg, mlen) != 64 ||
+       feed(ring, stream, n, 37, msg, mlen) != 64 || ring->head != ring->tail)
+    {
+        fprintf(stderr, "mllp_test: frames lost\n");
+        ret = false;
+    }
+
+    /* An end block without its CR yet waits for it. */
+    mllp_ring_reset(ring);
+    if(feed(ring, stream + 2, mlen + 2, mlen + 2, msg, mlen) != 0 ||
+       feed(ring, stream + mlen + 4, 1, 1, msg, mlen) != 1 || ring->head != ring->tail)
+    {
+        fprintf(stderr, "mllp_test: bad frame end\n");
+        ret = false;
+    }
+
+    /* A frame bigger than the ring can't be had. */
+    memset(big, 'x', sizeof(big));
+    big[0] = MLLP_START;
+    mllp_ring_reset(ring);
+
+    if(feed(ring, big, sizeof(big), sizeof(big), msg, mlen) != 0 || !ring->overflow)
+    {
+        fprintf(stderr, "mllp_test: no overflow\n");
+        ret = false;
+    }
+
+    mllp_ring_reset(ring);
+
+    if(ring->overflow || feed(ring, stream, n, 512, msg, mlen) != 64)
+    {
+        fprintf(stderr, "mllp_test: reset didn't recover\n");
+        ret = false;
+    }
+
+    mllp_ring_dtor(ring);
+    free(stream);
+
+    return ret;
+}
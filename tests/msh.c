@@ -0,0 +1,106 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/view.h>
+#include <hl7c/msh.h>
+#include "tests.h"
+
+static const char *odd = "MSH#@!$%#A#B\nEVN#A04\r";
+
+bool
+msh_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    const char *want, *got;
+    size_t wlen, glen;
+    FILE *fp = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    bool ret = true;
+    int i;
+
+    message_view *mv = NULL;
+    msh_header hdr;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    fclose(fp);
+
+    /* The file is MLLP framed; the peek agrees with a full view. */
+    mv = message_view_parse(message_view_ctor(mv), buf, len);
+
+    if(!hl7_msh_peek(buf, len, &hdr) || hdr.field != '|' || hdr.escape != '\\' ||
+       hdr.segment.len != mv->segments[0].line.len)
+    {
+        fprintf(stderr, "msh_test: bad header\n");
+        ret = false;
+    }
+
+    for(i = 2; ret && i != MSH_PEEK_FIELDS; i++)
+    {
+        want = message_view_field(mv, &mv->segments[0], i - 1, &wlen);
+        got = msh_field(&hdr, buf, i, &glen);
+
+        if(wlen != glen || memcmp(want, got, wlen) != 0)
+        {
+            fprintf(stderr, "msh_test: MSH-%d differs\n", i);
+            ret = false;
+        }
+    }
+
+    /* Other separators, a short header ended by LF, and no header. */
+    if(!hl7_msh_peek(odd, strlen(odd), &hdr) || hdr.field != '#' || hdr.component != '@' ||
+       hdr.subcomponent != '%' || hdr.nfields != 5 || hdr.fields[4].len != 1 ||
+       odd[hdr.fields[4].off] != 'B' || hdr.fields[9].len != 0)
+    {
+        fprintf(stderr, "msh_test: bad header with other separators\n");
+        ret = false;
+    }
+
+    if(hl7_msh_peek("EVN|A04\r", 8, &hdr) || hl7_msh_peek("MS", 2, &hdr))
+    {
+        fprintf(stderr, "msh_test: found a header that isn't there\n");
+        ret = false;
+    }
+
+    message_view_dtor(mv);
+    free(buf);
+
+    return ret;
+}
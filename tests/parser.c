@@ -42,10 +42,8 @@ bool parser_test(int argc, char **argv)
     void *field = NULL;
 
     segment *s;
-    segment_iter *sit;
 
     message *m = NULL;
-    message_iter *mit = NULL;
 
     if((fp=fopen(filename, "r"))==NULL)
     {
@@ -58,29 +56,19 @@ bool parser_test(int argc, char **argv)
                           * are constructed by the parser.
                           */
 
-    m = m->parse(m, fp, "\r", "|"); /* Parse the message. */
+    m = m->vt->parse(m, fp, "\r", "|"); /* Parse the message. */
 
     fclose(fp);
 
-    for(mit = message_iter_ctor(m), /* Construct the message iterator */
-        s = mit->begin(m);          /* Initialize our segment object to the first segment. */
-        s != mit->end(mit);         /* Stop if we reach the end of the message. */
-        s = mit->next(mit))         /* Otherwise, go on to the next segment. */
+    HL7_FOREACH_SEGMENT(m, s)           /* For each segment in the message, */
     {
-
-        for(sit = segment_iter_ctor(s), /* Construct the segment iterator. */
-            field = sit->begin(s);      /* Initialize our field to the first field */
-            field != sit->end(sit);     /* Stop if we reach the end of the segment. */
-            field = sit->next(sit))     /* Otherwise, go on to the next field. */
+        HL7_FOREACH_FIELD(s, field)     /* and each field in the segment, */
         {
             fprintf(stderr, "'%s'\n", (char*)field); /* Process the field. In this case, just print it out. */
         }
-
-        sit->dtor(sit); /* Clean up the segment iterator. */
     }
 
-    mit->dtor(mit); /* Clean up the message iterator. */
-    m->dtor(m); /* Clean up the message object. */
+    m->vt->dtor(m); /* Clean up the message object. */
 
     return true;
 }
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/query.h>
+#include "tests.h"
+
+static const char *paths[] =
+{
+    "PID-5", "MSH-9-2", "IN1[2]-4", "PID-11-3", "MSH-1", "MSH-2",
+    "PID-5-2", "PID-13(1)-2", "IN1-2", "ZZZ-1", "PID-5-9", "IN1[3]-1",
+};
+
+/* Expected values, NULL where the message doesn't have the path. */
+static const char *expected[] =
+{
+    "Public^John^Q^^^", "A04", "Blue Cross Blue Shield", "Nashville", "|", "^~\\&",
+    "John", "PRN", "UHC3", NULL, NULL, NULL,
+};
+
+static const char *malformed[] = { "PID", "PID-", "pid-5", "PID[0]-1", "PID-5(0)", "MSH-2-1", "PID-5x" };
+
+bool
+query_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    const int n = sizeof(paths) / sizeof(paths[0]);
+    query_value out[sizeof(paths) / sizeof(paths[0])];
+    FILE *fp = NULL;
+    char *buf = NULL;
+    size_t len = 0;
+    bool ret = true;
+    int found;
+    int bad;
+    int i;
+
+    query *q = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    fclose(fp);
+
+    if((q = query_compile(paths, n, &bad)) == NULL)
+    {
+        fprintf(stderr, "query_test: couldn't compile %s\n", paths[bad]);
+        free(buf);
+        return false;
+    }
+
+    found = query_run(q, buf, len, out);
+
+    for(i = 0; i != n; i++)
+    {
+        if(expected[i] == NULL ? out[i].value != NULL :
+           out[i].value == NULL || out[i].len != strlen(expected[i]) ||
+           memcmp(out[i].value, expected[i], out[i].len) != 0)
+        {
+            fprintf(stderr, "query_test: %s gave '%.*s'\n", paths[i],
+                    out[i].value ? (int)out[i].len : 6, out[i].value ? out[i].value : "(null)");
+            ret = false;
+        }
+    }
+
+    if(found != 9)
+    {
+        fprintf(stderr, "query_test: found %d paths, expected 9\n", found);
+        ret = false;
+    }
+    query_dtor(q);
+
+    for(i = 0; i != (int)(sizeof(malformed) / sizeof(malformed[0])); i++)
+    {
+        if((q = query_compile(&malformed[i], 1, &bad)) != NULL || bad != 0)
+        {
+            fprintf(stderr, "query_test: %s compiled\n", malformed[i]);
+            query_dtor(q);
+            ret = false;
+        }
+    }
+
+    free(buf);
+    return ret;
+}
@@ -30,39 +30,40 @@
 #include <errno.h>
 #include <string.h>
 #include <hl7c/proto.h>
+#include <hl7c/mllp.h>
 
 const char *filename = "../data/adt_a04_13885_20090811203018";
 
 bool
 testread(int argc, char **argv)
 {
-    FILE *fp;
+    mllp_ring *ring = NULL;
+    const char *frame;
     char *msg;
-    int s = 0;
-    bool ret = true;
+    size_t len;
+    int fd;
+    bool got = false;
+    bool ret = false;
 
-    s = getsize(filename);
-
-    if(!s)
-        return false; // empty file;
-
-    if((fp=fopen(filename, "r"))==NULL)
+    if((fd = open(filename, O_RDONLY)) < 0)
         return false; // couldn't open file.
 
-    if((msg = calloc(1, s*sizeof(char))) == NULL)
-        return false; // memory error.
-
-    if(read(fileno(fp), msg, s) != s)
-        return false; // Failed/partial read.
+    /* The file holds one MLLP frame. */
+    ring = mllp_ring_ctor(ring, 4096);
 
-    fclose(fp);
+    while(!(got = mllp_ring_next(ring, &frame, &len)))
+        if(mllp_ring_read(ring, fd) <= 0)
+            break;
 
-    msg = trim_left(msg, "\v");
-    msg = trim_right(msg, '\n');
+    close(fd);
 
-    ret = readmsg(msg);
+    if(got && (msg = strndup(frame, len)) != NULL)
+    {
+        ret = readmsg(msg);
+        free(msg);
+    }
 
-    free(msg);
+    mllp_ring_dtor(ring);
 
     return ret;
 }
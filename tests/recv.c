@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <hl7c/net.h>
+#include <hl7c/mllp.h>
+#include "tests.h"
+
+static const char *frame = "\vMSH|^~\\&|A\rMSA|AA|1\r\x1c\r";
+
+/* A line is complete at its LF. */
+
+static size_t
+line_end(const char *buf, size_t len, size_t scanned, void *user)
+{
+    const char *p = memchr(buf + scanned, '\n', len - scanned);
+
+    return p != NULL ? (size_t)(p - buf) + 1 : 0;
+}
+
+static double
+since(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+bool
+recv_test(int argc, char **argv)
+{
+    struct timespec start;
+    tcp_status status;
+    char *buf = NULL;
+    char big[8192];
+    size_t len;
+    bool ret = true;
+    int fd[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fd) != 0)
+        return false;
+
+    /* A frame in two pieces, with the start of another behind it: 
+     * back at once, with only the first. The rest is dropped.
+     */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    write(fd[1], frame, 10);
+    write(fd[1], frame + 10, strlen(frame) - 10);
+    write(fd[1], frame, 5);
+
+    status = tcp_recv_frame(fd[0], 5000, 0, NULL, NULL, &buf, &len);
+
+    if(status != TCP_FRAME || len != strlen(frame) || memcmp(buf, frame, len) != 0 ||
+       buf[len] != '\0' || since(&start) > 1)
+    {
+        fprintf(stderr, "recv_test: frame not returned on its end\n");
+        ret = false;
+    }
+    free(buf);
+
+    /* Nothing more coming, then a line at a time. */
+    status = tcp_recv_frame(fd[0], 50, 0, line_end, NULL, &buf, &len);
+
+    if(status != TCP_TIMEOUT || len != 0)
+    {
+        fprintf(stderr, "recv_test: expected a timeout, got %d\n", status);
+        ret = false;
+    }
+    free(buf);
+
+    write(fd[1], "more\nrest", 9);
+    status = tcp_recv_frame(fd[0], 1000, 0, line_end, NULL, &buf, &len);
+
+    if(status != TCP_FRAME || len != 5 || strcmp(buf, "more\n") != 0)
+    {
+        fprintf(stderr, "recv_test: bad line\n");
+        ret = false;
+    }
+    free(buf);
+
+    /* More than allowed, with no end in sight. */
+    memset(big, 'x', sizeof(big));
+    write(fd[1], big, sizeof(big));
+    status = tcp_recv_frame(fd[0], 1000, 4000, NULL, NULL, &buf, &len);
+
+    if(status != TCP_TOOBIG || len != 4000)
+    {
+        fprintf(stderr, "recv_test: expected too big, got %d\n", status);
+        ret = false;
+    }
+    free(buf);
+
+    close(fd[1]);
+    status = tcp_recv_frame(fd[0], 1000, 0, NULL, NULL, &buf, &len);
+
+    if(status != TCP_CLOSED)
+    {
+        fprintf(stderr, "recv_test: expected closed, got %d\n", status);
+        ret = false;
+    }
+    free(buf);
+    close(fd[0]);
+
+    return ret;
+}
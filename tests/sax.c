@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/sax.h>
+#include "tests.h"
+
+typedef struct _tally
+{
+    int segments;
+    int messages;
+    int fields;             /* fields seen outside PID */
+    bool in_pid;
+    char given[32];         /* PID-5.2 */
+    int stop_after;         /* segments, 0 for never */
+} tally;
+
+static sax_action
+pid_only(void *user, const char *name, size_t len)
+{
+    tally *t = user;
+
+    t->in_pid = len == 3 && memcmp(name, "PID", 3) == 0;
+    return t->in_pid ? SAX_CONTINUE : SAX_SKIP;
+}
+
+static sax_action
+count_field(void *user, int field, const char *value, size_t len)
+{
+    tally *t = user;
+
+    if(!t->in_pid)
+        t->fields++;
+
+    /* Nothing past PID-5 is wanted. */
+    return field > 5 ? SAX_SKIP : SAX_CONTINUE;
+}
+
+static sax_action
+name_component(void *user, int field, int rep, int comp, const char *value, size_t len)
+{
+    tally *t = user;
+
+    if(field == 5 && rep == 0 && comp == 2 && len < sizeof(t->given))
+    {
+        memcpy(t->given, value, len);
+        t->given[len] = '\0';
+    }
+    return SAX_CONTINUE;
+}
+
+static sax_action
+count_segment(void *user, const char *seg, size_t len)
+{
+    tally *t = user;
+
+    t->segments++;
+    return t->segments == t->stop_after ? SAX_STOP : SAX_CONTINUE;
+}
+
+static sax_action
+count_message(void *user, int nsegments)
+{
+    tally *t = user;
+
+    t->messages++;
+    return SAX_CONTINUE;
+}
+
+static char *
+read_file(const char *filename, size_t *len)
+{
+    FILE *fp = NULL;
+    char *buf = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    buf = slurp(fp, len);
+    fclose(fp);
+    return buf;
+}
+
+bool
+sax_test(int argc, char **argv)
+{
+    static const sax_handler counter = { NULL, NULL, NULL, count_segment, count_message };
+    static const sax_handler picker = { pid_only, count_field, name_component,
+                                        count_segment, count_message };
+    char *a04 = NULL;
+    char *a08 = NULL;
+    char *buf = NULL;
+    size_t a04len = 0;
+    size_t a08len = 0;
+    bool ret = true;
+    tally t;
+
+    a04 = read_file("../data/adt_a04_13885_20090811203018", &a04len);
+    a08 = read_file("../data/adt_a08_13885_20090811203018", &a08len);
+
+    if(a04 == NULL || a08 == NULL)
+    {
+        free(a04);
+        free(a08);
+        return false;
+    }
+
+    buf = malloc(a04len + a08len);
+    memcpy(buf, a04, a04len);
+    memcpy(buf + a04len, a08, a08len);
+
+    /* Two framed messages back to back. */
+    memset(&t, 0, sizeof(t));
+    if(!sax_parse(buf, a04len + a08len, &counter, &t) || t.messages != 2 || t.segments < 14)
+    {
+        fprintf(stderr, "sax_test: got %d messages, %d segments\n", t.messages, t.segments);
+        ret = false;
+    }
+
+    /* Skipped segments never reach on_field. */
+    memset(&t, 0, sizeof(t));
+    sax_parse(a04, a04len, &picker, &t);
+
+    if(t.fields != 0 || strcmp(t.given, "John") != 0 || t.segments != 7)
+    {
+        fprintf(stderr, "sax_test: skip failed, %d fields, given name '%s'\n",
+                t.fields, t.given);
+        ret = false;
+    }
+
+    /* Stopping ends the parse before the message is closed. */
+    memset(&t, 0, sizeof(t));
+    t.stop_after = 3;
+    if(sax_parse(buf, a04len + a08len, &counter, &t) || t.segments != 3 || t.messages != 0)
+    {
+        fprintf(stderr, "sax_test: stop failed after %d segments\n", t.segments);
+        ret = false;
+    }
+
+    free(buf);
+    free(a04);
+    free(a08);
+
+    return ret;
+}
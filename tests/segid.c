@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/parse.h>
+#include <hl7c/message.h>
+#include <hl7c/segid.h>
+#include "tests.h"
+
+static bool
+check_index(message *m, const char *how)
+{
+    segment *in1 = message_find(m, SEG_IN1, 1);
+    bool ret = true;
+
+    if(message_count(m, SEG_IN1) != 2 || in1 == NULL || strcmp(in1->data[1], "2") != 0)
+    {
+        fprintf(stderr, "segid_test: (%s) second IN1 not found\n", how);
+        ret = false;
+    }
+
+    if(message_find(m, SEG_MSH, 0) != m->segments[0] || m->segments[2]->id != SEG_PID)
+    {
+        fprintf(stderr, "segid_test: (%s) bad segment IDs\n", how);
+        ret = false;
+    }
+
+    if(message_find(m, SEG_OBX, 0) != NULL || message_find(m, SEG_IN1, 2) != NULL ||
+       message_count(m, SEG_OBX) != 0)
+    {
+        fprintf(stderr, "segid_test: (%s) found a missing segment\n", how);
+        ret = false;
+    }
+    return ret;
+}
+
+bool
+segid_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    const char *nack = "MSH|^~\\&|||||||ACK|1|P|2.3\rMSA|AE|1\rERR|bad message\r";
+    FILE *fp = NULL;
+    bool ret = true;
+    arena *pool = NULL;
+    int i;
+
+    message *m = NULL;
+    segment *s = NULL;
+
+    if(segid_of("PID", 3) != SEG_PID || segid_of("PI", 2) != SEG_NONE ||
+       SEGID('Z', 'P', 'D') == SEG_PID)
+    {
+        fprintf(stderr, "segid_test: bad packing\n");
+        ret = false;
+    }
+
+    /* Index a message built on the heap, then in an arena. */
+    for(i = 0; i != 2; i++)
+    {
+        if((fp = fopen(filename, "r")) == NULL)
+        {
+            fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+            return false;
+        }
+
+        pool = i ? arena_ctor(pool, 0) : NULL;
+        m = message_ctor_arena(m, pool);
+        m = m->vt->parse(m, fp, "\r", NULL);
+        fclose(fp);
+
+        ret = check_index(m, i ? "arena" : "heap") && ret;
+
+        m->vt->dtor(m);
+        m = NULL;
+        arena_dtor(pool);
+    }
+
+    /* Many occurrences of one segment. */
+    m = message_ctor(m);
+    for(i = 0; i != 100; i++)
+    {
+        s = segment_ctor(NULL);
+        s = segment_push(s, "OBX");
+        m = message_push(m, s);
+    }
+    if(message_count(m, SEG_OBX) != 100 || message_find(m, SEG_OBX, 99) != m->segments[99])
+    {
+        fprintf(stderr, "segid_test: lost repeated segments\n");
+        ret = false;
+    }
+    m->vt->dtor(m);
+
+    /* The ACK checker finds MSA and ERR by ID. */
+    if(parse(nack))
+    {
+        fprintf(stderr, "segid_test: error ACK accepted\n");
+        ret = false;
+    }
+
+    return ret;
+}
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/message.h>
+#include <hl7c/view.h>
+#include <hl7c/serialize.h>
+#include "tests.h"
+
+static const char *note = "Note|with bars\r";
+static const char *escaped = "NTE|1||Note\\F\\with bars\\X0D\\\r";
+
+/* Reads what a serializer writes to a pipe. */
+
+static bool
+through_pipe(serializer *s, const char *expect, size_t len)
+{
+    char *got = malloc(len + 1);
+    size_t n = 0;
+    ssize_t r;
+    int fd[2];
+    bool ret;
+
+    if(got == NULL || pipe(fd) != 0)
+    {
+        free(got);
+        return false;
+    }
+
+    /* Small enough not to fill the pipe. */
+    ret = serializer_writev(s, fd[1]) == (ssize_t)len;
+    close(fd[1]);
+
+    while(n <= len && (r = read(fd[0], got + n, len + 1 - n)) > 0)
+        n += r;
+    close(fd[0]);
+
+    ret = ret && n == len && memcmp(got, expect, len) == 0;
+    free(got);
+    return ret;
+}
+
+bool
+serialize_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    char *buf = NULL;
+    char *out = NULL;
+    size_t len = 0;
+    size_t size;
+    bool ret = true;
+    int i;
+
+    message *m = NULL;
+    segment *seg = NULL;
+    message_view *mv = NULL;
+    message_view *again = NULL;
+    serializer *s = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    rewind(fp);
+    m = message_ctor(m);
+    m = m->vt->parse(m, fp, "\r", NULL);
+    fclose(fp);
+
+    mv = message_view_parse(message_view_ctor(mv), buf, len);
+
+    /* Nothing in the file needs escaping, so writing the message out 
+     * gives back its segments, line for line.
+     */
+    size = message_serialize_size(m, NULL);
+    out = malloc(size);
+
+    if(message_serialize(m, NULL, out, size - 1) != size || message_serialize(m, NULL, out, size) != size)
+    {
+        fprintf(stderr, "serialize_test: size disagrees\n");
+        ret = false;
+    }
+
+    again = message_view_parse(message_view_ctor(again), out, size);
+
+    for(i = 0; ret && i != mv->len; i++)
+    {
+        if(i >= again->len || mv->segments[i].line.len != again->segments[i].line.len ||
+           memcmp(buf + mv->segments[i].line.off, out + again->segments[i].line.off,
+                  mv->segments[i].line.len) != 0)
+        {
+            fprintf(stderr, "serialize_test: segment %d differs\n", i);
+            ret = false;
+        }
+    }
+
+    /* The same bytes again, gathered straight from the message. */
+    s = serializer_message(serializer_ctor(s), m, NULL);
+
+    if(ret && (s->total != size || !through_pipe(s, out, size)))
+    {
+        fprintf(stderr, "serialize_test: writev of the message differs\n");
+        ret = false;
+    }
+
+    /* A view's lines sit back to back in its buffer, so they go out as
+     * very few iovecs. The view drops the stray '\n' that the message
+     * kept as a last segment, and that the message wrote as \X0A\.
+     */
+    s = serializer_view(s, mv);
+    size -= 6;
+
+    if(ret && (s->niov > 3 || s->total != size || !through_pipe(s, out, size)))
+    {
+        fprintf(stderr, "serialize_test: writev of the view differs (%d iovecs)\n", s->niov);
+        ret = false;
+    }
+
+    /* A separator inside a field gets escaped. */
+    seg = segment_ctor(seg);
+    segment_pushn(seg, "NTE", 3);
+    segment_pushn(seg, "1", 1);
+    segment_pushn(seg, "", 0);
+    segment_pushn(seg, note, strlen(note));
+    m = message_push(m, seg);
+
+    free(out);
+    size = message_serialize_size(m, NULL);
+    out = malloc(size);
+    message_serialize(m, NULL, out, size);
+
+    if(size < strlen(escaped) || memcmp(out + size - strlen(escaped), escaped, strlen(escaped)) != 0)
+    {
+        fprintf(stderr, "serialize_test: bad escaping\n");
+        ret = false;
+    }
+
+    s = serializer_message(s, m, NULL);
+
+    if(ret && (s->total != size || !through_pipe(s, out, size)))
+    {
+        fprintf(stderr, "serialize_test: writev of escaped fields differs\n");
+        ret = false;
+    }
+
+    serializer_dtor(s);
+    message_view_dtor(again);
+    message_view_dtor(mv);
+    m->vt->dtor(m);
+    free(out);
+    free(buf);
+
+    return ret;
+}
@@ -0,0 +1,235 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/view.h>
+#include <hl7c/stream.h>
+#include "tests.h"
+
+/* What the handler checks each segment against. */
+typedef struct _expect
+{
+    message_view *mv;
+    int segment;        /* next segment expected, within the message */
+    int segments;       /* segments seen in all */
+    int messages;
+    size_t msglen;      /* length of the last message, when kept */
+    bool ok;
+} expect;
+
+static void
+check_segment(void *user, const char *seg, size_t len, const span *fields, int nfields)
+{
+    expect *e = user;
+    segment_view *sv = NULL;
+    const char *field = NULL;
+    size_t flen = 0;
+    int i;
+
+    if(e->segment >= e->mv->len)
+    {
+        fprintf(stderr, "stream_test: unexpected segment %.*s\n", (int)len, seg);
+        e->ok = false;
+        return;
+    }
+
+    sv = message_view_segment(e->mv, e->segment++);
+    e->segments++;
+
+    if(sv->len != (uint32_t)nfields)
+    {
+        fprintf(stderr, "stream_test: segment %d has %d fields, expected %d\n",
+                e->segment - 1, nfields, (int)sv->len);
+        e->ok = false;
+        return;
+    }
+
+    for(i = 0; i != nfields; i++)
+    {
+        field = message_view_field(e->mv, sv, i, &flen);
+
+        if(flen != fields[i].len || memcmp(field, seg + fields[i].off, flen) != 0)
+        {
+            fprintf(stderr, "stream_test: segment %d field %d differs\n", e->segment - 1, i);
+            e->ok = false;
+        }
+    }
+}
+
+static void
+check_message(void *user, const char *msg, size_t len, int nsegments)
+{
+    expect *e = user;
+
+    if(nsegments != e->mv->len || e->segment != e->mv->len)
+    {
+        fprintf(stderr, "stream_test: message closed after %d segments\n", nsegments);
+        e->ok = false;
+    }
+
+    if(msg == NULL && len != 0)
+    {
+        fprintf(stderr, "stream_test: %zu bytes with no message\n", len);
+        e->ok = false;
+    }
+
+    e->segment = 0;
+    e->messages++;
+    e->msglen = len;
+}
+
+static const stream_handler handler = { check_segment, check_message };
+
+/*
+ * Feeds buf in chunks whose sizes cycle through the given list.
+ */
+
+static bool
+feed_chunks(stream_parser *sp, const char *buf, size_t len, const size_t *sizes, int nsizes)
+{
+    size_t off = 0;
+    size_t n;
+    int i = 0;
+
+    while(off < len)
+    {
+        n = sizes[i++ % nsizes];
+        if(n > len - off)
+            n = len - off;
+
+        if(!stream_parser_feed(sp, buf + off, n))
+            return false;
+        off += n;
+    }
+    return true;
+}
+
+bool
+stream_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    static const size_t sizes[] = { 1, 7, 64, 3, 500, 2, 4096, 13 };
+    FILE *fp = NULL;
+    char *msg = NULL;
+    char *buf = NULL;
+    size_t msglen = 0;
+    size_t blen = 0;
+    size_t bare = 0;
+    bool ret = true;
+    expect e;
+    int i;
+
+    stream_parser *sp = NULL;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    msg = slurp(fp, &msglen);
+    fclose(fp);
+
+    /* The file is framed as MLLP already. Send it twice like that, then
+     * once bare, which only closes when the input does.
+     */
+    bare = (char *)memchr(msg, 0x1c, msglen) - (msg + 1);
+    buf = malloc(3 * msglen);
+    memcpy(buf, msg, msglen);
+    memcpy(buf + msglen, msg, msglen);
+    memcpy(buf + 2 * msglen, msg + 1, bare);
+    blen = 2 * msglen + bare;
+
+    memset(&e, 0, sizeof(e));
+    e.ok = true;
+    e.mv = message_view_ctor(e.mv);
+    e.mv = message_view_parse(e.mv, msg, msglen);
+
+    /* Every chunking must give the same segments. */
+    for(i = 1; ret && i <= 8; i++)
+    {
+        e.segment = e.segments = e.messages = 0;
+
+        sp = stream_parser_ctor(sp, &handler, &e, false, 0);
+        if(!feed_chunks(sp, buf, blen, sizes, i))
+        {
+            fprintf(stderr, "stream_test: feed failed\n");
+            ret = false;
+        }
+        stream_parser_finish(sp);
+
+        if(e.messages != 3 || e.segments != 3 * e.mv->len)
+        {
+            fprintf(stderr, "stream_test: got %d messages, %d segments\n",
+                    e.messages, e.segments);
+            ret = false;
+        }
+        stream_parser_dtor(sp);
+        sp = NULL;
+    }
+
+    /* Kept messages are handed out whole, without their framing. */
+    e.segment = e.messages = 0;
+    sp = stream_parser_ctor(sp, &handler, &e, true, 0);
+    feed_chunks(sp, buf, msglen, sizes, 3);
+
+    if(e.messages != 1 || e.msglen != bare)
+    {
+        fprintf(stderr, "stream_test: kept message is %d bytes, expected %d\n",
+                (int)e.msglen, (int)bare);
+        ret = false;
+    }
+    stream_parser_dtor(sp);
+    sp = NULL;
+
+    /* An unterminated segment longer than the limit is refused. */
+    sp = stream_parser_ctor(sp, NULL, NULL, false, 64);
+    if(!stream_parser_feed(sp, "PID|1|", 6) || stream_parser_feed(sp, msg, 100))
+    {
+        fprintf(stderr, "stream_test: limit not enforced\n");
+        ret = false;
+    }
+    stream_parser_reset(sp);
+    if(!stream_parser_feed(sp, "PID|1|\r", 7))
+    {
+        fprintf(stderr, "stream_test: reset didn't clear the overflow\n");
+        ret = false;
+    }
+    stream_parser_dtor(sp);
+
+    message_view_dtor(e.mv);
+    free(buf);
+    free(msg);
+
+    return ret && e.ok;
+}
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/scan.h>
+#include <hl7c/message.h>
+#include <hl7c/delim.h>
+#include "tests.h"
+
+bool
+vector_test(int argc, char **argv)
+{
+    const char *fields[] = { "PID", "1", "", "12345" };
+    bool ret = true;
+    char item[16];
+    void *copies[4];
+    int i;
+
+    Array *a = array_init();
+    Multi *mu = multi_init();
+    segment *s = NULL;
+    message *m = NULL;
+    arena *pool = NULL;
+    delimset set;
+
+    /* Growth doubles, so capacity stays within twice the size. */
+    for(i = 0; i != 1000; i++)
+    {
+        snprintf(item, sizeof(item), "%d", i);
+        a = push(a, item);
+    }
+
+    if(a->size != 1000 || a->len != 999 || a->cap < 1000 || a->cap >= 2000 ||
+       strcmp(a->data[777], "777") != 0)
+    {
+        fprintf(stderr, "vector_test: bad Array after 1000 pushes\n");
+        ret = false;
+    }
+
+    array_shrink_to_fit(a);
+    if(a->cap != 1000 || strcmp(a->data[999], "999") != 0)
+    {
+        fprintf(stderr, "vector_test: shrink_to_fit left %d\n", a->cap);
+        ret = false;
+    }
+
+    /* Reserving is exact, and pushing within it doesn't move data. */
+    mu = multi_append(mu, &a, 1);
+    multi_reserve(mu, 10);
+    if(mu->cap != 10 || mu->size != 1 || mu->len != 0 || mu->members[0] != a)
+    {
+        fprintf(stderr, "vector_test: bad Multi after reserve\n");
+        ret = false;
+    }
+    free_multi(mu);
+
+    /* Bulk append keeps the NULL after the last field. */
+    s = segment_ctor(s);
+    for(i = 0; i != 4; i++)
+        copies[i] = strdup(fields[i]);
+    s = segment_append(s, copies, 4);
+
+    if(s->len != 4 || s->vt->end(s) != NULL || s->id != SEG_PID ||
+       strcmp(s->data[3], "12345") != 0)
+    {
+        fprintf(stderr, "vector_test: bad segment after append\n");
+        ret = false;
+    }
+
+    /* Reserved room is zeroed, so an empty message still ends in NULL. */
+    m = message_ctor(m);
+    message_reserve(m, 3);
+
+    if(m->vt->end(m) != NULL)
+    {
+        fprintf(stderr, "vector_test: reserved slots not zeroed\n");
+        ret = false;
+    }
+    m->vt->dtor(m);
+
+    /* Appended segments are indexed like pushed ones. */
+    pool = arena_ctor(pool, 0);
+    m = message_ctor_arena(m, pool);
+    message_reserve(m, 3);
+    m = message_push(m, segment_push(segment_ctor_arena(NULL, pool), "MSH"));
+    m = message_append(m, &s, 1);
+
+    if(m->len != 2 || m->cap != 4 || m->vt->end(m) != NULL ||
+       message_find(m, SEG_PID, 0) != s)
+    {
+        fprintf(stderr, "vector_test: bad message after append\n");
+        ret = false;
+    }
+    m->vt->dtor(m);
+    arena_dtor(pool);
+    s->vt->dtor(s);
+
+    /* Counting delimiters, for reserving exactly. */
+    delimset_init(&set, "|\r", 2);
+    if(delim_count("MSH|^~\\&|A\rPID|1\r", 17, &set) != 5)
+    {
+        fprintf(stderr, "vector_test: bad delimiter count\n");
+        ret = false;
+    }
+
+    return ret;
+}
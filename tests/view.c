@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2008-2009, Jeremy Sandell <jlsandell@gmail.com>
+ *  All rights reserved.
+ * 
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ * 
+ *  THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ *  IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ *  OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ *  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ *  NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ *  THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <hl7c/proto.h>
+#include <hl7c/view.h>
+#include "tests.h"
+
+static const char *names[] = { "MSH", "EVN", "PID", "PV1", "GT1", "IN1", "IN1" };
+static const char *small = "MSH|^~\\&|App\rPID|1||a&b^c~d&efg^h\r";
+static const char *custom = "MSH#*!@%#App#Fac\rPID#1##a*b!c*d%e\r";
+
+bool
+view_test(int argc, char **argv)
+{
+    const char *filename = "../data/adt_a04_13885_20090811203018";
+    FILE *fp = NULL;
+    char *buf = NULL;
+    const char *field = NULL;
+    size_t len = 0;
+    size_t flen = 0;
+    bool ret = true;
+    int i;
+
+    message_view *mv = NULL;
+    segment_view *sv = NULL;
+    encoding scratch;
+
+    if((fp = fopen(filename, "r")) == NULL)
+    {
+        fprintf(stderr, "Couldn't open %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    buf = slurp(fp, &len);
+    fclose(fp);
+
+    mv = message_view_ctor(mv);
+    mv = message_view_parse(mv, buf, len);
+
+    if(mv->len != sizeof(names) / sizeof(names[0]))
+    {
+        fprintf(stderr, "view_test: expected %d segments, got %d\n",
+                (int)(sizeof(names) / sizeof(names[0])), mv->len);
+        ret = false;
+    }
+
+    for(i = 0; ret && i != mv->len; i++)
+    {
+        sv = message_view_segment(mv, i);
+
+        if(!segment_view_is(mv, sv, names[i]))
+        {
+            fprintf(stderr, "view_test: segment %d is not %s\n", i, names[i]);
+            ret = false;
+        }
+    }
+
+    /* PID-5, the patient name. */
+    sv = message_view_segment(mv, 2);
+    field = message_view_field(mv, sv, 5, &flen);
+
+    if(field == NULL || flen != 16 || memcmp(field, "Public^John^Q^^^", flen) != 0)
+    {
+        fprintf(stderr, "view_test: bad PID-5\n");
+        ret = false;
+    }
+
+    /* MSH-9 sits at index 8, as MSH-1 is the separator itself. */
+    sv = message_view_segment(mv, 0);
+    field = message_view_field(mv, sv, 8, &flen);
+
+    if(field == NULL || flen != 7 || memcmp(field, "ADT^A04", flen) != 0)
+    {
+        fprintf(stderr, "view_test: bad MSH-9\n");
+        ret = false;
+    }
+
+    /* Trailing empty fields are kept, missing ones are NULL. */
+    sv = message_view_segment(mv, 1);
+    if(sv->len != 7 || message_view_field(mv, sv, 7, NULL) != NULL)
+    {
+        fprintf(stderr, "view_test: bad EVN field count %u\n", sv->len);
+        ret = false;
+    }
+
+    /* Components are only split on request. */
+    sv = message_view_segment(mv, 2);
+    field = message_view_get(mv, sv, 5, 0, 2, 0, &flen);
+
+    if(field == NULL || flen != 4 || memcmp(field, "John", flen) != 0 ||
+       message_view_components(mv, sv, 5, 0) != 6 ||
+       message_view_get(mv, sv, 5, 1, 1, 0, NULL) != NULL)
+    {
+        fprintf(stderr, "view_test: bad PID-5-2\n");
+        ret = false;
+    }
+
+    /* MSH-2 holds the encoding characters themselves. */
+    sv = message_view_segment(mv, 0);
+    if(message_view_repetitions(mv, sv, 1) != 1 ||
+       message_view_components(mv, sv, 1, 0) != 1)
+    {
+        fprintf(stderr, "view_test: MSH-2 was split\n");
+        ret = false;
+    }
+
+    /* Repetitions and subcomponents, on a view that is reused. */
+    mv = message_view_parse(mv, small, strlen(small));
+    sv = message_view_segment(mv, 1);
+    field = message_view_get(mv, sv, 3, 1, 1, 2, &flen);
+
+    if(message_view_repetitions(mv, sv, 3) != 2 ||
+       message_view_subcomponents(mv, sv, 3, 0, 1) != 2 ||
+       field == NULL || flen != 3 || memcmp(field, "efg", flen) != 0)
+    {
+        fprintf(stderr, "view_test: bad PID-3 repetitions\n");
+        ret = false;
+    }
+
+    /* Encoding characters come from MSH-1 and MSH-2. */
+    mv = message_view_parse(mv, custom, strlen(custom));
+    sv = message_view_segment(mv, 1);
+    field = message_view_get(mv, sv, 3, 1, 2, 2, &flen);
+
+    if(mv->enc->standard || mv->enc->field != '#' || sv->len != 4 ||
+       message_view_repetitions(mv, sv, 3) != 2 ||
+       field == NULL || flen != 1 || *field != 'e')
+    {
+        fprintf(stderr, "view_test: custom encoding misparsed\n");
+        ret = false;
+    }
+
+    /* Only a header segment declares the encoding. */
+    if(encoding_detect("PID|^~\\&|1\r", 11, &scratch) != NULL ||
+       encoding_detect("\x0bMSH|^~\\&|A\r", 12, &scratch) != &encoding_standard)
+    {
+        fprintf(stderr, "view_test: encoding detected from the wrong segment\n");
+        ret = false;
+    }
+
+    message_view_dtor(mv);
+    free(buf);
+
+    return ret;
+}